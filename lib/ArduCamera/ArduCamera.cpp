@@ -1,7 +1,7 @@
 #include <Arduino.h>
 #include "ArduCamera.h"
 
-bool ArduCamera::begin(SdFs* sd) {
+bool ArduCamera::begin(SdFs* sd, RTC_DS3231* rtc) {
   if (this->began) {
     return true;
   }
@@ -19,7 +19,7 @@ bool ArduCamera::begin(SdFs* sd) {
     return false;
   }
 
-  this->camera->set_format(JPEG);
+  this->camera->set_format(this->format);
   this->camera->InitCAM();
   this->setImageSize(OV2640_160x120);
   this->setLightMode(Auto);
@@ -31,6 +31,7 @@ bool ArduCamera::begin(SdFs* sd) {
   this->camera->clear_fifo_flag();
 
   this->sd = sd;
+  this->rtc = rtc;
 
   this->prefs = new Preferences();
 
@@ -95,6 +96,8 @@ bool ArduCamera::isConnected() {
 size_t ArduCamera::captureToMemory(uint8_t* dest, size_t destSize) {
   // Serial.println("Starting capture");
 
+  const uint32_t startCaptureTime = micros();
+
   this->camera->flush_fifo();
   this->camera->clear_fifo_flag();
   this->camera->start_capture();
@@ -102,6 +105,10 @@ size_t ArduCamera::captureToMemory(uint8_t* dest, size_t destSize) {
     ;
   }
   uint32_t len = this->camera->read_fifo_length();
+  this->lastCaptureStats.fifoLength = len;
+  this->lastCaptureStats.captureTime = micros() - startCaptureTime;
+  this->lastCaptureStats.drainTime = 0;
+  this->lastCaptureStats.writeTime = 0;
   if (len >= MAX_FIFO_SIZE) {
     Serial.printf("FIFO oversized (%lu >= %lu)\n", len, MAX_FIFO_SIZE);
     return -1;
@@ -115,6 +122,8 @@ size_t ArduCamera::captureToMemory(uint8_t* dest, size_t destSize) {
     // Serial.printf("FIFO size is %lu\n", len);
   }
 
+  const uint32_t startDrainTime = micros();
+
   this->camera->CS_LOW();
   this->camera->set_fifo_burst();
 
@@ -131,20 +140,105 @@ size_t ArduCamera::captureToMemory(uint8_t* dest, size_t destSize) {
 
   this->camera->CS_HIGH();
 
+  this->lastCaptureStats.drainTime = micros() - startDrainTime;
+
   return i;
 }
 
+size_t ArduCamera::captureToStream(uint8_t* buf, size_t bufSize,
+                                   CameraStreamCallback callback) {
+  const uint32_t startCaptureTime = micros();
+
+  this->camera->flush_fifo();
+  this->camera->clear_fifo_flag();
+  this->camera->start_capture();
+  while (!this->camera->get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK)) {
+    ;
+  }
+  uint32_t len = this->camera->read_fifo_length();
+  this->lastCaptureStats.fifoLength = len;
+  this->lastCaptureStats.captureTime = micros() - startCaptureTime;
+  this->lastCaptureStats.drainTime = 0;
+  this->lastCaptureStats.writeTime = 0;
+  if (len >= MAX_FIFO_SIZE) {
+    Serial.printf("FIFO oversized (%lu >= %lu)\n", len, MAX_FIFO_SIZE);
+    return 0;
+  } else if (len == 0) {
+    Serial.println("FIFO size is 0");
+    return 0;
+  }
+
+  const uint32_t startDrainTime = micros();
+
+  this->camera->CS_LOW();
+  this->camera->set_fifo_burst();
+
+  this->hspi->transfer(0x00);
+  len--;
+
+  size_t streamed = 0;
+
+  while (len > 0) {
+    const size_t chunk = min((size_t)len, bufSize);
+    // The camera ignores MOSI during a burst read, so whatever is in the buffer
+    // can be clocked out while it is being overwritten
+    this->hspi->transfer(buf, chunk);
+    if (!callback(buf, chunk)) {
+      break;
+    }
+    streamed += chunk;
+    len -= chunk;
+  }
+
+  this->camera->CS_HIGH();
+
+  this->lastCaptureStats.drainTime = micros() - startDrainTime;
+
+  return streamed;
+}
+
 int32_t ArduCamera::captureToDisk(char* dest, size_t destSize) {
   const size_t MAX_PATH_SIZE = 255;
   char filename[MAX_PATH_SIZE];
   memset(filename, 0, MAX_PATH_SIZE);
+
+  Serial.println("Starting capture to disk");
+
+  this->getNextFilename(filename, MAX_PATH_SIZE);
+  strncpy(dest, filename, destSize);
+
+  // Stills are always JPEG, even when previewing in RGB565
+  const uint8_t previousFormat = this->format;
+  if (previousFormat != JPEG) {
+    this->setFormat(JPEG);
+    // InitCAM() resets exposure and white balance, which take a few frames to
+    // settle again
+    this->discardFrames(CAMERA_SETTLE_FRAMES);
+  }
+
+  const int32_t result = this->captureToFile(filename);
+
+  if (previousFormat != JPEG) {
+    this->setFormat(previousFormat);
+  }
+
+  return result;
+}
+
+int32_t ArduCamera::captureToFile(const char* path, bool overwrite) {
   FsFile file;
   const size_t bufSize = 4096;
   uint8_t buf[bufSize] = {};
   size_t bytesTransferred = 0;
   size_t i = 0;
+  ExifCaptureInfo info;
+  uint32_t headerBytes = 0;
+  uint32_t startDrainTime = 0;
+  uint32_t startWriteTime = 0;
 
-  Serial.println("Starting capture to disk");
+  this->getExifInfo(&info);
+
+  const uint32_t startCaptureTime = micros();
 
   this->camera->flush_fifo();
   this->camera->clear_fifo_flag();
@@ -153,6 +247,10 @@ int32_t ArduCamera::captureToDisk(char* dest, size_t destSize) {
     ;
   }
   uint32_t len = this->camera->read_fifo_length();
+  this->lastCaptureStats.fifoLength = len;
+  this->lastCaptureStats.captureTime = micros() - startCaptureTime;
+  this->lastCaptureStats.drainTime = 0;
+  this->lastCaptureStats.writeTime = 0;
   if (len >= MAX_FIFO_SIZE) {
     Serial.printf("FIFO oversized (%lu >= %lu)\n", len, MAX_FIFO_SIZE);
     goto cameraError;
@@ -163,20 +261,29 @@ int32_t ArduCamera::captureToDisk(char* dest, size_t destSize) {
     Serial.printf("FIFO size is %lu\n", len);
   }
 
-  this->getNextFilename(filename, MAX_PATH_SIZE);
-
-  Serial.printf("Opening file %s\n", filename);
+  Serial.printf("Opening file %s\n", path);
 
-  file = this->sd->open(filename, O_WRONLY | O_CREAT | O_EXCL);
+  // Only the benchmark reuses its file, a photo is never overwritten
+  file = this->sd->open(path,
+                        O_WRONLY | O_CREAT | (overwrite ? O_TRUNC : O_EXCL));
 
   if (!file) {
     Serial.println("Failed to open file!");
-    return -2;
+    return DISK_IO_ERROR;
   } else {
     Serial.println("Open file success");
   }
 
-  strncpy(dest, filename, destSize);
+  startDrainTime = micros();
+
+  // The time and settings go in an EXIF segment up front with room for a
+  // thumbnail, so one can be added later without rewriting the photo
+  startWriteTime = micros();
+  if (!Exif::writeHeader(&file, &info, &headerBytes)) {
+    goto diskIOError;
+  }
+  this->lastCaptureStats.writeTime += micros() - startWriteTime;
+  bytesTransferred = headerBytes;
 
   this->camera->CS_LOW();
   this->camera->set_fifo_burst();
@@ -184,12 +291,22 @@ int32_t ArduCamera::captureToDisk(char* dest, size_t destSize) {
   this->hspi->transfer(0x00);
   len--;
 
+  // The header already has the SOI the FIFO starts with
+  if (len < 2 || this->hspi->transfer(0x00) != 0xFF ||
+      this->hspi->transfer(0x00) != 0xD8) {
+    Serial.println("FIFO does not start with SOI");
+    goto cameraError;
+  }
+  len -= 2;
+
   while (len > 0) {
     buf[i] = this->hspi->transfer(0x00);
     if (i >= bufSize - 1) {
+      startWriteTime = micros();
       if (file.write(buf, bufSize) != bufSize) {
         goto diskIOError;
       }
+      this->lastCaptureStats.writeTime += micros() - startWriteTime;
       i = 0;
     } else {
       i++;
@@ -198,19 +315,29 @@ int32_t ArduCamera::captureToDisk(char* dest, size_t destSize) {
     len--;
   }
 
+  startWriteTime = micros();
   if (file.write(buf, i + 1) != i + 1) {
     goto diskIOError;
   }
   file.close();
+  this->lastCaptureStats.writeTime += micros() - startWriteTime;
 
   this->camera->CS_HIGH();
 
+  this->lastCaptureStats.drainTime = micros() - startDrainTime -
+                                     this->lastCaptureStats.writeTime;
+
   Serial.printf("Capture to disk finished (wrote %hu bytes)\n",
                 bytesTransferred);
   return bytesTransferred;
 
 cameraError:
-  file.close();
+  // A file is only open here if this capture created it, so a partial photo
+  // is never left on the card
+  if (file) {
+    file.close();
+    this->sd->remove(path);
+  }
   this->camera->CS_HIGH();
 
   Serial.println("Capture to disk failed with camera error!");
@@ -218,7 +345,10 @@ cameraError:
   return CAMERA_ERROR;
 
 diskIOError:
-  file.close();
+  if (file) {
+    file.close();
+    this->sd->remove(path);
+  }
   this->camera->CS_HIGH();
 
   Serial.println("Capture to disk failed with disk IO error!");
@@ -226,11 +356,217 @@ diskIOError:
   return DISK_IO_ERROR;
 }
 
+bool ArduCamera::runBenchmark(uint16_t iterations, uint8_t* previewBuf,
+                              size_t previewBufSize, uint8_t previewSize,
+                              uint8_t captureSize,
+                              CameraBenchmarkRender render, char* reportPath,
+                              size_t reportPathSize) {
+  const char* benchmarkDir = "/benchmarks/";
+  const char* capturePath = "/benchmarks/capture.jpg";
+
+  if (!this->sd->exists(benchmarkDir)) {
+    this->sd->mkdir(benchmarkDir);
+    Serial.printf("Created directory %s\n", benchmarkDir);
+  }
+
+  uint32_t reportNumber = 0;
+  while (true) {
+    snprintf(reportPath, reportPathSize, "%s%010u.csv", benchmarkDir,
+             reportNumber);
+    if (!this->sd->exists(reportPath)) {
+      break;
+    }
+    reportNumber++;
+  }
+
+  FsFile report = this->sd->open(reportPath, O_WRONLY | O_CREAT | O_EXCL);
+  if (!report) {
+    Serial.printf("Failed to open benchmark report %s\n", reportPath);
+    return false;
+  }
+
+  Serial.printf("Running benchmark with %u iterations, writing to %s\n",
+                iterations, reportPath);
+
+  report.println("stage,iteration,fifo_length,capture_us,drain_us,decode_us,"
+                 "push_us,sd_write_us");
+
+  const uint8_t oldFormat = this->format;
+  const uint8_t oldImageSize = this->imageSize;
+  const uint8_t oldJPEGQuality = this->jpegQuality;
+  bool ok = true;
+
+  this->setFormat(JPEG);
+  // Same quality as a photo, whatever the preview was last left at, so runs
+  // are comparable
+  this->setJPEGQuality(OV2640_DEFAULT_JPEG_QUALITY);
+
+  // The resolution tables rewrite COM7, so the test pattern has to be enabled
+  // after every size change
+  this->setImageSize(previewSize);
+  this->setTestPattern(true);
+
+  // Let the sensor settle into the test pattern before measuring
+  this->captureToMemory(previewBuf, previewBufSize);
+
+  // Color and luma only previews of the same pattern, so they can be compared
+  for (uint8_t pass = 0; pass < 2; pass++) {
+    const bool grayscale = pass == 1;
+    for (uint16_t i = 0; i < iterations; i++) {
+      uint32_t decodeTime = 0;
+      uint32_t pushTime = 0;
+      const size_t len = this->captureToMemory(previewBuf, previewBufSize);
+      if (len == 0 || len > previewBufSize) {
+        ok = false;
+      } else if (render != NULL && !render(previewBuf, len, grayscale,
+                                           &decodeTime, &pushTime)) {
+        ok = false;
+      }
+      report.printf("%s,%u,%lu,%lu,%lu,%lu,%lu,0\n",
+                    grayscale ? "preview_gray" : "preview", i,
+                    this->lastCaptureStats.fifoLength,
+                    this->lastCaptureStats.captureTime,
+                    this->lastCaptureStats.drainTime, decodeTime, pushTime);
+    }
+  }
+
+  this->setImageSize(captureSize);
+  this->setTestPattern(true);
+
+  for (uint16_t i = 0; i < iterations; i++) {
+    if (this->captureToFile(capturePath, true) < 0) {
+      ok = false;
+    }
+    report.printf("capture,%u,%lu,%lu,%lu,0,0,%lu\n", i,
+                  this->lastCaptureStats.fifoLength,
+                  this->lastCaptureStats.captureTime,
+                  this->lastCaptureStats.drainTime,
+                  this->lastCaptureStats.writeTime);
+  }
+
+  this->sd->remove(capturePath);
+
+  this->setTestPattern(false);
+  this->setImageSize(oldImageSize);
+  this->setJPEGQuality(oldJPEGQuality);
+  this->setFormat(oldFormat);
+
+  if (!report.close()) {
+    ok = false;
+  }
+
+  Serial.printf("Benchmark finished %s\n", ok ? "successfully" : "with errors");
+
+  return ok;
+}
+
+// Switching formats reinitializes the sensor, so all settings are reapplied
+// afterwards
+void ArduCamera::setFormat(uint8_t format) {
+  if (format == this->format) {
+    return;
+  }
+  Serial.printf("Switching camera format to %s\n",
+                format == JPEG ? "JPEG" : "RGB565");
+  this->format = format;
+  this->camera->set_format(format);
+  this->camera->InitCAM();
+  this->setImageSize(this->imageSize);
+  this->setLightMode(this->lightMode);
+  this->setSaturation(this->saturation);
+  this->setBrightness(this->brightness);
+  this->setContrast(this->contrast);
+  this->setSpecialEffect(this->specialEffect);
+  this->setJPEGQuality(this->jpegQuality);
+  if (this->testPattern) {
+    this->setTestPattern(true);
+  }
+  this->camera->clear_fifo_flag();
+}
+
+// In RGB565 mode the image size is ignored and the DSP always scales to
+// 160x120, which is what the preview shows
 void ArduCamera::setImageSize(uint8_t size) {
-  this->camera->OV2640_set_JPEG_size(size);
+  if (this->format == JPEG) {
+    this->camera->OV2640_set_JPEG_size(size);
+  } else {
+    this->setRGBPreviewSize();
+  }
   this->imageSize = size;
 }
 
+void ArduCamera::setRGBPreviewSize() {
+  this->camera->wrSensorReg8_8(0xFF, 0x00);
+  this->camera->wrSensorReg8_8(0xE0, 0x04);
+  this->camera->wrSensorReg8_8(0x5A, 160 / 4);
+  this->camera->wrSensorReg8_8(0x5B, 120 / 4);
+  this->camera->wrSensorReg8_8(0x5C, 0x00);
+  this->camera->wrSensorReg8_8(0xE0, 0x00);
+}
+
+// Captures frames without reading them out of the FIFO
+void ArduCamera::discardFrames(uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    this->camera->flush_fifo();
+    this->camera->clear_fifo_flag();
+    this->camera->start_capture();
+    while (!this->camera->get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK)) {
+      ;
+    }
+  }
+  this->camera->clear_fifo_flag();
+}
+
+// The time from the RTC and the current settings, for the EXIF segment
+void ArduCamera::getExifInfo(ExifCaptureInfo* info) {
+  memset(info, 0, sizeof(ExifCaptureInfo));
+  if (this->rtc != NULL) {
+    strncpy(info->dateTime, "YYYY:MM:DD hh:mm:ss", EXIF_DATE_TIME_BYTES);
+    this->rtc->now().toString(info->dateTime);
+  } else {
+    // EXIF leaves the digits blank for an unknown time
+    strncpy(info->dateTime, "    :  :     :  :  ", EXIF_DATE_TIME_BYTES);
+  }
+
+  switch (this->lightMode) {
+    default: {
+      info->lightSource = 0;
+      break;
+    }
+    case Sunny: {
+      info->lightSource = 1;
+      break;
+    }
+    case Cloudy: {
+      info->lightSource = 10;
+      break;
+    }
+    case Office: {
+      info->lightSource = 2;
+      break;
+    }
+    case Home: {
+      info->lightSource = 3;
+      break;
+    }
+  }
+  info->whiteBalance = this->lightMode == Auto ? 0 : 1;
+  // The camera's levels go from +4 down to -4, EXIF only has normal, low
+  // (soft for contrast) and high (hard)
+  info->contrast = this->contrast < Contrast0   ? 2
+                   : this->contrast > Contrast0 ? 1
+                                                : 0;
+  info->saturation = this->saturation < Saturation0   ? 2
+                     : this->saturation > Saturation0 ? 1
+                                                      : 0;
+
+  info->makerNote[0] = this->lightMode;
+  info->makerNote[1] = this->saturation;
+  info->makerNote[2] = this->brightness;
+  info->makerNote[3] = this->contrast;
+  info->makerNote[4] = this->specialEffect;
+}
+
 void ArduCamera::setLightMode(uint8_t mode) {
   this->camera->OV2640_set_Light_Mode(mode);
   this->lightMode = mode;
@@ -256,6 +592,31 @@ void ArduCamera::setSpecialEffect(uint8_t effect) {
   this->specialEffect = effect;
 }
 
+// Toggles the OV2640 color bar test pattern (COM7 bit 1 in sensor bank 1)
+// so frame contents, and therefore JPEG size, do not depend on the scene
+void ArduCamera::setTestPattern(bool enabled) {
+  uint8_t com7 = 0;
+  this->camera->wrSensorReg8_8(0xFF, 0x01);
+  this->camera->rdSensorReg8_8(0x12, &com7);
+  if (enabled) {
+    com7 |= 0x02;
+  } else {
+    com7 &= ~0x02;
+  }
+  this->camera->wrSensorReg8_8(0x12, com7);
+  this->testPattern = enabled;
+}
+
+// QS in the DSP bank, none of the ArduCAM register tables touch it so it
+// survives size changes
+void ArduCamera::setJPEGQuality(uint8_t quality) {
+  this->camera->wrSensorReg8_8(0xFF, 0x00);
+  this->camera->wrSensorReg8_8(0x44, quality);
+  this->jpegQuality = quality;
+}
+
+uint8_t ArduCamera::getFormat() { return this->format; }
+
 uint8_t ArduCamera::getImageSize() { return this->imageSize; }
 
 uint8_t ArduCamera::getLightMode() { return this->lightMode; }
@@ -268,6 +629,14 @@ uint8_t ArduCamera::getContrast() { return this->contrast; }
 
 uint8_t ArduCamera::getSpecialEffect() { return this->specialEffect; }
 
+uint8_t ArduCamera::getJPEGQuality() { return this->jpegQuality; }
+
+bool ArduCamera::getTestPattern() { return this->testPattern; }
+
+CameraCaptureStats ArduCamera::getLastCaptureStats() {
+  return this->lastCaptureStats;
+}
+
 void ArduCamera::saveCameraSettings() {
   Serial.println("Saving camera settings");
   this->prefs->begin("cameraPrefs", false);
@@ -5,39 +5,82 @@
 #include <SPI.h>
 #include <SdFat.h>
 #include <Preferences.h>
+#include <RTClib.h>
 #include <ArduCAM.h>
+#include <Exif.h>
 
 const uint8_t HSPI_CLK = 13;
 const uint8_t HSPI_MOSI = 27;
 const uint8_t HSPI_MISO = 14;
 const uint8_t CAM_CS = 15;
 
+// Quantization scale of the OV2640 JPEG encoder, lower is better quality and
+// bigger frames
+const uint8_t OV2640_DEFAULT_JPEG_QUALITY = 0x0C;
+
+// Frames thrown away after the sensor is reinitialized, before a still
+const uint8_t CAMERA_SETTLE_FRAMES = 3;
+
 const int32_t CAMERA_ERROR = -1;
 const int32_t DISK_IO_ERROR = -2;
 
+// Timings of the last capture, all durations are in microseconds
+struct CameraCaptureStats {
+    uint32_t fifoLength;
+    uint32_t captureTime;
+    uint32_t drainTime;
+    uint32_t writeTime;
+};
+
+// Called with consecutive chunks of the FIFO while streaming a capture
+typedef bool (*CameraStreamCallback)(uint8_t* buf, size_t len);
+
+// Called by the benchmark with a preview frame, should decode (in color or
+// luma only) and push it to the display and report how long each step took in
+// microseconds
+typedef bool (*CameraBenchmarkRender)(uint8_t* buf, size_t len, bool grayscale,
+                                      uint32_t* decodeTime,
+                                      uint32_t* pushTime);
+
 class ArduCamera {
   public:
-    bool begin(SdFs* sd);
+    bool begin(SdFs* sd, RTC_DS3231* rtc);
     bool end();
 
     bool isConnected();
 
     size_t captureToMemory(uint8_t* dest, size_t destSize);
+    size_t captureToStream(uint8_t* buf, size_t bufSize,
+                           CameraStreamCallback callback);
     int32_t captureToDisk(char* dest, size_t destSize);
+    int32_t captureToFile(const char* path, bool overwrite = false);
 
+    bool runBenchmark(uint16_t iterations, uint8_t* previewBuf,
+                      size_t previewBufSize, uint8_t previewSize,
+                      uint8_t captureSize, CameraBenchmarkRender render,
+                      char* reportPath, size_t reportPathSize);
+
+    void setFormat(uint8_t format);
     void setImageSize(uint8_t size);
     void setLightMode(uint8_t mode);
     void setSaturation(uint8_t mode);
     void setBrightness(uint8_t brightness);
     void setContrast(uint8_t contrast);
     void setSpecialEffect(uint8_t effect);
+    void setTestPattern(bool enabled);
+    void setJPEGQuality(uint8_t quality);
 
+    uint8_t getFormat();
     uint8_t getImageSize();
     uint8_t getLightMode();
     uint8_t getSaturation();
     uint8_t getBrightness();
     uint8_t getContrast();
     uint8_t getSpecialEffect();
+    bool getTestPattern();
+    uint8_t getJPEGQuality();
+
+    CameraCaptureStats getLastCaptureStats();
 
     void saveCameraSettings();
     void loadCameraSettings();
@@ -45,20 +88,31 @@ class ArduCamera {
 
     void getNextFilename(char* dest, size_t destSize);
 
+  protected:
+    void setRGBPreviewSize();
+    void discardFrames(uint8_t count);
+    void getExifInfo(ExifCaptureInfo* info);
+
   protected:
     bool began = false;
 
     uint32_t nextImageNumber = 0;
 
+    uint8_t format = JPEG;
     uint8_t imageSize;
     uint8_t lightMode;
     uint8_t saturation;
     uint8_t brightness;
     uint8_t contrast;
     uint8_t specialEffect;
+    bool testPattern = false;
+    uint8_t jpegQuality = OV2640_DEFAULT_JPEG_QUALITY;
+
+    CameraCaptureStats lastCaptureStats = {};
 
     SPIClass* hspi = NULL;
     ArduCAM* camera = NULL;
     SdFs* sd = NULL;
+    RTC_DS3231* rtc = NULL;
     Preferences* prefs = NULL;
 };
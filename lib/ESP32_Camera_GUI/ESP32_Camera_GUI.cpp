@@ -14,6 +14,75 @@ bool ESP32CameraGUI::begin(TFT_eSPI* tft, SdFs* sd, RTC_DS3231* rtc,
   this->shutterButton = shutterButton;
   this->battPin = battPin;
   pinMode(this->battPin, INPUT);
+
+  const uint8_t charHeight = 8;
+  memset(this->bottomToolbarText, 0, ESP32CameraGUI::maxBottomToolbarSize + 1);
+  this->bottomToolbar = new TFT_eSprite(this->tft);
+  this->bottomToolbar->setColorDepth(1);
+  if (this->bottomToolbar->createSprite(this->tft->width(), charHeight) ==
+      NULL) {
+    Serial.println("Not enough memory for bottom toolbar sprite, drawing "
+                   "directly instead");
+    delete this->bottomToolbar;
+    this->bottomToolbar = NULL;
+  } else {
+    this->bottomToolbar->setBitmapColor(TFT_WHITE, TFT_BLACK);
+    this->bottomToolbar->setTextColor(TFT_WHITE, TFT_BLACK);
+    this->bottomToolbar->setTextWrap(false);
+  }
+
+  this->histogram = new TFT_eSprite(this->tft);
+  this->histogram->setColorDepth(4);
+  if (this->histogram->createSprite(HISTOGRAM_WIDTH, HISTOGRAM_HEIGHT) ==
+      NULL) {
+    Serial.println("Not enough memory for histogram sprite, histogram will "
+                   "not be shown");
+    delete this->histogram;
+    this->histogram = NULL;
+  } else {
+    for (uint8_t i = 0; i < 16; i++) {
+      this->histogramPalette[i] = TFT_BLACK;
+    }
+    this->histogramPalette[1] = TFT_DARKGREY;
+    this->histogramPalette[2] = TFT_WHITE;
+    this->histogramPalette[3] = TFT_RED;
+    this->histogram->createPalette(this->histogramPalette);
+  }
+
+  this->surface = this->tft;
+#ifndef DISABLE_OFFSCREEN_GUI
+  this->canvas = new TFT_eSprite(this->tft);
+  this->canvas->setColorDepth(4);
+  this->canvasBuffers[0] =
+      (uint16_t*)malloc(CANVAS_BUFFER_PIXELS * sizeof(uint16_t));
+  this->canvasBuffers[1] =
+      (uint16_t*)malloc(CANVAS_BUFFER_PIXELS * sizeof(uint16_t));
+  if (this->canvasBuffers[0] == NULL || this->canvasBuffers[1] == NULL ||
+      this->canvas->createSprite(this->tft->width(), this->tft->height()) ==
+          NULL) {
+    Serial.println("Not enough memory for GUI canvas, drawing directly "
+                   "instead");
+    free(this->canvasBuffers[0]);
+    free(this->canvasBuffers[1]);
+    this->canvasBuffers[0] = NULL;
+    this->canvasBuffers[1] = NULL;
+    delete this->canvas;
+    this->canvas = NULL;
+  } else {
+    // Sprite colors are palette indexes, the GUI only uses black (0) and
+    // white (0xFFFF & 0x0F)
+    for (uint8_t i = 0; i < 16; i++) {
+      this->canvasPalette[i] = TFT_BLACK;
+    }
+    this->canvasPalette[TFT_WHITE & 0x0F] = TFT_WHITE;
+    this->canvasPalette[CANVAS_TRANSPARENT] = TFT_MAGENTA;
+    this->canvas->createPalette(this->canvasPalette);
+    this->canvas->setTextWrap(false);
+    this->clearCanvas();
+    this->surface = this->canvas;
+  }
+#endif
+
   return true;
 }
 
@@ -35,34 +104,33 @@ void ESP32CameraGUI::dialog(const char* title, const char* text) {
   const uint8_t fontX = boxX + charWidth / 2;
   uint8_t fontY = boxY + charHeight;
 
-  this->tft->fillRoundRect(boxX, boxY, boxWidth, boxHeight, charWidth + 1,
-                           boxColor);
-  this->tft->drawRoundRect(boxX, boxY, boxWidth, boxHeight, charWidth - 1,
-                           textColor);
+  this->clearCanvas();
+  this->surface->fillRoundRect(boxX, boxY, boxWidth, boxHeight, charWidth + 1,
+                               boxColor);
+  this->surface->drawRoundRect(boxX, boxY, boxWidth, boxHeight, charWidth - 1,
+                               textColor);
+  this->markCanvas(boxX, boxY, boxWidth, boxHeight);
 
-  this->tft->setTextColor(textColor, boxColor);
-  this->tft->setCursor(fontX, fontY);
-  this->tft->print(" ");
-  this->tft->print(title);
+  this->drawTextRow(fontX, fontY, " ", title, strlen(title), textColor,
+                    boxColor);
 
   fontY += charHeight * 0.5;
 
-  bool newLineStarted = true;
-  for (uint16_t i = 0; i < strlen(text); i++) {
-    if (newLineStarted) {
-      newLineStarted = false;
-      fontY += charHeight;
-      this->tft->setCursor(fontX, fontY);
-      this->tft->print(" ");
-    }
-    const char c = text[i];
-    if (c == '\n') {
-      newLineStarted = true;
-    } else {
-      this->tft->print(c);
+  const char* line = text;
+  while (true) {
+    const char* lineEnd = strchr(line, '\n');
+    const size_t lineLength = lineEnd != NULL ? lineEnd - line : strlen(line);
+    fontY += charHeight;
+    this->drawTextRow(fontX, fontY, " ", line, lineLength, textColor,
+                      boxColor);
+    if (lineEnd == NULL) {
+      break;
     }
+    line = lineEnd + 1;
   }
 
+  this->pushCanvas();
+
   while (!this->selectButton->pressed()) {
     this->drawBottomToolbar();
     delay(10);
@@ -86,7 +154,7 @@ uint8_t ESP32CameraGUI::menu(const char* title, const char** menu,
   const uint16_t boxX = leftPadding;
   const uint16_t boxY = topPadding;
 
-  const uint8_t maxEntryPerPage = 10;
+  const uint8_t maxEntryPerPage = MENU_MAX_ENTRY_PER_PAGE;
   const uint16_t timePerChar = 200;
   const uint8_t startEndPauseTicks = 4;
   const uint16_t holdToAccelTime = 500;
@@ -104,15 +172,33 @@ uint8_t ESP32CameraGUI::menu(const char* title, const char** menu,
   const uint8_t fontX = boxX + charWidth / 2;
   uint8_t fontY = boxY + charHeight;
 
-  this->tft->fillRoundRect(boxX, boxY, boxWidth, boxHeight, charWidth + 1,
-                           boxColor);
-  this->tft->drawRoundRect(boxX, boxY, boxWidth, boxHeight, charWidth - 1,
-                           textColor);
-
-  this->tft->setTextColor(textColor, boxColor);
-  this->tft->setCursor(fontX, fontY);
-  this->tft->print(" ");
-  this->tft->print(title);
+  // A menu restored by popOverlay() is already on the screen, so only the rows
+  // that differ from it get redrawn
+  const bool restored = this->restoredMenuState.title == title &&
+                        this->restoredMenuState.menu == menu &&
+                        this->restoredMenuState.menuCount == menuCount &&
+                        this->restoredMenuState.startingSelected ==
+                            startingSelected;
+  MenuState state;
+  if (restored) {
+    state = this->restoredMenuState;
+  } else {
+    state.title = title;
+    state.menu = menu;
+    state.menuCount = menuCount;
+    state.startingSelected = startingSelected;
+
+    this->clearCanvas();
+    this->surface->fillRoundRect(boxX, boxY, boxWidth, boxHeight,
+                                 charWidth + 1, boxColor);
+    this->surface->drawRoundRect(boxX, boxY, boxWidth, boxHeight,
+                                 charWidth - 1, textColor);
+    this->markCanvas(boxX, boxY, boxWidth, boxHeight);
+
+    this->drawTextRow(fontX, fontY, " ", title, strlen(title), textColor,
+                      boxColor);
+  }
+  this->restoredMenuState = MenuState();
 
   fontY += charHeight * 1.5;
 
@@ -131,57 +217,59 @@ uint8_t ESP32CameraGUI::menu(const char* title, const char** menu,
   uint8_t selectedCharOffset = 0;
   bool resetAfterPause = false;
 
+  MenuRowState* rows = state.rows;
+#ifdef DEBUG_MENU_LATENCY
+  uint32_t redrawStartTime = micros();
+#endif
+
   while (true) {
+    uint8_t rowsDrawn = 0;
     for (int i = offset;
          i < min((uint16_t)menuCount, (uint16_t)(offset + maxEntryPerPage));
          i++) {
-      if (i == selected) {
-        this->tft->setTextColor(boxColor, textColor);
-      } else {
-        this->tft->setTextColor(textColor, boxColor);
+      const size_t charOffset =
+          i == selected ? min((size_t)selectedCharOffset, strlen(menu[i])) : 0;
+      if (!this->updateMenuRow(&rows[i - offset], i, i == selected,
+                               charOffset)) {
+        continue;
       }
-      this->tft->setCursor(fontX, fontY + charHeight * (i - offset));
+      rowsDrawn++;
+      const char* prefix = " ";
       if (startingSelected != 0xFF) {
-        if (i == startingSelected) {
-          this->tft->print(" > ");
-        } else {
-          this->tft->print("   ");
-        }
-      } else {
-        this->tft->print(" ");
-      }
-      if (i == selected) {
-        for (uint8_t j = 1;
-             j < min((size_t)maxCharPerRow - 2, strlen(menu[i]) + 1); j++) {
-          this->tft->print(menu[i][j - 1 + selectedCharOffset]);
-        }
-      } else {
-        for (uint8_t j = 1;
-             j < min((size_t)maxCharPerRow - 2, strlen(menu[i]) + 1); j++) {
-          this->tft->print(menu[i][j - 1]);
-        }
-      }
-      if (strlen(menu[i]) > maxCharPerRow - 3) {
-        this->tft->print(" ");
-      }
-      for (int j = strlen(menu[i]); j < maxCharPerRow - 2; j++) {
-        this->tft->print(" ");
+        prefix = i == startingSelected ? " > " : "   ";
       }
+      this->drawTextRow(
+          fontX, fontY + charHeight * (i - offset), prefix,
+          menu[i] + charOffset,
+          min((size_t)maxCharPerRow - 3, strlen(menu[i]) - charOffset),
+          i == selected ? boxColor : textColor,
+          i == selected ? textColor : boxColor,
+          strlen(prefix) + maxCharPerRow - 2);
     }
 
-    if (showScrollbar) {
+    if (showScrollbar && state.scrollOffset != offset) {
+      state.scrollOffset = offset;
       const uint8_t startY =
         map(min((int16_t)offset, (int16_t)(menuCount - maxEntryPerPage)), 0,
             menuCount, scrollBarY, scrollBarY + scrollBarHeight);
       const uint8_t barHeight =
         map(maxEntryPerPage, 0, menuCount, 0, scrollBarHeight);
 
-      this->tft->fillRect(scrollBarX, scrollBarY, scrollBarWidth,
-                          scrollBarHeight, boxColor);
-      this->tft->fillRect(scrollBarX, startY, scrollBarWidth, barHeight,
-                          textColor);
+      this->surface->fillRect(scrollBarX, scrollBarY, scrollBarWidth,
+                              scrollBarHeight, boxColor);
+      this->surface->fillRect(scrollBarX, startY, scrollBarWidth, barHeight,
+                              textColor);
+      this->markCanvas(scrollBarX, scrollBarY, scrollBarWidth,
+                       scrollBarHeight);
     }
 
+    this->pushCanvas();
+
+#ifdef DEBUG_MENU_LATENCY
+    Serial.printf("Menu redraw: %lu us, %d rows\n", micros() - redrawStartTime,
+                  rowsDrawn);
+#endif
+
     this->drawBottomToolbar();
 
     while (millis() - lastMovedTime < moveThrottleTime) {
@@ -223,6 +311,7 @@ uint8_t ESP32CameraGUI::menu(const char* title, const char** menu,
         break;
       }
       if (this->selectButton->pressed()) {
+        this->lastMenuState = state;
         return selected;
       }
       if (millis() - selectedTime > timePerChar &&
@@ -247,6 +336,10 @@ uint8_t ESP32CameraGUI::menu(const char* title, const char** menu,
       }
     }
 
+#ifdef DEBUG_MENU_LATENCY
+    redrawStartTime = micros();
+#endif
+
     if (selected >= offset + maxEntryPerPage) {
       offset += selected - (offset + maxEntryPerPage) + 1;
     } else if (selected < offset) {
@@ -513,54 +606,372 @@ bool ESP32CameraGUI::changeRTCTime() {
 }
 
 void ESP32CameraGUI::drawBottomToolbar(bool forceDraw) {
+#ifdef DEBUG_BOTTOM_TOOLBAR
+  const uint32_t startTime = micros();
+#endif
+
+  bool changed = false;
+
   if (millis() - this->lastBottomToolbarDraw > BOTTOM_TOOLBAR_DRAW_THROTTLE ||
-      forceDraw || needToRedrawBottom) {
+      needToRedrawBottom) {
     this->lastBottomToolbarDraw = millis();
     this->needToRedrawBottom = false;
 
-    const uint8_t charWidth = 6;
-    const uint8_t charHeight = 8;
+    char text[ESP32CameraGUI::maxBottomToolbarSize + 1];
+    memset(text, 0, ESP32CameraGUI::maxBottomToolbarSize + 1);
+    this->getBottomToolbarText(text, ESP32CameraGUI::maxBottomToolbarSize + 1);
+
+    if (strcmp(text, this->bottomToolbarText) != 0) {
+      strncpy(this->bottomToolbarText, text,
+              ESP32CameraGUI::maxBottomToolbarSize);
+      changed = true;
+      if (this->bottomToolbar != NULL) {
+        this->bottomToolbar->setCursor(0, 0);
+        this->bottomToolbar->print(this->bottomToolbarText);
+      }
+    }
+  }
 
-    const uint16_t textX = 0;
-    const uint16_t textY = this->tft->height() - charHeight;
+  if (!changed && !forceDraw) {
+    return;
+  }
 
-    this->tft->setCursor(textX, textY);
+  const uint8_t charHeight = 8;
+  const uint16_t textY = this->tft->height() - charHeight;
+
+  if (this->bottomToolbar != NULL) {
+    this->bottomToolbar->pushSprite(0, textY);
+  } else {
+    this->tft->setCursor(0, textY);
     this->tft->setTextColor(TFT_WHITE, TFT_BLACK);
+    this->tft->setTextWrap(false);
+    this->tft->print(this->bottomToolbarText);
+    this->tft->setTextWrap(true);
+  }
 
-    if (this->hasCustomBottomText) {
-      this->tft->print(this->customBottomText);
-      this->tft->setTextWrap(false);
-      for (uint8_t i = strlen(this->customBottomText);
-           i < ESP32CameraGUI::maxBottomTextSize + 1; i++) {
-        this->tft->print(" ");
-      }
-      this->tft->setTextWrap(true);
+#ifdef DEBUG_BOTTOM_TOOLBAR
+  Serial.printf("Bottom toolbar %s in %lu us\n",
+                changed ? "rebuilt" : "pushed", micros() - startTime);
+#endif
+}
+
+void ESP32CameraGUI::drawHistogram(const uint16_t* buckets,
+                                   uint8_t bucketCount, uint32_t samples,
+                                   int16_t x, int16_t y) {
+  if (this->histogram == NULL || bucketCount == 0) {
+    return;
+  }
+
+  // Palette indexes
+  const uint8_t backgroundColor = 0;
+  const uint8_t borderColor = 1;
+  const uint8_t barColor = 2;
+  const uint8_t clipColor = 3;
+
+  const uint8_t barWidth = max(1, (HISTOGRAM_WIDTH - 2) / bucketCount);
+  const uint8_t maxBarHeight = HISTOGRAM_HEIGHT - 2;
+
+  uint16_t peak = 1;
+  for (uint8_t i = 0; i < bucketCount; i++) {
+    peak = max(peak, buckets[i]);
+  }
+  const bool clippedLow =
+      (uint32_t)buckets[0] * HISTOGRAM_CLIP_FRACTION > samples;
+  const bool clippedHigh =
+      (uint32_t)buckets[bucketCount - 1] * HISTOGRAM_CLIP_FRACTION > samples;
+
+  this->histogram->fillSprite(backgroundColor);
+  this->histogram->drawRect(0, 0, HISTOGRAM_WIDTH, HISTOGRAM_HEIGHT,
+                            borderColor);
+  if (clippedLow) {
+    this->histogram->drawFastVLine(0, 0, HISTOGRAM_HEIGHT, clipColor);
+  }
+  if (clippedHigh) {
+    this->histogram->drawFastVLine(HISTOGRAM_WIDTH - 1, 0, HISTOGRAM_HEIGHT,
+                                   clipColor);
+  }
+  for (uint8_t i = 0; i < bucketCount; i++) {
+    const uint8_t barHeight = (uint32_t)buckets[i] * maxBarHeight / peak;
+    const bool clipped = (i == 0 && clippedLow) ||
+                         (i == bucketCount - 1 && clippedHigh);
+    this->histogram->fillRect(1 + i * barWidth, 1 + maxBarHeight - barHeight,
+                              barWidth, barHeight,
+                              clipped ? clipColor : barColor);
+  }
+
+  this->histogram->pushSprite(x, y);
+}
 
-      if (millis() > this->customBottomTextExpire) {
-        this->hasCustomBottomText = false;
-        this->needToRedrawBottom = true;
+// Builds the whole toolbar line, padded to the width of the display so it
+// covers whatever was there before
+void ESP32CameraGUI::getBottomToolbarText(char* dest, size_t destSize) {
+  const uint8_t charWidth = 6;
+  const size_t lineLength =
+      min((size_t)(this->tft->width() / charWidth), destSize - 1);
+
+  if (this->hasCustomBottomText) {
+    strncpy(dest, this->customBottomText, destSize - 1);
+
+    if (millis() > this->customBottomTextExpire) {
+      this->hasCustomBottomText = false;
+      this->needToRedrawBottom = true;
+    }
+  } else {
+    DateTime now = this->rtc->now();
+    snprintf(dest, destSize, "%d/%d/%d %d:%.2d", now.year(), now.month(),
+             now.day(), now.hour(), now.minute());
+
+    const uint8_t bufSize = 16;
+    char buf[bufSize];
+    memset(buf, 0, bufSize);
+    snprintf(buf, bufSize, "%d%%", this->getBattPercent());
+
+    for (size_t i = strlen(dest); i < lineLength - strlen(buf); i++) {
+      dest[i] = ' ';
+    }
+    dest[lineLength - strlen(buf)] = '\0';
+    strncat(dest, buf, destSize - strlen(dest) - 1);
+  }
+
+  for (size_t i = strlen(dest); i < lineLength; i++) {
+    dest[i] = ' ';
+  }
+  dest[lineLength] = '\0';
+}
+
+// Returns true if the row has to be redrawn to show the given entry
+bool ESP32CameraGUI::updateMenuRow(MenuRowState* state, uint32_t index,
+                                   bool selected, uint8_t charOffset) {
+  if (state->index == index && state->selected == selected &&
+      state->charOffset == charOffset) {
+    return false;
+  }
+  state->index = index;
+  state->selected = selected;
+  state->charOffset = charOffset;
+  return true;
+}
+
+// Draws prefix followed by the first textLength characters of text as a single
+// run, padded with the background color up to padToChars characters
+void ESP32CameraGUI::drawTextRow(int32_t x, int32_t y, const char* prefix,
+                                 const char* text, size_t textLength,
+                                 uint16_t fg, uint16_t bg,
+                                 int32_t padToChars) {
+  const size_t bufSize = 64;
+  char buf[bufSize];
+  memset(buf, 0, bufSize);
+  strncpy(buf, prefix, bufSize - 1);
+  const size_t prefixLength = strlen(buf);
+  strncpy(buf + prefixLength, text,
+          min(textLength, bufSize - 1 - prefixLength));
+  this->surface->drawTextRun(x, y, buf, strlen(buf), fg, bg, padToChars);
+  this->markCanvas(x, y, max((int32_t)strlen(buf), padToChars) * 6, 8);
+}
+
+// Saves the canvas before a modal dialog or menu is drawn over it. Every call
+// has to be matched by popOverlay(), even when this returns false because the
+// copy did not fit.
+bool ESP32CameraGUI::pushOverlay() {
+  const uint8_t depth = this->overlayDepth++;
+  if (this->canvas == NULL || depth >= OVERLAY_STACK_SIZE) {
+    return false;
+  }
+
+  Overlay* overlay = &this->overlays[depth];
+  const uint32_t size = this->tft->width() * this->tft->height() / 2;
+  if (this->overlayBytes + size > OVERLAY_MAX_BYTES) {
+    Serial.println("Overlay stack is full, parent will be redrawn");
+    return false;
+  }
+  overlay->pixels = (uint8_t*)malloc(size);
+  if (overlay->pixels == NULL) {
+    Serial.println("Not enough memory for overlay, parent will be redrawn");
+    return false;
+  }
+  memcpy(overlay->pixels, this->canvas->getPointer(), size);
+  overlay->menuState = this->lastMenuState;
+  this->overlayBytes += size;
+  return true;
+}
+
+// Puts the canvas saved by the matching pushOverlay() back on the screen in
+// one push. Returns false if nothing was restored, in which case the caller
+// has to redraw.
+bool ESP32CameraGUI::popOverlay(bool restore) {
+  if (this->overlayDepth == 0) {
+    return false;
+  }
+  const uint8_t depth = --this->overlayDepth;
+  if (depth >= OVERLAY_STACK_SIZE || this->overlays[depth].pixels == NULL) {
+    return false;
+  }
+
+  Overlay* overlay = &this->overlays[depth];
+  const uint32_t size = this->tft->width() * this->tft->height() / 2;
+  if (restore) {
+    memcpy(this->canvas->getPointer(), overlay->pixels, size);
+    this->markCanvas(0, 0, this->tft->width(), this->tft->height());
+    this->pushCanvas();
+    this->lastMenuState = overlay->menuState;
+    this->restoredMenuState = overlay->menuState;
+  }
+  free(overlay->pixels);
+  overlay->pixels = NULL;
+  this->overlayBytes -= size;
+  return restore;
+}
+
+// Resets the canvas to fully transparent, so whatever is on the screen around a
+// new dialog stays there
+void ESP32CameraGUI::clearCanvas() {
+  if (this->canvas != NULL) {
+    this->canvas->fillSprite(CANVAS_TRANSPARENT);
+  }
+  this->lastMenuState = MenuState();
+  this->restoredMenuState = MenuState();
+  this->canvasDirtyX1 = this->tft->width();
+  this->canvasDirtyY1 = this->tft->height();
+  this->canvasDirtyX2 = 0;
+  this->canvasDirtyY2 = 0;
+}
+
+void ESP32CameraGUI::markCanvas(int16_t x, int16_t y, int16_t w, int16_t h) {
+  this->canvasDirtyX1 = max((int16_t)0, min(this->canvasDirtyX1, x));
+  this->canvasDirtyY1 = max((int16_t)0, min(this->canvasDirtyY1, y));
+  this->canvasDirtyX2 =
+      min((int16_t)this->tft->width(), max(this->canvasDirtyX2, (int16_t)(x + w)));
+  this->canvasDirtyY2 = min((int16_t)this->tft->height(),
+                            max(this->canvasDirtyY2, (int16_t)(y + h)));
+}
+
+// Pushes the changed area of the canvas. Transparent pixels are skipped at the
+// start and end of each row (the rounded corners), rows with the same span are
+// sent through one window, expanded from the palette into two buffers so one
+// can be filled while the other is sent with DMA.
+void ESP32CameraGUI::pushCanvas() {
+  if (this->canvas == NULL || this->canvasDirtyX1 >= this->canvasDirtyX2 ||
+      this->canvasDirtyY1 >= this->canvasDirtyY2) {
+    return;
+  }
+
+  // Buffers hold big endian pixels, which is what the display wants
+  uint16_t colors[16];
+  for (uint8_t i = 0; i < 16; i++) {
+    const uint16_t color = this->canvasPalette[i];
+    colors[i] = (color >> 8) | (color << 8);
+  }
+  const bool swapBytes = this->tft->getSwapBytes();
+  const bool useDMA = this->tft->DMA_Enabled;
+  uint8_t bufferIndex = 0;
+
+  this->tft->setSwapBytes(false);
+  this->tft->startWrite();
+  int16_t y = this->canvasDirtyY1;
+  while (y < this->canvasDirtyY2) {
+    int16_t spanStart = this->canvasDirtyX1;
+    int16_t spanEnd = this->canvasDirtyX2;
+    while (spanStart < spanEnd &&
+           this->getCanvasIndex(spanStart, y) == CANVAS_TRANSPARENT) {
+      spanStart++;
+    }
+    while (spanEnd > spanStart &&
+           this->getCanvasIndex(spanEnd - 1, y) == CANVAS_TRANSPARENT) {
+      spanEnd--;
+    }
+    if (spanStart == spanEnd) {
+      y++;
+      continue;
+    }
+
+    const int16_t w = spanEnd - spanStart;
+    const int16_t maxRows = CANVAS_BUFFER_PIXELS / w;
+    int16_t rows = 1;
+    while (rows < maxRows && y + rows < this->canvasDirtyY2 &&
+           this->getCanvasIndex(spanStart, y + rows) != CANVAS_TRANSPARENT &&
+           this->getCanvasIndex(spanEnd - 1, y + rows) != CANVAS_TRANSPARENT &&
+           (spanStart == this->canvasDirtyX1 ||
+            this->getCanvasIndex(spanStart - 1, y + rows) ==
+                CANVAS_TRANSPARENT) &&
+           (spanEnd == this->canvasDirtyX2 ||
+            this->getCanvasIndex(spanEnd, y + rows) == CANVAS_TRANSPARENT)) {
+      rows++;
+    }
+
+    uint16_t* buffer = this->canvasBuffers[bufferIndex];
+    for (int16_t i = 0; i < rows; i++) {
+      for (int16_t x = spanStart; x < spanEnd; x++) {
+        *buffer++ = colors[this->getCanvasIndex(x, y + i)];
       }
+    }
+    if (useDMA) {
+      // Waits for the other buffer to finish sending first
+      this->tft->pushImageDMA(spanStart, y, w, rows,
+                              (const uint16_t*)this->canvasBuffers[bufferIndex]);
+      bufferIndex ^= 1;
     } else {
-      DateTime now = this->rtc->now();
+      this->tft->setAddrWindow(spanStart, y, w, rows);
+      this->tft->pushPixels(this->canvasBuffers[bufferIndex], w * rows);
+    }
+    y += rows;
+  }
+  this->tft->endWrite();
+  this->tft->setSwapBytes(swapBytes);
 
-      this->tft->printf("%d/%d/%d %d:%.2d ", now.year(), now.month(), now.day(),
-                        now.hour(), now.minute());
-      this->tft->setTextWrap(false);
-      for (uint8_t i = 10; i < ESP32CameraGUI::maxBottomTextSize + 1; i++) {
-        this->tft->print(" ");
-      }
-      this->tft->setTextWrap(true);
+  this->canvasDirtyX1 = this->tft->width();
+  this->canvasDirtyY1 = this->tft->height();
+  this->canvasDirtyX2 = 0;
+  this->canvasDirtyY2 = 0;
+}
 
-      const uint8_t bufSize = 16;
-      char buf[bufSize];
-      memset(buf, 0, bufSize);
+uint8_t ESP32CameraGUI::getCanvasIndex(int16_t x, int16_t y) {
+  const uint8_t* pixels = (const uint8_t*)this->canvas->getPointer();
+  const uint8_t pair = pixels[(x + y * this->tft->width()) >> 1];
+  return (x & 0x01) == 0 ? pair >> 4 : pair & 0x0F;
+}
 
-      snprintf(buf, bufSize, "%d%%", this->getBattPercent());
-      this->tft->setCursor(this->tft->width() - charWidth * strlen(buf),
-                           this->tft->height() - charHeight);
-      this->tft->print(buf);
+// Fills the screen with text lines, first one character at a time then with
+// text runs, and logs the characters per second of both. Returns the text run
+// rate.
+uint32_t ESP32CameraGUI::benchmarkText(uint16_t lines) {
+  const uint16_t boxColor = TFT_WHITE;
+  const uint16_t textColor = TFT_BLACK;
+  const uint8_t charWidth = 6;
+  const uint8_t charHeight = 8;
+  const uint8_t charsPerLine = this->tft->width() / charWidth;
+  const uint8_t linesPerScreen = this->tft->height() / charHeight;
+  const uint32_t charCount = (uint32_t)lines * charsPerLine;
+
+  char line[charsPerLine + 1];
+  for (uint8_t i = 0; i < charsPerLine; i++) {
+    line[i] = 'A' + i % 26;
+  }
+  line[charsPerLine] = '\0';
+
+  this->tft->setTextSize(1);
+  this->tft->setTextColor(textColor, boxColor);
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < lines; i++) {
+    this->tft->setCursor(0, (i % linesPerScreen) * charHeight);
+    for (uint8_t j = 0; j < charsPerLine; j++) {
+      this->tft->print(line[j]);
     }
   }
+  const uint32_t printTime = max(micros() - start, (uint32_t)1);
+
+  start = micros();
+  for (uint16_t i = 0; i < lines; i++) {
+    this->tft->drawTextRun(0, (i % linesPerScreen) * charHeight, line,
+                           charsPerLine, textColor, boxColor);
+  }
+  const uint32_t runTime = max(micros() - start, (uint32_t)1);
+
+  const uint32_t printRate = (uint64_t)charCount * 1000000 / printTime;
+  const uint32_t runRate = (uint64_t)charCount * 1000000 / runTime;
+  Serial.printf("Text benchmark: %u chars, print %u chars/s, run %u chars/s\n",
+                charCount, printRate, runRate);
+  this->needToRedrawBottom = true;
+  return runRate;
 }
 
 void ESP32CameraGUI::setBottomText(const char* text, uint32_t expireTime) {
@@ -8,12 +8,54 @@
 typedef FsFile File;
 
 #include <Button.h>
+#include <ImageCache.h>
 #include <JPEGDEC.h>
+#include <JPEGRenderer.h>
+#include <ParallelJPEG.h>
 #include <RTClib.h>
+#include <ThumbnailDB.h>
+
+// #define DEBUG_BOTTOM_TOOLBAR
+// #define DEBUG_MENU_LATENCY
+// #define DISABLE_OFFSCREEN_GUI
 
 const uint32_t BOTTOM_TOOLBAR_DRAW_THROTTLE = 1000;
 const uint32_t UNLIMITED_BOTTOM_TEXT_TIME = 0xFFFFFFFF;
 
+// Palette index of canvas pixels that are not pushed to the screen
+const uint8_t CANVAS_TRANSPARENT = 1;
+// Size of each of the two buffers the canvas is expanded into while pushing
+const uint16_t CANVAS_BUFFER_PIXELS = 160 * 8;
+
+// Modal overlays save a copy of the canvas (10 KB each) so the screen under
+// them can be restored, past this limit the parent is redrawn instead
+const uint8_t OVERLAY_STACK_SIZE = 4;
+const uint32_t OVERLAY_MAX_BYTES = 2 * 160 * 128 / 2;
+
+const uint8_t MENU_MAX_ENTRY_PER_PAGE = 10;
+
+// The image viewer zooms from 1/8 (JPEGDEC's smallest scale) up to 1:1
+const uint8_t IMAGE_VIEWER_ZOOM_LEVELS = 4;
+// Images past this many in a directory can not be stepped to in the viewer
+const uint16_t IMAGE_VIEWER_MAX_IMAGES = 512;
+
+// Slideshow images shown more than this many ms after they were due count as
+// late
+const uint16_t SLIDESHOW_LATE_TOLERANCE = 50;
+
+// Gallery grid cells, a thumbnail in the middle of each with room around it
+// for the selection frame
+const uint8_t GALLERY_COLUMNS = 4;
+const uint8_t GALLERY_ROWS = 4;
+const uint8_t GALLERY_CELL_WIDTH = 40;
+const uint8_t GALLERY_CELL_HEIGHT = 30;
+
+// The histogram drawn over the preview, the darkest or brightest bucket
+// holding more than 1 / HISTOGRAM_CLIP_FRACTION of the samples shows clipping
+const uint8_t HISTOGRAM_WIDTH = 66;
+const uint8_t HISTOGRAM_HEIGHT = 26;
+const uint8_t HISTOGRAM_CLIP_FRACTION = 50;
+
 class ESP32CameraGUI {
   public:
     bool begin(TFT_eSPI* tft, SdFs* sd, RTC_DS3231* rtc, Button* upButton,
@@ -33,13 +75,24 @@ class ESP32CameraGUI {
                       int32_t* endingFileIndex = NULL,
                       int32_t* endingOffset = NULL);
     bool changeRTCTime();
-    void imageViewer(const char* path, JPEGDEC* decoder);
+    void imageViewer(const char* path, JPEGDEC* decoder,
+                     JPEGRenderer* renderer = NULL,
+                     ParallelJPEG* parallel = NULL, ImageCache* cache = NULL,
+                     ThumbnailDB* thumbnails = NULL);
+    void slideshow(const char* directory, JPEGDEC* decoder, ImageCache* cache,
+                   uint32_t interval);
+    bool gallery(ThumbnailDB* db, JPEGDEC* decoder, char* result,
+                 size_t resultSize, bool update = true,
+                 uint16_t startingIndex = 0, uint16_t* endingIndex = NULL);
+    bool updateThumbnails(ThumbnailDB* db, JPEGDEC* decoder, bool rebuild);
 
     void setBottomText(const char* text, uint32_t expireTime);
     void setBottomText(char* text, uint32_t expireTime) {
       this->setBottomText((const char*)text, expireTime);
     }
     void drawBottomToolbar(bool forceDraw = false);
+    void drawHistogram(const uint16_t* buckets, uint8_t bucketCount,
+                       uint32_t samples, int16_t x, int16_t y);
 
     bool getFileCount(const char* start, uint32_t& result);
     bool getFileFromIndex(const char* start, uint32_t index, FsFile* result);
@@ -47,10 +100,70 @@ class ESP32CameraGUI {
                               size_t resultSize);
     bool getIndexFromFileName(const char* start, const char* filename,
                               uint32_t* result);
+    bool getImageIndices(const char* start, const char* currentName,
+                         uint32_t* result, uint16_t resultSize,
+                         uint16_t* count, uint16_t* current);
+    bool getFileNameFromDirIndex(const char* start, uint32_t dirIndex,
+                                 char* result, size_t resultSize);
 
     uint8_t getBattPercent();
 
+    bool pushOverlay();
+    bool popOverlay(bool restore = true);
+
+    uint32_t benchmarkText(uint16_t lines);
+
   protected:
+    // What a menu or file explorer row last showed, so only rows whose
+    // content changed get redrawn
+    struct MenuRowState {
+        uint32_t index = 0xFFFFFFFF;
+        uint8_t charOffset = 0;
+        bool selected = false;
+    };
+
+    bool updateMenuRow(MenuRowState* state, uint32_t index, bool selected,
+                       uint8_t charOffset);
+
+    // Identifies a menu on the canvas and what each of its rows shows
+    struct MenuState {
+        const char* title = NULL;
+        const char** menu = NULL;
+        uint8_t menuCount = 0;
+        uint8_t startingSelected = 0xFF;
+        int16_t scrollOffset = -1;
+        MenuRowState rows[MENU_MAX_ENTRY_PER_PAGE];
+    };
+
+    struct Overlay {
+        uint8_t* pixels = NULL;
+        MenuState menuState;
+    };
+
+    void clearCanvas();
+    void markCanvas(int16_t x, int16_t y, int16_t w, int16_t h);
+    void pushCanvas();
+    uint8_t getCanvasIndex(int16_t x, int16_t y);
+
+    bool getImagePath(const char* directory, uint32_t dirIndex, char* result,
+                      size_t resultSize);
+    static bool isAnyButtonDown(void* param);
+    void drawCoarseImage(const uint16_t* pixels, uint16_t width,
+                         uint16_t height, uint16_t stride, uint16_t imageWidth,
+                         uint16_t imageHeight, int32_t viewX, int32_t viewY,
+                         uint8_t zoom);
+
+    static void getGalleryTilePosition(uint16_t tile, int32_t* x, int32_t* y);
+    void drawGallerySelection(uint16_t tile, uint16_t color);
+    static void drawGalleryTile(uint16_t index, const uint16_t* pixels,
+                                void* param);
+    static void showThumbnailProgress(uint16_t done, void* param);
+
+    void getBottomToolbarText(char* dest, size_t destSize);
+    void drawTextRow(int32_t x, int32_t y, const char* prefix, const char* text,
+                     size_t textLength, uint16_t fg, uint16_t bg,
+                     int32_t padToChars = 0);
+
     bool began = false;
 
     uint8_t battPin;
@@ -62,6 +175,36 @@ class ESP32CameraGUI {
     static const size_t maxBottomTextSize = 26;
     char customBottomText[maxBottomTextSize + 1];
 
+    // The toolbar is rendered into a 1 bit sprite that is only rebuilt when
+    // the text on it changes, otherwise redraws are a single push
+    TFT_eSprite* bottomToolbar = NULL;
+    static const size_t maxBottomToolbarSize = 32;
+    char bottomToolbarText[maxBottomToolbarSize + 1];
+
+    // 4 bit sprite with its own palette, so a histogram update is one push
+    TFT_eSprite* histogram = NULL;
+    uint16_t histogramPalette[16];
+
+    // Dialogs, menus and the file explorer are composed in a 4 bit screen
+    // sized sprite, and only the changed area is pushed. surface is the
+    // canvas, or the display itself if the canvas could not be allocated.
+    TFT_eSprite* canvas = NULL;
+    TFT_eSPI* surface = NULL;
+    uint16_t* canvasBuffers[2] = {NULL, NULL};
+    uint16_t canvasPalette[16];
+    int16_t canvasDirtyX1 = 0;
+    int16_t canvasDirtyY1 = 0;
+    int16_t canvasDirtyX2 = 0;
+    int16_t canvasDirtyY2 = 0;
+
+    Overlay overlays[OVERLAY_STACK_SIZE];
+    uint8_t overlayDepth = 0;
+    uint32_t overlayBytes = 0;
+    // The menu last drawn on the canvas, and the one just restored from an
+    // overlay which menu() can continue from instead of redrawing
+    MenuState lastMenuState;
+    MenuState restoredMenuState;
+
     TFT_eSPI* tft;
     SdFs* sd;
     RTC_DS3231* rtc;
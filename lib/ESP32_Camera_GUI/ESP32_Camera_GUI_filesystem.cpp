@@ -88,14 +88,15 @@ bool ESP32CameraGUI::fileExplorer(const char* startDirectory, char* result,
     const uint8_t fontX = boxX + charWidth / 2;
     uint8_t fontY = boxY + charHeight;
 
-    this->tft->fillRoundRect(boxX, boxY, boxWidth, boxHeight, charWidth + 1,
-                             boxColor);
-    this->tft->drawRoundRect(boxX, boxY, boxWidth, boxHeight, charWidth - 1,
-                             textColor);
+    this->clearCanvas();
+    this->surface->fillRoundRect(boxX, boxY, boxWidth, boxHeight,
+                                 charWidth + 1, boxColor);
+    this->surface->drawRoundRect(boxX, boxY, boxWidth, boxHeight,
+                                 charWidth - 1, textColor);
+    this->markCanvas(boxX, boxY, boxWidth, boxHeight);
 
-    this->tft->setTextColor(textColor, boxColor);
-    this->tft->setCursor(fontX, fontY);
-    this->tft->print(" File explorer");
+    this->drawTextRow(fontX, fontY, " File explorer", "", 0, textColor,
+                      boxColor);
 
     fontY += charHeight * 1.5;
 
@@ -143,6 +144,14 @@ bool ESP32CameraGUI::fileExplorer(const char* startDirectory, char* result,
 
     bool needToCompleteRedraw = false;
 
+    MenuRowState rows[maxEntryPerPage];
+    int32_t drawnScrollOffset = -1;
+    int16_t drawnTitleOffset = -1;
+    bool firstDraw = true;
+#ifdef DEBUG_MENU_LATENCY
+    uint32_t redrawStartTime = micros();
+#endif
+
     while (!needToCompleteRedraw) {
       if (menuEntryOffset != offset) {
         menuEntryOffset = offset;
@@ -242,16 +251,17 @@ bool ESP32CameraGUI::fileExplorer(const char* startDirectory, char* result,
         }
       }
 
-      this->tft->setTextColor(textColor, boxColor);
-      this->tft->setCursor(titleX, titleY);
-      this->tft->print(" ");
       // Serial.printf("Title: %s\n", currentDirectory);
-      for (uint8_t i = 1;
-           i < min((size_t)maxCharInTitle, strlen(currentDirectory) + 1); i++) {
-        this->tft->print(currentDirectory[i - 1 + titleSelectedCharOffset]);
-        // Serial.print(currentDirectory[i - 1 + titleSelectedCharOffset]);
+      if (drawnTitleOffset != titleSelectedCharOffset) {
+        drawnTitleOffset = titleSelectedCharOffset;
+        this->drawTextRow(
+            titleX, titleY, " ", currentDirectory + titleSelectedCharOffset,
+            min((size_t)maxCharInTitle - 1,
+                strlen(currentDirectory) - titleSelectedCharOffset),
+            textColor, boxColor);
       }
-      // Serial.println();
+
+      uint8_t rowsDrawn = 0;
 
       for (uint32_t i = offset;
            i < min((uint16_t)fileCount, (uint16_t)(offset + maxEntryPerPage));
@@ -259,7 +269,6 @@ bool ESP32CameraGUI::fileExplorer(const char* startDirectory, char* result,
         char* current = menuEntries[i - offset];
 
         if (i == selected) {
-          this->tft->setTextColor(boxColor, textColor);
 
           // char* lastToken = NULL;
           // char* token = NULL;
@@ -278,44 +287,47 @@ bool ESP32CameraGUI::fileExplorer(const char* startDirectory, char* result,
 
           strncpy(selectedPath, current, MAX_PATH_SIZE);
           // Serial.printf("Selected file: \"%s\"\n", selectedPath);
-        } else {
-          this->tft->setTextColor(textColor, boxColor);
         }
-        this->tft->setCursor(fontX, fontY + charHeight * (i - offset));
-        this->tft->print(" ");
-        if (i == selected) {
-          for (uint8_t j = 1;
-               j < min((size_t)maxCharPerRow - 2, strlen(current) + 1); j++) {
-            this->tft->print(current[j - 1 + selectedCharOffset]);
-          }
-        } else {
-          for (uint8_t j = 1;
-               j < min((size_t)maxCharPerRow - 2, strlen(current) + 1); j++) {
-            this->tft->print(current[j - 1]);
-          }
-        }
-        if (strlen(current) > maxCharPerRow - 3) {
-          this->tft->print(" ");
-        }
-        for (int j = strlen(current) + 1; j < maxCharPerRow - 1; j++) {
-          this->tft->print(" ");
+        const size_t charOffset =
+            i == selected ? min((size_t)selectedCharOffset, strlen(current))
+                          : 0;
+        if (!this->updateMenuRow(&rows[i - offset], i, i == selected,
+                                 charOffset)) {
+          continue;
         }
+        rowsDrawn++;
+        this->drawTextRow(
+            fontX, fontY + charHeight * (i - offset), " ", current + charOffset,
+            min((size_t)maxCharPerRow - 3, strlen(current) - charOffset),
+            i == selected ? boxColor : textColor,
+            i == selected ? textColor : boxColor, maxCharPerRow - 1);
       }
 
-      if (showScrollbar) {
+      if (showScrollbar && drawnScrollOffset != offset) {
+        drawnScrollOffset = offset;
         const uint8_t startY =
             map(min((int16_t)offset, (int16_t)(fileCount - maxEntryPerPage)), 0,
                 fileCount, scrollBarY, scrollBarY + scrollBarHeight);
         const uint8_t barHeight =
             map(maxEntryPerPage, 0, fileCount, 0, scrollBarHeight);
 
-        this->tft->fillRect(scrollBarX, scrollBarY, scrollBarWidth,
-                            scrollBarHeight, boxColor);
-        this->tft->fillRect(scrollBarX, startY, scrollBarWidth, barHeight,
-                            textColor);
+        this->surface->fillRect(scrollBarX, scrollBarY, scrollBarWidth,
+                                scrollBarHeight, boxColor);
+        this->surface->fillRect(scrollBarX, startY, scrollBarWidth, barHeight,
+                                textColor);
+        this->markCanvas(scrollBarX, scrollBarY, scrollBarWidth,
+                         scrollBarHeight);
       }
 
-      this->drawBottomToolbar(true);
+      this->pushCanvas();
+
+#ifdef DEBUG_MENU_LATENCY
+      Serial.printf("File explorer redraw: %lu us, %d rows\n",
+                    micros() - redrawStartTime, rowsDrawn);
+#endif
+
+      this->drawBottomToolbar(firstDraw);
+      firstDraw = false;
 
       while (millis() - lastMovedTime < moveThrottleTime) {
         delay(1);
@@ -427,8 +439,10 @@ bool ESP32CameraGUI::fileExplorer(const char* startDirectory, char* result,
           const size_t tempNotifSize = 32;
           char tempNotif[tempNotifSize];
           memset(tempNotif, 0, tempNotifSize);
+          bool fileListChanged = false;
           lastOffset = offset;
           lastSelected = selected;
+          this->pushOverlay();
           while (!exitFileExplorerOptionsMenu) {
             switch (this->menu(fileExplorerOptionsTitle, fileExplorerOptions,
                                fileExplorerOptionsCount)) {
@@ -438,9 +452,13 @@ bool ESP32CameraGUI::fileExplorer(const char* startDirectory, char* result,
                 break;
               }
               case 1: {
-                if (this->menu(fileExplorerDeleteOptionsTitle,
+                this->pushOverlay();
+                const bool confirmed =
+                    this->menu(fileExplorerDeleteOptionsTitle,
                                fileExplorerDeleteOptions,
-                               fileExplorerDeleteOptionsCount) == 1) {
+                               fileExplorerDeleteOptionsCount) == 1;
+                this->popOverlay(!confirmed);
+                if (confirmed) {
                   const size_t tempSize = MAX_PATH_SIZE;
                   char temp[tempSize];
                   memset(temp, 0, tempSize);
@@ -479,6 +497,7 @@ bool ESP32CameraGUI::fileExplorer(const char* startDirectory, char* result,
                   Serial.printf("Selected index is %d, offset is %d\n",
                                 selected, offset);
                   exitFileExplorerOptionsMenu = true;
+                  fileListChanged = true;
                 } else {
                   Serial.printf("Canceled deleting file\n");
                   snprintf(tempNotif, tempNotifSize, "Canceled file deletion.",
@@ -489,6 +508,12 @@ bool ESP32CameraGUI::fileExplorer(const char* startDirectory, char* result,
               }
             }
           }
+          // Nothing under the menu changed unless a file was deleted
+          if (this->popOverlay(!fileListChanged)) {
+            lastOffset = -1;
+            lastSelected = -1;
+            continue;
+          }
           needToCompleteRedraw = true;
           break;
         }
@@ -533,6 +558,10 @@ bool ESP32CameraGUI::fileExplorer(const char* startDirectory, char* result,
           }
         }
       }
+#ifdef DEBUG_MENU_LATENCY
+      redrawStartTime = micros();
+#endif
+
       if (selected >= offset + maxEntryPerPage) {
         offset += selected - (offset + maxEntryPerPage) + 1;
       } else if (selected < offset) {
@@ -657,3 +686,63 @@ bool ESP32CameraGUI::getIndexFromFileName(const char* start,
 
   return true;
 }
+
+// Directory entry indices of the JPEG files in a directory, so they can be
+// opened in order later without walking the directory again. current is set
+// to the position of currentName in the list, or 0 if it is not there.
+bool ESP32CameraGUI::getImageIndices(const char* start, const char* currentName,
+                                     uint32_t* result, uint16_t resultSize,
+                                     uint16_t* count, uint16_t* current) {
+  FsFile dir = this->sd->open(start, O_RDONLY);
+  if (!dir) {
+    return false;
+  }
+
+  FsFile file;
+  *count = 0;
+  *current = 0;
+
+  const size_t MAX_PATH_SIZE = 255;
+  char name[MAX_PATH_SIZE];
+
+  dir.rewindDirectory();
+  while (*count < resultSize && file.openNext(&dir, O_RDONLY)) {
+    file.getName(name, MAX_PATH_SIZE);
+    const char* extension = strrchr(name, '.');
+    if (!file.isHidden() && !file.isDir() && extension != NULL &&
+        (strcasecmp(extension, ".jpg") == 0 ||
+         strcasecmp(extension, ".jpeg") == 0)) {
+      if (strcmp(name, currentName) == 0) {
+        *current = *count;
+      }
+      result[*count] = file.dirIndex();
+      (*count)++;
+    }
+    file.close();
+  }
+
+  Serial.printf("%u images in %s\n", *count, start);
+
+  dir.close();
+  return true;
+}
+
+bool ESP32CameraGUI::getFileNameFromDirIndex(const char* start,
+                                             uint32_t dirIndex, char* result,
+                                             size_t resultSize) {
+  FsFile dir = this->sd->open(start, O_RDONLY);
+  if (!dir) {
+    return false;
+  }
+
+  FsFile file;
+  if (!file.open(&dir, dirIndex, O_RDONLY)) {
+    dir.close();
+    return false;
+  }
+  file.getName(result, resultSize);
+
+  file.close();
+  dir.close();
+  return true;
+}
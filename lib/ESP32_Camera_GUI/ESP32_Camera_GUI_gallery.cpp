@@ -0,0 +1,142 @@
+#include <Arduino.h>
+#include "ESP32_Camera_GUI.h"
+
+// Thumbnails of the photos in /images/ in a grid, in the order they were
+// added. Up and down move the selection and turn the page past either end,
+// select puts the path of the photo in result and returns true, the shutter
+// returns false. With update the database is checked against /images/ first.
+bool ESP32CameraGUI::gallery(ThumbnailDB* db, JPEGDEC* decoder, char* result,
+                             size_t resultSize, bool update,
+                             uint16_t startingIndex, uint16_t* endingIndex) {
+  Serial.println("Opening gallery");
+  if (update && !this->updateThumbnails(db, decoder, false)) {
+    this->setBottomText("Could not update thumbnails!", 3000);
+  }
+
+  const uint16_t count = db->getCount();
+  if (count == 0) {
+    this->setBottomText("No photos!", 3000);
+    return false;
+  }
+
+  const size_t TEXT_SIZE = 27;
+  char text[TEXT_SIZE];
+  const uint16_t tilesPerPage = GALLERY_COLUMNS * GALLERY_ROWS;
+  uint16_t selected = min(startingIndex, (uint16_t)(count - 1));
+  uint16_t shownSelected = 0;
+  int32_t shownPage = -1;
+  bool picked = false;
+  bool exitGallery = false;
+
+  while (!exitGallery) {
+    const uint16_t page = selected / tilesPerPage;
+    if (page != shownPage) {
+      const uint32_t startDrawTime = millis();
+      const uint16_t first = page * tilesPerPage;
+      this->tft->fillRect(0, 0, this->tft->width(),
+                          GALLERY_ROWS * GALLERY_CELL_HEIGHT, TFT_BLACK);
+      const uint16_t tiles = min(tilesPerPage, (uint16_t)(count - first));
+      if (!db->readThumbnails(first, tiles, ESP32CameraGUI::drawGalleryTile,
+                              this)) {
+        Serial.println("Failed to read thumbnails!");
+      }
+      Serial.printf("Drew gallery page %u in %lu ms\n", page,
+                    millis() - startDrawTime);
+      shownPage = page;
+    } else {
+      this->drawGallerySelection(shownSelected % tilesPerPage, TFT_BLACK);
+    }
+    this->drawGallerySelection(selected % tilesPerPage, TFT_WHITE);
+    shownSelected = selected;
+
+    if (db->getPath(selected, result, resultSize)) {
+      snprintf(text, TEXT_SIZE, "%u/%u %s", selected + 1, count,
+               result + strlen(THUMBNAIL_IMAGES_DIRECTORY));
+      this->setBottomText(text, 2000);
+    }
+
+    while (true) {
+      if (this->shutterButton->pressed()) {
+        exitGallery = true;
+        break;
+      }
+      if (this->selectButton->pressed()) {
+        picked = db->getPath(selected, result, resultSize);
+        exitGallery = true;
+        break;
+      }
+      if (this->downButton->pressed()) {
+        selected = (selected + 1) % count;
+        break;
+      }
+      if (this->upButton->pressed()) {
+        selected = (selected + count - 1) % count;
+        break;
+      }
+      this->drawBottomToolbar();
+    }
+  }
+
+  if (endingIndex != NULL) {
+    *endingIndex = selected;
+  }
+  return picked;
+}
+
+// Checks the thumbnail database against /images/, or starts it over
+bool ESP32CameraGUI::updateThumbnails(ThumbnailDB* db, JPEGDEC* decoder,
+                                      bool rebuild) {
+  this->setBottomText(rebuild ? "Rebuilding thumbnails..."
+                              : "Checking thumbnails...",
+                      UNLIMITED_BOTTOM_TEXT_TIME);
+  this->drawBottomToolbar();
+  const bool result =
+      rebuild ? db->rebuild(decoder, ESP32CameraGUI::showThumbnailProgress,
+                            this)
+              : db->update(decoder, ESP32CameraGUI::showThumbnailProgress,
+                           this);
+  return result;
+}
+
+// Where the thumbnail of a tile on the page goes
+void ESP32CameraGUI::getGalleryTilePosition(uint16_t tile, int32_t* x,
+                                            int32_t* y) {
+  *x = (tile % GALLERY_COLUMNS) * GALLERY_CELL_WIDTH +
+       (GALLERY_CELL_WIDTH - THUMBNAIL_WIDTH) / 2;
+  *y = (tile / GALLERY_COLUMNS) * GALLERY_CELL_HEIGHT +
+       (GALLERY_CELL_HEIGHT - THUMBNAIL_HEIGHT) / 2;
+}
+
+// The frame goes in the gap between the thumbnail and the edge of its cell
+void ESP32CameraGUI::drawGallerySelection(uint16_t tile, uint16_t color) {
+  int32_t x = 0;
+  int32_t y = 0;
+  ESP32CameraGUI::getGalleryTilePosition(tile, &x, &y);
+  this->tft->drawRect(x - 1, y - 1, THUMBNAIL_WIDTH + 2, THUMBNAIL_HEIGHT + 2,
+                      color);
+}
+
+void ESP32CameraGUI::drawGalleryTile(uint16_t index, const uint16_t* pixels,
+                                     void* param) {
+  ESP32CameraGUI* self = (ESP32CameraGUI*)param;
+  int32_t x = 0;
+  int32_t y = 0;
+  ESP32CameraGUI::getGalleryTilePosition(
+      index % (GALLERY_COLUMNS * GALLERY_ROWS), &x, &y);
+  self->tft->pushImage(x, y, THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT,
+                       (uint16_t*)pixels);
+}
+
+// Redrawing the toolbar for every photo would slow down checking a database
+// that is already up to date
+void ESP32CameraGUI::showThumbnailProgress(uint16_t done, void* param) {
+  if (done % 16 != 0) {
+    return;
+  }
+  ESP32CameraGUI* self = (ESP32CameraGUI*)param;
+  const size_t TEXT_SIZE = 27;
+  char text[TEXT_SIZE];
+  snprintf(text, TEXT_SIZE, "Checked %u photos...", done);
+  self->setBottomText(text, UNLIMITED_BOTTOM_TEXT_TIME);
+  self->drawBottomToolbar();
+}
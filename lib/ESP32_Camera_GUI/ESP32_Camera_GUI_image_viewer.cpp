@@ -1,7 +1,22 @@
 #include <Arduino.h>
 #include "ESP32_Camera_GUI.h"
 
-void ESP32CameraGUI::imageViewer(const char* path, JPEGDEC* decoder) {
+// Select cycles through the zoom levels around the center of the screen, up
+// and down pan by half a screen in reading order. Zooming and panning need the
+// region decoder, without it the image is only shown once at 1/8.
+//
+// Unzoomed, up and down step to the previous and next image in the directory.
+// That needs the cache, which holds the current image and is filled with its
+// neighbours while waiting for input.
+//
+// Images that take a while are shown coarse first, the stored thumbnail
+// stretched out while the cache decodes it or the cached image scaled up
+// while zooming in. Those decodes stop as soon as a button goes down and
+// start over once the buttons are released.
+void ESP32CameraGUI::imageViewer(const char* path, JPEGDEC* decoder,
+                                 JPEGRenderer* renderer,
+                                 ParallelJPEG* parallel, ImageCache* cache,
+                                 ThumbnailDB* thumbnails) {
   Serial.println("Opening image viewer using provided decoder");
   Serial.printf("Width = %d, height = %d\n", decoder->getWidth(),
                 decoder->getHeight());
@@ -15,21 +30,310 @@ void ESP32CameraGUI::imageViewer(const char* path, JPEGDEC* decoder) {
   }
   snprintf(text, TEXT_SIZE, "Opened %s", ptr);
   this->setBottomText(text, 3000);
+
+  const size_t MAX_PATH_SIZE = 255;
+  char currentPath[MAX_PATH_SIZE];
+  char neighbourPath[MAX_PATH_SIZE];
+  char directory[MAX_PATH_SIZE];
+  strncpy(currentPath, path, MAX_PATH_SIZE - 1);
+  currentPath[MAX_PATH_SIZE - 1] = '\0';
+  strncpy(directory, currentPath, MAX_PATH_SIZE);
+  char* lastSlash = strrchr(directory, '/');
+  if (lastSlash == directory || lastSlash == NULL) {
+    strcpy(directory, "/");
+  } else {
+    *lastSlash = '\0';
+  }
+
+  uint32_t* imageIndices = NULL;
+  uint16_t imageCount = 0;
+  uint16_t imageIndex = 0;
+  if (cache != NULL) {
+    imageIndices =
+        (uint32_t*)malloc(IMAGE_VIEWER_MAX_IMAGES * sizeof(uint32_t));
+    const char* name = strrchr(currentPath, '/');
+    if (imageIndices == NULL ||
+        !this->getImageIndices(directory, name != NULL ? name + 1 : currentPath,
+                               imageIndices, IMAGE_VIEWER_MAX_IMAGES,
+                               &imageCount, &imageIndex)) {
+      imageCount = 0;
+    }
+  }
+  // Neighbours still to be cached, next first
+  const int8_t prefetchSteps[2] = {1, -1};
+  uint8_t prefetchStep = imageCount > 1 ? 0 : 2;
+
+  uint16_t imageWidth = decoder->getWidth();
+  uint16_t imageHeight = decoder->getHeight();
+  const int32_t screenWidth = this->tft->width();
+  const int32_t screenHeight = this->tft->height();
+  const int zoomOptions[IMAGE_VIEWER_ZOOM_LEVELS] = {
+      JPEG_SCALE_EIGHTH, JPEG_SCALE_QUARTER, JPEG_SCALE_HALF, 0};
+  const char* zoomNames[IMAGE_VIEWER_ZOOM_LEVELS] = {"1/8", "1/4", "1/2",
+                                                     "1:1"};
+  bool canZoom = parallel != NULL && renderer != NULL;
+  // The caller opened the decoder on the first image with its own callbacks,
+  // the cache and the region decoder reopen it with theirs and close it
+  bool callerDecoderOpen = true;
+  uint8_t zoom = 0;
+  int32_t viewX = 0;
+  int32_t viewY = 0;
+  // The coarse image of the view is on screen from a decode that was stopped
+  bool resume = false;
+
   while (!exitImageViewer) {
-    this->tft->startWrite();
-    const uint8_t result = decoder->decode(0, 0, JPEG_SCALE_EIGHTH);
-    this->tft->endWrite();
-    if (result == 1) {
-      Serial.println("Decoded successfully");
+    const uint8_t shift = IMAGE_VIEWER_ZOOM_LEVELS - 1 - zoom;
+    const int32_t maxViewX =
+        max((int32_t)0, ((int32_t)imageWidth >> shift) - screenWidth);
+    const int32_t maxViewY =
+        max((int32_t)0, ((int32_t)imageHeight >> shift) - screenHeight);
+
+    const uint32_t startDecodeTime = millis();
+    int result = 0;
+    bool coarse = resume;
+    bool stopped = false;
+    resume = false;
+    const uint16_t* pixels = NULL;
+    if (zoom == 0 && cache != NULL) {
+      pixels = cache->find(currentPath, &imageWidth, &imageHeight);
+      if (pixels == NULL) {
+        uint16_t width = 0;
+        uint16_t height = 0;
+        const uint16_t* thumbnail =
+            coarse || thumbnails == NULL
+                ? NULL
+                : thumbnails->find(currentPath, &width, &height);
+        if (thumbnail != NULL && (width >> 3) > 0 && (height >> 3) > 0) {
+          this->drawCoarseImage(thumbnail, THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT,
+                                THUMBNAIL_WIDTH, width >> 3, height >> 3, 0,
+                                0, 0);
+          coarse = true;
+        }
+        callerDecoderOpen = false;
+        cache->load(decoder, currentPath,
+                    coarse ? ESP32CameraGUI::isAnyButtonDown : NULL, this);
+        pixels = cache->find(currentPath, &imageWidth, &imageHeight);
+        stopped = pixels == NULL && cache->wasAborted();
+      }
+    } else if (zoom > 0 && cache != NULL && !coarse) {
+      // Only images that fit the cache whole can be scaled up from it
+      const uint16_t* cached =
+          cache->find(currentPath, &imageWidth, &imageHeight);
+      const uint16_t width = imageWidth >> 3;
+      const uint16_t height = imageHeight >> 3;
+      if (cached != NULL && width > 0 && height > 0 &&
+          width <= IMAGE_CACHE_WIDTH && height <= IMAGE_CACHE_HEIGHT) {
+        this->drawCoarseImage(cached, width, height, IMAGE_CACHE_WIDTH, width,
+                              height, viewX, viewY, zoom);
+        coarse = true;
+      }
+    }
+    if (pixels != NULL) {
+      this->tft->pushImage(0, 0, IMAGE_CACHE_WIDTH, IMAGE_CACHE_HEIGHT,
+                           (uint16_t*)pixels);
+      result = 1;
+    } else if (!stopped) {
+      if (renderer != NULL) {
+        renderer->setOrigin(viewX, viewY);
+        renderer->startFrame();
+      } else {
+        this->tft->startWrite();
+      }
+      result = PARALLEL_JPEG_NOT_SPLIT;
+      if (parallel != NULL) {
+        result = parallel->decodeRegion(
+            decoder, currentPath, 0, 0, viewY << shift, screenHeight << shift,
+            zoomOptions[zoom], coarse ? ESP32CameraGUI::isAnyButtonDown : NULL,
+            this);
+        stopped = result == PARALLEL_JPEG_ABORTED;
+      }
+      if (result == PARALLEL_JPEG_NOT_SPLIT && callerDecoderOpen) {
+        // Nothing has been decoded with it yet, a file the region decoder
+        // does not take is decoded whole at 1/8 from there
+        canZoom = false;
+        result = decoder->decode(0, 0, JPEG_SCALE_EIGHTH);
+      }
+      if (renderer != NULL) {
+        renderer->finishFrame();
+        renderer->setOrigin(0, 0);
+      } else {
+        this->tft->endWrite();
+      }
+    }
+    callerDecoderOpen = false;
+    if (stopped) {
+      Serial.printf("Stopped refining at %s after %lu ms\n", zoomNames[zoom],
+                    millis() - startDecodeTime);
+    } else if (result == 1) {
+      Serial.printf("Decoded successfully at %s (%ld, %ld) in %lu ms\n",
+                    zoomNames[zoom], viewX, viewY, millis() - startDecodeTime);
+    } else if (result == PARALLEL_JPEG_NOT_SPLIT && zoom > 0) {
+      // Only progressive images end up here, the cache still shows them whole
+      canZoom = false;
+      zoom = 0;
+      viewX = 0;
+      viewY = 0;
+      this->setBottomText("Can't zoom this image!", 3000);
+      continue;
     } else {
       Serial.println("Failed to decode!");
+      this->setBottomText("Could not open image!", 3000);
     }
+    // Every redraw covers the whole screen, toolbar included
+    this->drawBottomToolbar(true);
+
     while (true) {
       if (this->shutterButton->pressed()) {
         exitImageViewer = true;
         break;
       }
+      if (canZoom && this->selectButton->pressed()) {
+        // Keep the pixel at the center of the screen there
+        const uint8_t nextZoom = (zoom + 1) % IMAGE_VIEWER_ZOOM_LEVELS;
+        const uint8_t nextShift = IMAGE_VIEWER_ZOOM_LEVELS - 1 - nextZoom;
+        const int32_t centerX = (viewX + screenWidth / 2) << shift;
+        const int32_t centerY = (viewY + screenHeight / 2) << shift;
+        zoom = nextZoom;
+        const int32_t nextMaxViewX =
+            max((int32_t)0, ((int32_t)imageWidth >> nextShift) - screenWidth);
+        const int32_t nextMaxViewY =
+            max((int32_t)0, ((int32_t)imageHeight >> nextShift) - screenHeight);
+        viewX = constrain((centerX >> nextShift) - screenWidth / 2, 0,
+                          nextMaxViewX);
+        viewY = constrain((centerY >> nextShift) - screenHeight / 2, 0,
+                          nextMaxViewY);
+        this->tft->fillScreen(TFT_BLACK);
+        snprintf(text, TEXT_SIZE, "Zoom %s", zoomNames[zoom]);
+        this->setBottomText(text, 2000);
+        break;
+      }
+
+      int8_t step = 0;
+      if (this->downButton->pressed()) {
+        if (zoom == 0 && imageCount > 1) {
+          step = 1;
+        } else if (canZoom && viewX < maxViewX) {
+          viewX = min(viewX + screenWidth / 2, maxViewX);
+          break;
+        } else if (canZoom && viewY < maxViewY) {
+          viewX = 0;
+          viewY = min(viewY + screenHeight / 2, maxViewY);
+          break;
+        }
+      }
+      if (this->upButton->pressed()) {
+        if (zoom == 0 && imageCount > 1) {
+          step = -1;
+        } else if (canZoom && viewX > 0) {
+          viewX = max(viewX - screenWidth / 2, (int32_t)0);
+          break;
+        } else if (canZoom && viewY > 0) {
+          viewX = maxViewX;
+          viewY = max(viewY - screenHeight / 2, (int32_t)0);
+          break;
+        }
+      }
+      if (step != 0) {
+        const uint16_t nextIndex =
+            (imageIndex + imageCount + step) % imageCount;
+        if (this->getImagePath(directory, imageIndices[nextIndex],
+                               neighbourPath, MAX_PATH_SIZE)) {
+          imageIndex = nextIndex;
+          strcpy(currentPath, neighbourPath);
+          canZoom = parallel != NULL && renderer != NULL;
+          prefetchStep = 0;
+          const char* name = strrchr(currentPath, '/');
+          snprintf(text, TEXT_SIZE, "%u/%u %s", imageIndex + 1, imageCount,
+                   name != NULL ? name + 1 : currentPath);
+          this->setBottomText(text, 2000);
+          break;
+        } else {
+          this->setBottomText("Could not open image!", 3000);
+        }
+      }
+
+      if (stopped && !ESP32CameraGUI::isAnyButtonDown(this)) {
+        resume = true;
+        break;
+      }
+
+      // Cache the neighbours while idle, the decode stops as soon as a button
+      // goes down and is tried again later
+      if (prefetchStep < 2) {
+        const uint16_t neighbourIndex =
+            (imageIndex + imageCount + prefetchSteps[prefetchStep]) %
+            imageCount;
+        if (!this->getImagePath(directory, imageIndices[neighbourIndex],
+                                neighbourPath, MAX_PATH_SIZE) ||
+            cache->load(decoder, neighbourPath, ESP32CameraGUI::isAnyButtonDown,
+                        this) != NULL ||
+            !ESP32CameraGUI::isAnyButtonDown(this)) {
+          prefetchStep++;
+        }
+      }
+
       this->drawBottomToolbar();
     }
   }
+
+  if (imageIndices != NULL) {
+    free(imageIndices);
+  }
+}
+
+// Fills the screen from pixels (width x height, stride apart) stretched over
+// an image of imageWidth x imageHeight at 1/8 scale, the way the viewer shows
+// that image at zoom from viewX, viewY. Nearest neighbour, in strips of a few
+// rows.
+void ESP32CameraGUI::drawCoarseImage(const uint16_t* pixels, uint16_t width,
+                                     uint16_t height, uint16_t stride,
+                                     uint16_t imageWidth, uint16_t imageHeight,
+                                     int32_t viewX, int32_t viewY,
+                                     uint8_t zoom) {
+  const uint8_t STRIP_ROWS = 4;
+  const int32_t screenWidth =
+      min((int32_t)this->tft->width(), (int32_t)IMAGE_CACHE_WIDTH);
+  const int32_t screenHeight = this->tft->height();
+  uint16_t strip[IMAGE_CACHE_WIDTH * STRIP_ROWS];
+
+  this->tft->startWrite();
+  for (int32_t y = 0; y < screenHeight; y += STRIP_ROWS) {
+    const int32_t rows = min((int32_t)STRIP_ROWS, screenHeight - y);
+    for (int32_t i = 0; i < rows; i++) {
+      const int32_t imageY = (viewY + y + i) >> zoom;
+      uint16_t* dest = strip + i * screenWidth;
+      if (imageY >= imageHeight) {
+        memset(dest, 0, screenWidth * sizeof(uint16_t));
+        continue;
+      }
+      const uint16_t* source = pixels + imageY * height / imageHeight * stride;
+      for (int32_t x = 0; x < screenWidth; x++) {
+        const int32_t imageX = (viewX + x) >> zoom;
+        dest[x] = imageX < imageWidth ? source[imageX * width / imageWidth]
+                                      : TFT_BLACK;
+      }
+    }
+    this->tft->pushImage(0, y, screenWidth, rows, strip);
+  }
+  this->tft->endWrite();
+}
+
+// The full path of a file in directory given its directory entry index
+bool ESP32CameraGUI::getImagePath(const char* directory, uint32_t dirIndex,
+                                  char* result, size_t resultSize) {
+  const size_t MAX_PATH_SIZE = 255;
+  char name[MAX_PATH_SIZE];
+  if (!this->getFileNameFromDirIndex(directory, dirIndex, name,
+                                     MAX_PATH_SIZE)) {
+    return false;
+  }
+  const bool isRoot = strcmp(directory, "/") == 0;
+  return snprintf(result, resultSize, "%s/%s", isRoot ? "" : directory,
+                  name) < (int)resultSize;
+}
+
+bool ESP32CameraGUI::isAnyButtonDown(void* param) {
+  ESP32CameraGUI* self = (ESP32CameraGUI*)param;
+  return !self->upButton->read() || !self->downButton->read() ||
+         !self->selectButton->read() || !self->shutterButton->read();
 }
@@ -0,0 +1,124 @@
+#include <Arduino.h>
+#include "ESP32_Camera_GUI.h"
+
+// Shows every image in directory for interval ms, in directory order and
+// looping. The next image is decoded into the cache while the current one is
+// up, so changing images is a single push. An image whose decode runs past
+// the time it was due is shown as soon as it is done, the bottom toolbar says
+// how far behind it was and the next one is timed from then.
+//
+// Select pauses, up and down step back and forward right away and the
+// shutter leaves. Any of them stops a decode in progress.
+void ESP32CameraGUI::slideshow(const char* directory, JPEGDEC* decoder,
+                               ImageCache* cache, uint32_t interval) {
+  Serial.printf("Starting slideshow of %s every %lu ms\n", directory,
+                interval);
+  uint32_t* imageIndices =
+      (uint32_t*)malloc(IMAGE_VIEWER_MAX_IMAGES * sizeof(uint32_t));
+  uint16_t imageCount = 0;
+  uint16_t firstIndex = 0;
+  if (imageIndices == NULL ||
+      !this->getImageIndices(directory, "", imageIndices,
+                             IMAGE_VIEWER_MAX_IMAGES, &imageCount,
+                             &firstIndex) ||
+      imageCount == 0) {
+    this->setBottomText("No images!", 3000);
+    if (imageIndices != NULL) {
+      free(imageIndices);
+    }
+    return;
+  }
+
+  const size_t MAX_PATH_SIZE = 255;
+  char path[MAX_PATH_SIZE];
+  const size_t TEXT_SIZE = 27;
+  char text[TEXT_SIZE];
+
+  uint16_t shownIndex = 0;
+  uint16_t nextIndex = 0;
+  // The image at nextIndex, once it is decoded
+  const uint16_t* nextPixels = NULL;
+  uint32_t nextLoadTime = 0;
+  uint32_t dueTime = millis();
+  bool showNow = true;
+  bool paused = false;
+  uint16_t shownCount = 0;
+  uint16_t lateCount = 0;
+
+  while (true) {
+    if (this->shutterButton->pressed()) {
+      break;
+    }
+    if (this->selectButton->pressed()) {
+      paused = !paused;
+      dueTime = millis() + interval;
+      this->setBottomText(paused ? "Paused" : "Playing", 2000);
+    }
+    if (this->downButton->pressed()) {
+      showNow = true;
+    }
+    if (this->upButton->pressed()) {
+      nextIndex = (shownIndex + imageCount - 1) % imageCount;
+      nextPixels = NULL;
+      showNow = true;
+    }
+
+    if (nextPixels == NULL) {
+      const uint32_t startLoadTime = millis();
+      if (!this->getImagePath(directory, imageIndices[nextIndex], path,
+                              MAX_PATH_SIZE)) {
+        nextIndex = (nextIndex + 1) % imageCount;
+        continue;
+      }
+      nextPixels = cache->load(decoder, path, ESP32CameraGUI::isAnyButtonDown,
+                               this);
+      nextLoadTime = millis() - startLoadTime;
+      if (nextPixels == NULL) {
+        // Every image goes through the cache, so there is nothing to show
+        if (cache->wasOutOfMemory()) {
+          this->setBottomText("Not enough memory!", 3000);
+          break;
+        }
+        // Stopped by a button, which is handled before trying again
+        if (!cache->wasAborted()) {
+          Serial.printf("Could not decode %s, skipping\n", path);
+          nextIndex = (nextIndex + 1) % imageCount;
+        }
+        continue;
+      }
+    }
+
+    const int32_t late = millis() - dueTime;
+    if (!showNow && (paused || late < 0)) {
+      this->drawBottomToolbar();
+      continue;
+    }
+
+    this->tft->pushImage(0, 0, IMAGE_CACHE_WIDTH, IMAGE_CACHE_HEIGHT,
+                         (uint16_t*)nextPixels);
+    shownCount++;
+    const char* name = strrchr(path, '/');
+    if (!showNow && late > SLIDESHOW_LATE_TOLERANCE) {
+      lateCount++;
+      Serial.printf("Slideshow %ld ms behind, %s took %lu ms to decode\n",
+                    (long)late, path, nextLoadTime);
+      snprintf(text, TEXT_SIZE, "Behind by %ld ms!", (long)late);
+      this->setBottomText(text, 2000);
+      dueTime = millis() + interval;
+    } else {
+      snprintf(text, TEXT_SIZE, "%u/%u %s", nextIndex + 1, imageCount,
+               name != NULL ? name + 1 : path);
+      this->setBottomText(text, 2000);
+      dueTime = showNow ? millis() + interval : dueTime + interval;
+    }
+    showNow = false;
+    shownIndex = nextIndex;
+    nextIndex = (nextIndex + 1) % imageCount;
+    nextPixels = NULL;
+    this->drawBottomToolbar();
+  }
+
+  Serial.printf("Slideshow showed %u images, %u of them late\n", shownCount,
+                lateCount);
+  free(imageIndices);
+}
@@ -0,0 +1,479 @@
+#include <Arduino.h>
+#include "Exif.h"
+
+Exif* Exif::instance = NULL;
+
+bool Exif::begin(SdFs* sd) {
+  if (this->began) {
+    return true;
+  }
+
+  this->sd = sd;
+  Exif::instance = this;
+
+  this->began = true;
+  return true;
+}
+
+// Starts a capture with SOI and an EXIF segment, the JPEG data from the
+// camera follows without its own SOI. IFD0 and the EXIF IFD hold the time and
+// settings, and the space for the thumbnail after them is left zeroed. It is
+// all written in order so the capture is still streamed in one pass.
+bool Exif::writeHeader(FsFile* file, const ExifCaptureInfo* info,
+                       uint32_t* bytesWritten) {
+  // Offsets from the start of the TIFF header, values are kept word aligned
+  const uint16_t ifd0Entries = 5;
+  const uint16_t exifEntries = 7;
+  const uint16_t ifd0 = 8;
+  const uint16_t makeOffset = ifd0 + 2 + 12 * ifd0Entries + 4;
+  const uint16_t modelOffset = makeOffset + (sizeof(EXIF_MAKE) + 1) / 2 * 2;
+  const uint16_t dateTimeOffset =
+      modelOffset + (sizeof(EXIF_MODEL) + 1) / 2 * 2;
+  const uint16_t exifIFD = dateTimeOffset + EXIF_DATE_TIME_BYTES;
+  const uint16_t originalOffset = exifIFD + 2 + 12 * exifEntries + 4;
+  const uint16_t makerNoteOffset = originalOffset + EXIF_DATE_TIME_BYTES;
+  const uint16_t tiffSize =
+      makerNoteOffset + (EXIF_MAKER_NOTE_BYTES + 1) / 2 * 2;
+  const uint16_t segmentLength =
+      2 + 6 + tiffSize + EXIF_THUMBNAIL_RESERVED_BYTES;
+  uint8_t header[EXIF_TIFF_START + tiffSize];
+  memset(header, 0, sizeof(header));
+  const uint8_t start[4] = {0xFF, 0xD8, 0xFF, 0xE1};
+  memcpy(header, start, sizeof(start));
+  Exif::putValue(header + 4, segmentLength, 2);
+  memcpy(header + 6, "Exif\0\0", 6);
+
+  uint8_t* tiff = header + EXIF_TIFF_START;
+  memcpy(tiff, "MM", 2);
+  Exif::putValue(tiff + 2, 42, 2);
+  Exif::putValue(tiff + 4, ifd0, 4);
+
+  uint8_t* entry = tiff + ifd0;
+  Exif::putValue(entry, ifd0Entries, 2);
+  entry += 2;
+  entry = Exif::putEntry(entry, 0x010F, 2, sizeof(EXIF_MAKE), makeOffset);
+  entry = Exif::putEntry(entry, 0x0110, 2, sizeof(EXIF_MODEL), modelOffset);
+  // Orientation, 1 is upright
+  entry = Exif::putEntry(entry, 0x0112, 3, 1, 1);
+  entry = Exif::putEntry(entry, 0x0132, 2, EXIF_DATE_TIME_BYTES,
+                         dateTimeOffset);
+  entry = Exif::putEntry(entry, 0x8769, 4, 1, exifIFD);
+  // The offset of IFD1 stays 0 until there is a thumbnail
+  memcpy(tiff + makeOffset, EXIF_MAKE, sizeof(EXIF_MAKE));
+  memcpy(tiff + modelOffset, EXIF_MODEL, sizeof(EXIF_MODEL));
+  memcpy(tiff + dateTimeOffset, info->dateTime, EXIF_DATE_TIME_BYTES - 1);
+
+  entry = tiff + exifIFD;
+  Exif::putValue(entry, exifEntries, 2);
+  entry += 2;
+  // ExifVersion, "0232"
+  entry = Exif::putEntry(entry, 0x9000, 7, 4, 0x30323332);
+  entry = Exif::putEntry(entry, 0x9003, 2, EXIF_DATE_TIME_BYTES,
+                         originalOffset);
+  entry = Exif::putEntry(entry, 0x9208, 3, 1, info->lightSource);
+  entry = Exif::putEntry(entry, 0x927C, 7, EXIF_MAKER_NOTE_BYTES,
+                         makerNoteOffset);
+  entry = Exif::putEntry(entry, 0xA403, 3, 1, info->whiteBalance);
+  entry = Exif::putEntry(entry, 0xA408, 3, 1, info->contrast);
+  entry = Exif::putEntry(entry, 0xA409, 3, 1, info->saturation);
+  memcpy(tiff + originalOffset, info->dateTime, EXIF_DATE_TIME_BYTES - 1);
+  memcpy(tiff + makerNoteOffset, info->makerNote, EXIF_MAKER_NOTE_BYTES);
+
+  if (file->write(header, sizeof(header)) != sizeof(header)) {
+    return false;
+  }
+  uint8_t zeros[256];
+  memset(zeros, 0, sizeof(zeros));
+  uint16_t remaining = EXIF_THUMBNAIL_RESERVED_BYTES;
+  while (remaining > 0) {
+    const uint16_t chunk = min(remaining, (uint16_t)sizeof(zeros));
+    if (file->write(zeros, chunk) != chunk) {
+      return false;
+    }
+    remaining -= chunk;
+  }
+
+  *bytesWritten = sizeof(header) + EXIF_THUMBNAIL_RESERVED_BYTES;
+  return true;
+}
+
+// Makes the thumbnail of a capture started with writeHeader() and writes it
+// into the space left for it, at a lower quality if it does not fit
+bool Exif::embedThumbnail(JPEGDEC* decoder, const char* path) {
+  if (!this->began) {
+    return false;
+  }
+
+  const uint32_t startTime = millis();
+  const size_t capacity =
+      EXIF_THUMBNAIL_RESERVED_BYTES - EXIF_THUMBNAIL_IFD_BYTES;
+  this->encoded = (uint8_t*)malloc(capacity);
+  if (this->encoded == NULL) {
+    Serial.println("Not enough memory to make thumbnail");
+    return false;
+  }
+  bool ok = this->encodeThumbnail(decoder, path, EXIF_THUMBNAIL_QUALITY);
+  if (!ok && this->encodedSize == capacity) {
+    ok = this->encodeThumbnail(decoder, path, EXIF_THUMBNAIL_FALLBACK_QUALITY);
+  }
+  const uint32_t encodeTime = millis() - startTime;
+
+  FsFile file;
+  uint8_t buf[16];
+  uint32_t nextPosition = 0;
+  uint32_t reservedStart = 0;
+  if (ok) {
+    // The layout is checked again rather than trusted
+    file = this->sd->open(path, O_RDWR);
+    ok = file && file.read(buf, 16) == 16 && buf[0] == 0xFF &&
+         buf[1] == 0xD8 && buf[2] == 0xFF && buf[3] == 0xE1 &&
+         memcmp(buf + 6, "Exif\0\0MM", 8) == 0;
+  }
+  if (ok) {
+    const uint32_t segmentEnd = 4 + Exif::getValue(buf + 4, 2, true);
+    reservedStart = segmentEnd - EXIF_THUMBNAIL_RESERVED_BYTES;
+    const uint32_t ifd0 = EXIF_TIFF_START + 8;
+    ok = file.seek(ifd0) && file.read(buf, 2) == 2;
+    nextPosition = ifd0 + 2 + 12 * Exif::getValue(buf, 2, true);
+    ok = ok && nextPosition + 4 <= reservedStart &&
+         (reservedStart - EXIF_TIFF_START) % 2 == 0 &&
+         file.seek(nextPosition) && file.read(buf, 4) == 4 &&
+         Exif::getValue(buf, 4, true) == 0 && file.seek(reservedStart) &&
+         file.read(buf, 2) == 2 && Exif::getValue(buf, 2, true) == 0;
+    if (!ok) {
+      Serial.printf("%s has no room for a thumbnail\n", path);
+    }
+  }
+  if (ok) {
+    const uint32_t ifd1 = reservedStart - EXIF_TIFF_START;
+    uint8_t ifd[EXIF_THUMBNAIL_IFD_BYTES];
+    memset(ifd, 0, sizeof(ifd));
+    Exif::putValue(ifd, 3, 2);
+    // Compression, 6 is JPEG
+    Exif::putValue(ifd + 2, 0x0103, 2);
+    Exif::putValue(ifd + 4, 3, 2);
+    Exif::putValue(ifd + 6, 1, 4);
+    Exif::putValue(ifd + 10, 6, 2);
+    // JPEGInterchangeFormat and JPEGInterchangeFormatLength
+    Exif::putValue(ifd + 14, 0x0201, 2);
+    Exif::putValue(ifd + 16, 4, 2);
+    Exif::putValue(ifd + 18, 1, 4);
+    Exif::putValue(ifd + 22, ifd1 + EXIF_THUMBNAIL_IFD_BYTES, 4);
+    Exif::putValue(ifd + 26, 0x0202, 2);
+    Exif::putValue(ifd + 28, 4, 2);
+    Exif::putValue(ifd + 30, 1, 4);
+    Exif::putValue(ifd + 34, this->encodedSize, 4);
+
+    // IFD0 only points at the thumbnail once it is all there
+    Exif::putValue(buf, ifd1, 4);
+    ok = file.seek(reservedStart) &&
+         file.write(ifd, sizeof(ifd)) == sizeof(ifd) &&
+         file.write(this->encoded, this->encodedSize) == this->encodedSize &&
+         file.seek(nextPosition) && file.write(buf, 4) == 4;
+    if (!ok) {
+      Serial.printf("Could not write thumbnail to %s\n", path);
+    }
+  }
+  if (file) {
+    file.close();
+  }
+
+  if (ok) {
+    Serial.printf("Embedded %u byte thumbnail in %s (encoded in %lu ms, "
+                  "%lu ms total)\n",
+                  (unsigned)this->encodedSize, path, encodeTime,
+                  millis() - startTime);
+  }
+  free(this->encoded);
+  this->encoded = NULL;
+  return ok;
+}
+
+// Finds the JPEG thumbnail in IFD1 of the EXIF segment, and the size of the
+// photo from its frame header. Returns false if either is missing.
+bool Exif::readThumbnailInfo(FsFile* file, ExifThumbnailInfo* info) {
+  memset(info, 0, sizeof(ExifThumbnailInfo));
+  uint8_t buf[16];
+  if (!file->seek(0) || file->read(buf, 2) != 2 || buf[0] != 0xFF ||
+      buf[1] != 0xD8) {
+    return false;
+  }
+
+  uint32_t position = 2;
+  while (true) {
+    if (!file->seek(position) || file->read(buf, 4) != 4 || buf[0] != 0xFF) {
+      return false;
+    }
+    const uint8_t marker = buf[1];
+    if (marker == 0xFF) {
+      position++;
+      continue;
+    }
+    const uint16_t length = Exif::getValue(buf + 2, 2, true);
+
+    if (marker == 0xE1 && info->length == 0 && file->read(buf, 14) == 14 &&
+        memcmp(buf, "Exif\0\0", 6) == 0) {
+      const uint32_t tiff = position + 10;
+      const uint32_t segmentEnd = position + 2 + length;
+      const bool bigEndian = buf[6] == 'M';
+      const uint32_t ifd0 = Exif::getValue(buf + 10, 4, bigEndian);
+      uint32_t ifd1 = 0;
+      if (file->seek(tiff + ifd0) && file->read(buf, 2) == 2) {
+        const uint16_t ifd0Entries = Exif::getValue(buf, 2, bigEndian);
+        if (file->seek(tiff + ifd0 + 2 + 12 * ifd0Entries) &&
+            file->read(buf, 4) == 4) {
+          ifd1 = Exif::getValue(buf, 4, bigEndian);
+        }
+      }
+      uint16_t entries = 0;
+      if (ifd1 > 0 && file->seek(tiff + ifd1) && file->read(buf, 2) == 2) {
+        entries = Exif::getValue(buf, 2, bigEndian);
+      }
+      uint32_t offset = 0;
+      uint32_t thumbnailLength = 0;
+      for (uint16_t i = 0; i < entries && file->read(buf, 12) == 12; i++) {
+        const uint16_t tag = Exif::getValue(buf, 2, bigEndian);
+        const uint16_t type = Exif::getValue(buf + 2, 2, bigEndian);
+        const uint32_t value =
+            Exif::getValue(buf + 8, type == 3 ? 2 : 4, bigEndian);
+        if (tag == 0x0201) {
+          offset = value;
+        } else if (tag == 0x0202) {
+          thumbnailLength = value;
+        }
+      }
+      if (offset > 0 && thumbnailLength > 0 &&
+          tiff + offset + thumbnailLength <= segmentEnd) {
+        info->offset = tiff + offset;
+        info->length = thumbnailLength;
+      }
+    } else if (marker >= 0xC0 && marker <= 0xC2) {
+      if (file->read(buf, 5) != 5) {
+        return false;
+      }
+      info->imageHeight = Exif::getValue(buf + 1, 2, true);
+      info->imageWidth = Exif::getValue(buf + 3, 2, true);
+      return info->length > 0 && info->imageWidth > 0 &&
+             info->imageHeight > 0;
+    } else if (marker == 0xDA || marker == 0xD9) {
+      return false;
+    }
+    position += 2 + length;
+  }
+}
+
+// Decodes the photo at the smallest scale that still covers the thumbnail
+// and encodes the thumbnail into encoded as the rows come in
+bool Exif::encodeThumbnail(JPEGDEC* decoder, const char* path,
+                           uint8_t quality) {
+  this->encodedSize = 0;
+  this->failed = false;
+  if (!decoder->open(path, Exif::openFile, Exif::closeFile, Exif::readFile,
+                     Exif::seekFile, Exif::drawFile)) {
+    return false;
+  }
+
+  const int scaleOptions[4] = {JPEG_SCALE_EIGHTH, JPEG_SCALE_QUARTER,
+                               JPEG_SCALE_HALF, 0};
+  uint8_t scale = 0;
+  uint8_t shift = 3;
+  while (shift > 0 && ((decoder->getWidth() >> shift) < EXIF_THUMBNAIL_WIDTH ||
+                       (decoder->getHeight() >> shift) <
+                           EXIF_THUMBNAIL_HEIGHT)) {
+    scale++;
+    shift--;
+  }
+  this->scaledWidth = decoder->getWidth() >> shift;
+  this->scaledHeight = decoder->getHeight() >> shift;
+  this->stripHeight = 0;
+
+  this->sums = (uint16_t*)calloc(EXIF_THUMBNAIL_WIDTH * 3, sizeof(uint16_t));
+  this->counts = (uint8_t*)calloc(EXIF_THUMBNAIL_WIDTH, sizeof(uint8_t));
+  int result = 0;
+  if (this->sums != NULL && this->counts != NULL &&
+      this->scaledWidth > 0 && this->scaledHeight > 0 &&
+      this->encoder.begin(EXIF_THUMBNAIL_WIDTH, EXIF_THUMBNAIL_HEIGHT,
+                          quality, Exif::writeEncoded, this)) {
+    decoder->setPixelType(RGB565_LITTLE_ENDIAN);
+    result = decoder->decode(0, 0, scaleOptions[scale]);
+  }
+  decoder->close();
+  const bool ok = this->encoder.finish() && result == 1 && !this->failed;
+
+  if (this->strip != NULL) {
+    free(this->strip);
+    this->strip = NULL;
+  }
+  if (this->sums != NULL) {
+    free(this->sums);
+    this->sums = NULL;
+  }
+  if (this->counts != NULL) {
+    free(this->counts);
+    this->counts = NULL;
+  }
+  return ok;
+}
+
+// Adds a full row of the decoded photo to the thumbnail row it falls in.
+// Rows and columns are averaged when shrinking and repeated when the photo
+// is smaller than the thumbnail.
+bool Exif::addSourceRow(const uint16_t* row, uint16_t y) {
+  const uint32_t width = this->scaledWidth;
+  const uint32_t height = this->scaledHeight;
+  for (uint32_t x = 0; x < width; x++) {
+    uint32_t first = x * EXIF_THUMBNAIL_WIDTH / width;
+    uint32_t last = first + 1;
+    if (width < EXIF_THUMBNAIL_WIDTH) {
+      first = (x * EXIF_THUMBNAIL_WIDTH + width - 1) / width;
+      last = ((x + 1) * EXIF_THUMBNAIL_WIDTH + width - 1) / width;
+    }
+    const uint16_t pixel = row[x];
+    for (uint32_t i = first; i < last; i++) {
+      this->sums[i * 3] += pixel >> 11;
+      this->sums[i * 3 + 1] += (pixel >> 5) & 0x3F;
+      this->sums[i * 3 + 2] += pixel & 0x1F;
+      this->counts[i]++;
+    }
+  }
+
+  uint32_t repeats = 0;
+  if (height < EXIF_THUMBNAIL_HEIGHT) {
+    repeats = ((y + 1) * EXIF_THUMBNAIL_HEIGHT + height - 1) / height -
+              (y * EXIF_THUMBNAIL_HEIGHT + height - 1) / height;
+  } else if ((uint32_t)(y + 1) == height ||
+             (y + 1) * EXIF_THUMBNAIL_HEIGHT / height !=
+                 y * EXIF_THUMBNAIL_HEIGHT / height) {
+    repeats = 1;
+  }
+  if (repeats == 0) {
+    return true;
+  }
+
+  for (uint16_t i = 0; i < EXIF_THUMBNAIL_WIDTH; i++) {
+    const uint16_t count = max(this->counts[i], (uint8_t)1);
+    this->row[i] = ((this->sums[i * 3] + count / 2) / count) << 11 |
+                   ((this->sums[i * 3 + 1] + count / 2) / count) << 5 |
+                   ((this->sums[i * 3 + 2] + count / 2) / count);
+  }
+  memset(this->sums, 0, EXIF_THUMBNAIL_WIDTH * 3 * sizeof(uint16_t));
+  memset(this->counts, 0, EXIF_THUMBNAIL_WIDTH * sizeof(uint8_t));
+  for (uint32_t i = 0; i < repeats; i++) {
+    if (!this->encoder.addRow(this->row)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reads a value of bytes length with the byte order of the TIFF header
+uint32_t Exif::getValue(const uint8_t* src, uint8_t bytes, bool bigEndian) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < bytes; i++) {
+    value |= (uint32_t)src[bigEndian ? i : bytes - 1 - i]
+             << (8 * (bytes - 1 - i));
+  }
+  return value;
+}
+
+// Everything this writes is big endian
+void Exif::putValue(uint8_t* dest, uint32_t value, uint8_t bytes) {
+  for (uint8_t i = 0; i < bytes; i++) {
+    dest[i] = value >> (8 * (bytes - 1 - i));
+  }
+}
+
+// Fills in a 12 byte IFD entry and returns where the next one goes. A single
+// SHORT is left aligned in the value field, anything else is written as a
+// LONG, which is either an offset or up to 4 bytes of the value itself.
+uint8_t* Exif::putEntry(uint8_t* dest, uint16_t tag, uint16_t type,
+                        uint32_t count, uint32_t value) {
+  Exif::putValue(dest, tag, 2);
+  Exif::putValue(dest + 2, type, 2);
+  Exif::putValue(dest + 4, count, 4);
+  if (type == 3 && count == 1) {
+    Exif::putValue(dest + 8, value, 2);
+    Exif::putValue(dest + 10, 0, 2);
+  } else {
+    Exif::putValue(dest + 8, value, 4);
+  }
+  return dest + 12;
+}
+
+// Fails once the thumbnail outgrows the space left for it
+bool Exif::writeEncoded(const uint8_t* data, size_t length, void* param) {
+  Exif* self = (Exif*)param;
+  const size_t capacity =
+      EXIF_THUMBNAIL_RESERVED_BYTES - EXIF_THUMBNAIL_IFD_BYTES;
+  if (self->encodedSize + length > capacity) {
+    self->encodedSize = capacity;
+    return false;
+  }
+  memcpy(self->encoded + self->encodedSize, data, length);
+  self->encodedSize += length;
+  return true;
+}
+
+void* Exif::openFile(const char* filename, int32_t* size) {
+  Exif* self = Exif::instance;
+  self->imageFile = self->sd->open(filename, O_RDONLY);
+  if (!self->imageFile) {
+    return NULL;
+  }
+  *size = self->imageFile.size();
+  return &self->imageFile;
+}
+
+void Exif::closeFile(void* handle) {
+  Exif* self = Exif::instance;
+  if (self->imageFile) {
+    self->imageFile.close();
+  }
+}
+
+int32_t Exif::readFile(JPEGFILE* handle, uint8_t* buffer, int32_t length) {
+  return Exif::instance->imageFile.read(buffer, length);
+}
+
+int32_t Exif::seekFile(JPEGFILE* handle, int32_t position) {
+  return Exif::instance->imageFile.seek(position);
+}
+
+// Collects blocks into the strip until it spans the width of the photo, then
+// hands its rows on. Stops the decode if the encoder gave up.
+int Exif::drawFile(JPEGDRAW* pDraw) {
+  Exif* self = Exif::instance;
+  if (self->failed) {
+    return 0;
+  }
+  if (self->strip == NULL) {
+    self->stripHeight = pDraw->iHeight;
+    self->strip = (uint16_t*)malloc(self->scaledWidth * self->stripHeight *
+                                    sizeof(uint16_t));
+  }
+  if (self->strip == NULL || pDraw->iHeight > self->stripHeight) {
+    self->failed = true;
+    return 0;
+  }
+
+  const int32_t width =
+      min((int32_t)pDraw->iWidth, (int32_t)self->scaledWidth - pDraw->x);
+  for (int32_t y = 0; y < pDraw->iHeight && width > 0; y++) {
+    memcpy(self->strip + y * self->scaledWidth + pDraw->x,
+           pDraw->pPixels + y * pDraw->iWidth, width * sizeof(uint16_t));
+  }
+  if (pDraw->x + pDraw->iWidth < self->scaledWidth) {
+    return 1;
+  }
+
+  const int32_t height =
+      min((int32_t)pDraw->iHeight, (int32_t)self->scaledHeight - pDraw->y);
+  for (int32_t y = 0; y < height; y++) {
+    if (!self->addSourceRow(self->strip + y * self->scaledWidth,
+                            pDraw->y + y)) {
+      self->failed = true;
+      return 0;
+    }
+  }
+  return 1;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <Arduino.h>
+#include <JPEGDEC.h>
+#include <JPEGEncoder.h>
+#include <SdFat.h>
+
+const uint16_t EXIF_THUMBNAIL_WIDTH = 160;
+const uint16_t EXIF_THUMBNAIL_HEIGHT = 120;
+// Noisy photos that do not fit at the first quality are tried again at the
+// second
+const uint8_t EXIF_THUMBNAIL_QUALITY = 70;
+const uint8_t EXIF_THUMBNAIL_FALLBACK_QUALITY = 40;
+// Room left at the end of the EXIF segment of every capture for the IFD that
+// points to the thumbnail and the thumbnail itself
+const uint16_t EXIF_THUMBNAIL_RESERVED_BYTES = 12288;
+const uint16_t EXIF_THUMBNAIL_IFD_BYTES = 2 + 3 * 12 + 4;
+// Offsets in the EXIF segment are from the start of the TIFF header, which
+// comes after the SOI, the APP1 marker and length and "Exif\0\0"
+const uint32_t EXIF_TIFF_START = 2 + 4 + 6;
+
+// Written into IFD0 of every capture
+const char EXIF_MAKE[] = "ArduCAM";
+const char EXIF_MODEL[] = "OV2640";
+// "YYYY:MM:DD hh:mm:ss" and its terminator
+const uint8_t EXIF_DATE_TIME_BYTES = 20;
+const uint8_t EXIF_MAKER_NOTE_BYTES = 5;
+
+// When a photo was taken and what with. Settings that EXIF has tags for are
+// in the values those tags use, and the maker note keeps the camera's own
+// values for all of them.
+struct ExifCaptureInfo {
+    char dateTime[EXIF_DATE_TIME_BYTES];
+    uint16_t lightSource;
+    uint16_t whiteBalance;
+    uint16_t contrast;
+    uint16_t saturation;
+    uint8_t makerNote[EXIF_MAKER_NOTE_BYTES];
+};
+
+// Where a thumbnail is in the file, and the size of the photo it belongs to
+struct ExifThumbnailInfo {
+    uint32_t offset;
+    uint32_t length;
+    uint16_t imageWidth;
+    uint16_t imageHeight;
+};
+
+// Gives captures their metadata and an embedded thumbnail without rewriting
+// them. writeHeader() starts the photo with an EXIF segment that has the time
+// and settings in it and empty space at the end, and
+// once the photo is on the card embedThumbnail() decodes it small, encodes
+// the thumbnail and writes it into that space, so only the thumbnail and one
+// offset are written a second time.
+//
+// readThumbnailInfo() finds the thumbnail in any EXIF file so it can be
+// decoded instead of the whole photo.
+class Exif {
+  public:
+    bool begin(SdFs* sd);
+
+    static bool writeHeader(FsFile* file, const ExifCaptureInfo* info,
+                            uint32_t* bytesWritten);
+    bool embedThumbnail(JPEGDEC* decoder, const char* path);
+
+    static bool readThumbnailInfo(FsFile* file, ExifThumbnailInfo* info);
+
+  protected:
+    bool encodeThumbnail(JPEGDEC* decoder, const char* path, uint8_t quality);
+    bool addSourceRow(const uint16_t* row, uint16_t y);
+
+    static uint32_t getValue(const uint8_t* src, uint8_t bytes,
+                             bool bigEndian);
+    static void putValue(uint8_t* dest, uint32_t value, uint8_t bytes);
+    static uint8_t* putEntry(uint8_t* dest, uint16_t tag, uint16_t type,
+                             uint32_t count, uint32_t value);
+    static bool writeEncoded(const uint8_t* data, size_t length, void* param);
+
+    static void* openFile(const char* filename, int32_t* size);
+    static void closeFile(void* handle);
+    static int32_t readFile(JPEGFILE* handle, uint8_t* buffer, int32_t length);
+    static int32_t seekFile(JPEGFILE* handle, int32_t position);
+    static int drawFile(JPEGDRAW* pDraw);
+
+    static Exif* instance;
+
+    bool began = false;
+
+    SdFs* sd;
+    FsFile imageFile;
+    JPEGEncoder encoder;
+
+    // The decoded photo is this big, blocks are collected into a strip until
+    // it spans the width and then averaged into a row of the thumbnail
+    uint16_t scaledWidth = 0;
+    uint16_t scaledHeight = 0;
+    uint16_t* strip = NULL;
+    uint8_t stripHeight = 0;
+    uint16_t* sums = NULL;
+    uint8_t* counts = NULL;
+    uint16_t row[EXIF_THUMBNAIL_WIDTH];
+    bool failed = false;
+
+    uint8_t* encoded = NULL;
+    size_t encodedSize = 0;
+};
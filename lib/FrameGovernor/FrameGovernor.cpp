@@ -0,0 +1,121 @@
+#include <Arduino.h>
+#include "FrameGovernor.h"
+
+void FrameGovernor::begin(uint8_t modeCount, uint8_t startMode,
+                          uint16_t targetFPS) {
+  this->modeCount = max((uint8_t)1, modeCount);
+  this->targetFPS = max((uint16_t)1, targetFPS);
+  this->targetFrameTime = 1000000 / this->targetFPS;
+  this->backoffFrames = GOVERNOR_BACKOFF_FRAMES;
+  this->backoffRemaining = 0;
+  this->lastStepUpFrom = 0xFF;
+  this->setMode(min(startMode, (uint8_t)(this->modeCount - 1)));
+}
+
+// Records the stage times of a finished frame in microseconds, returns true
+// when the mode changed and has to be applied before the next frame
+bool FrameGovernor::update(uint32_t captureTime, uint32_t renderTime) {
+  this->lastCaptureTime = captureTime;
+  this->lastRenderTime = renderTime;
+  this->frameTimes[this->frameTimeIndex] = captureTime + renderTime;
+  this->frameTimeIndex = (this->frameTimeIndex + 1) % GOVERNOR_WINDOW;
+  if (this->framesInMode < 0xFFFF) {
+    this->framesInMode++;
+  }
+  if (this->backoffRemaining > 0) {
+    this->backoffRemaining--;
+  }
+
+  if (this->framesInMode < GOVERNOR_MIN_FRAMES) {
+    return false;
+  }
+
+  const uint32_t frameTime = this->getFrameTimePercentile(90);
+  if (frameTime * 100 > this->targetFrameTime * (100 + GOVERNOR_DOWN_MARGIN)) {
+    return this->drop();
+  }
+
+  if (this->lastStepUpFrom != 0xFF &&
+      this->framesInMode > GOVERNOR_MAX_BACKOFF_FRAMES) {
+    // Stable for long enough, stepping up worked out
+    this->lastStepUpFrom = 0xFF;
+    this->backoffFrames = GOVERNOR_BACKOFF_FRAMES;
+  }
+
+  if (frameTime * 100 < this->targetFrameTime * (100 - GOVERNOR_UP_MARGIN) &&
+      this->mode + 1 < this->modeCount && this->backoffRemaining == 0) {
+    this->lastStepUpFrom = this->mode;
+    this->setMode(this->mode + 1);
+    return true;
+  }
+
+  return false;
+}
+
+// Steps down a mode right away, for frames that took too long or could not be
+// captured at all. Returns true when the mode changed.
+bool FrameGovernor::drop() {
+  if (this->mode == 0) {
+    return false;
+  }
+  if (this->lastStepUpFrom == this->mode - 1 &&
+      this->framesInMode < GOVERNOR_MAX_BACKOFF_FRAMES) {
+    this->backoffRemaining = this->backoffFrames;
+    this->backoffFrames =
+        min((uint16_t)(this->backoffFrames * 2), GOVERNOR_MAX_BACKOFF_FRAMES);
+  }
+  this->lastStepUpFrom = 0xFF;
+  this->setMode(this->mode - 1);
+  return true;
+}
+
+// How long to wait after a frame that took frameTime microseconds so frames
+// start on an even beat
+uint32_t FrameGovernor::getPacingDelay(uint32_t frameTime) {
+  if (frameTime >= this->targetFrameTime) {
+    return 0;
+  }
+  return this->targetFrameTime - frameTime;
+}
+
+uint8_t FrameGovernor::getMode() { return this->mode; }
+
+uint16_t FrameGovernor::getTargetFPS() { return this->targetFPS; }
+
+uint32_t FrameGovernor::getLastCaptureTime() { return this->lastCaptureTime; }
+
+uint32_t FrameGovernor::getLastRenderTime() { return this->lastRenderTime; }
+
+// Over the frames in the current mode only, 0 when there are none yet
+uint32_t FrameGovernor::getFrameTimePercentile(uint8_t percentile) {
+  const uint8_t count = min(this->framesInMode, (uint16_t)GOVERNOR_WINDOW);
+  if (count == 0) {
+    return 0;
+  }
+
+  uint32_t sorted[GOVERNOR_WINDOW];
+  for (uint8_t i = 0; i < count; i++) {
+    sorted[i] =
+        this->frameTimes[(this->frameTimeIndex + GOVERNOR_WINDOW - 1 - i) %
+                         GOVERNOR_WINDOW];
+  }
+  // Insertion sort, the window is tiny
+  for (uint8_t i = 1; i < count; i++) {
+    const uint32_t value = sorted[i];
+    int8_t j = i - 1;
+    while (j >= 0 && sorted[j] > value) {
+      sorted[j + 1] = sorted[j];
+      j--;
+    }
+    sorted[j + 1] = value;
+  }
+
+  const uint8_t index = min((uint8_t)((count * percentile) / 100),
+                            (uint8_t)(count - 1));
+  return sorted[index];
+}
+
+void FrameGovernor::setMode(uint8_t mode) {
+  this->mode = mode;
+  this->framesInMode = 0;
+}
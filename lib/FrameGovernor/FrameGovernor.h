@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Frame times are kept for this many frames, percentiles are taken over the
+// frames since the last mode change
+const uint8_t GOVERNOR_WINDOW = 32;
+// Frames to stay in a mode before it is judged
+const uint8_t GOVERNOR_MIN_FRAMES = 16;
+// The 90th percentile has to be this far (in percent) under the target before
+// trying the next mode up, and this far over it before dropping a mode
+const uint8_t GOVERNOR_UP_MARGIN = 30;
+const uint8_t GOVERNOR_DOWN_MARGIN = 10;
+// A mode that had to be left again shortly after stepping up is not retried
+// for this many frames, doubling every time it happens again
+const uint16_t GOVERNOR_BACKOFF_FRAMES = 64;
+const uint16_t GOVERNOR_MAX_BACKOFF_FRAMES = 1024;
+
+// Picks one of a list of preview modes, ordered from cheapest to sharpest, so
+// frames fit in the target frame time. Modes only change after the current
+// one has been measured for a while and with a margin either way, so the mode
+// does not flip back and forth around the target. Frames that finish early
+// are padded out to the target time so the frame rate stays even.
+class FrameGovernor {
+  public:
+    void begin(uint8_t modeCount, uint8_t startMode, uint16_t targetFPS);
+
+    bool update(uint32_t captureTime, uint32_t renderTime);
+    bool drop();
+    uint32_t getPacingDelay(uint32_t frameTime);
+
+    uint8_t getMode();
+    uint16_t getTargetFPS();
+    uint32_t getLastCaptureTime();
+    uint32_t getLastRenderTime();
+    uint32_t getFrameTimePercentile(uint8_t percentile);
+
+  protected:
+    void setMode(uint8_t mode);
+
+    uint8_t modeCount = 1;
+    uint8_t mode = 0;
+    uint16_t targetFPS = 1;
+    uint32_t targetFrameTime = 1000000;
+
+    uint32_t frameTimes[GOVERNOR_WINDOW];
+    uint8_t frameTimeIndex = 0;
+    uint16_t framesInMode = 0;
+
+    uint32_t lastCaptureTime = 0;
+    uint32_t lastRenderTime = 0;
+
+    // The mode stepped up from, and how long until it may be tried again
+    uint8_t lastStepUpFrom = 0xFF;
+    uint16_t backoffFrames = GOVERNOR_BACKOFF_FRAMES;
+    uint16_t backoffRemaining = 0;
+};
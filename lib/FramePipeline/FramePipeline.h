@@ -0,0 +1,234 @@
+#pragma once
+
+// Header-only primitives for handing frames between tasks without locks.
+// Only depends on <atomic>, so it builds both for the ESP32 (FreeRTOS) and on
+// a Linux host with std::thread.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <utility>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#define FRAME_PIPELINE_YIELD() taskYIELD()
+#else
+#include <thread>
+#define FRAME_PIPELINE_YIELD() std::this_thread::yield()
+#endif
+
+template <size_t Count, size_t Size>
+class FramePool;
+
+// A frame borrowed from a FramePool, the slot goes back to the pool when the
+// last handle referring to it is destroyed
+template <size_t Count, size_t Size>
+class FrameHandle {
+  public:
+    FrameHandle() {}
+    FrameHandle(const FrameHandle& other) : pool(other.pool), slot(other.slot) {
+      this->retain();
+    }
+    FrameHandle(FrameHandle&& other) : pool(other.pool), slot(other.slot) {
+      other.pool = NULL;
+      other.slot = -1;
+    }
+    ~FrameHandle() {
+      this->release();
+    }
+
+    FrameHandle& operator=(const FrameHandle& other) {
+      if (this != &other) {
+        this->release();
+        this->pool = other.pool;
+        this->slot = other.slot;
+        this->retain();
+      }
+      return *this;
+    }
+    FrameHandle& operator=(FrameHandle&& other) {
+      if (this != &other) {
+        this->release();
+        this->pool = other.pool;
+        this->slot = other.slot;
+        other.pool = NULL;
+        other.slot = -1;
+      }
+      return *this;
+    }
+
+    bool valid() const {
+      return this->pool != NULL;
+    }
+    explicit operator bool() const {
+      return this->valid();
+    }
+
+    uint8_t* data() const {
+      return this->pool->slots[this->slot].data;
+    }
+    static constexpr size_t capacity() {
+      return Size;
+    }
+    size_t length() const {
+      return this->pool->slots[this->slot].length;
+    }
+    void setLength(size_t length) {
+      this->pool->slots[this->slot].length = length;
+    }
+    uint8_t refCount() const {
+      return this->pool->slots[this->slot].refs.load(std::memory_order_acquire);
+    }
+
+    void release() {
+      if (this->pool != NULL) {
+        this->pool->release(this->slot);
+        this->pool = NULL;
+        this->slot = -1;
+      }
+    }
+
+  protected:
+    friend class FramePool<Count, Size>;
+
+    FrameHandle(FramePool<Count, Size>* pool, int16_t slot)
+        : pool(pool), slot(slot) {}
+
+    void retain() {
+      if (this->pool != NULL) {
+        this->pool->retain(this->slot);
+      }
+    }
+
+    FramePool<Count, Size>* pool = NULL;
+    int16_t slot = -1;
+};
+
+// Fixed number of fixed size frame buffers, allocated once (statically if the
+// pool itself is static) so memory use never changes at runtime
+template <size_t Count, size_t Size>
+class FramePool {
+    static_assert(Count > 0 && Count < 0x7FFF, "Invalid frame count");
+    static_assert(Size > 0, "Invalid frame size");
+
+  public:
+    typedef FrameHandle<Count, Size> Handle;
+
+    // Returns an invalid handle when every frame is in use
+    Handle acquire() {
+      for (size_t i = 0; i < Count; i++) {
+        uint8_t expected = 0;
+        if (this->slots[i].refs.compare_exchange_strong(
+                expected, 1, std::memory_order_acquire,
+                std::memory_order_relaxed)) {
+          this->slots[i].length = 0;
+          return Handle(this, i);
+        }
+      }
+      return Handle();
+    }
+
+    // Spins until a frame is free, only use this when another task is
+    // guaranteed to release one
+    Handle acquireBlocking() {
+      while (true) {
+        Handle handle = this->acquire();
+        if (handle) {
+          return handle;
+        }
+        FRAME_PIPELINE_YIELD();
+      }
+    }
+
+    size_t available() const {
+      size_t result = 0;
+      for (size_t i = 0; i < Count; i++) {
+        if (this->slots[i].refs.load(std::memory_order_relaxed) == 0) {
+          result++;
+        }
+      }
+      return result;
+    }
+
+    static constexpr size_t count() {
+      return Count;
+    }
+    static constexpr size_t frameSize() {
+      return Size;
+    }
+
+  protected:
+    friend class FrameHandle<Count, Size>;
+
+    struct Slot {
+        std::atomic<uint8_t> refs{0};
+        size_t length = 0;
+        alignas(4) uint8_t data[Size];
+    };
+
+    void retain(int16_t slot) {
+      this->slots[slot].refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    void release(int16_t slot) {
+      this->slots[slot].refs.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    Slot slots[Count];
+};
+
+// Wait-free ring for exactly one producer task and one consumer task.
+// Capacity must be a power of two, one slot is never used so full and empty
+// can be told apart without a shared counter.
+template <typename T, size_t Capacity>
+class SPSCRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two");
+
+  public:
+    bool push(T&& item) {
+      const size_t head = this->head.load(std::memory_order_relaxed);
+      const size_t next = (head + 1) & (Capacity - 1);
+      if (next == this->tail.load(std::memory_order_acquire)) {
+        return false;
+      }
+      this->items[head] = std::move(item);
+      this->head.store(next, std::memory_order_release);
+      return true;
+    }
+    bool push(const T& item) {
+      T copy = item;
+      return this->push(std::move(copy));
+    }
+
+    bool pop(T& item) {
+      const size_t tail = this->tail.load(std::memory_order_relaxed);
+      if (tail == this->head.load(std::memory_order_acquire)) {
+        return false;
+      }
+      item = std::move(this->items[tail]);
+      this->items[tail] = T();
+      this->tail.store((tail + 1) & (Capacity - 1), std::memory_order_release);
+      return true;
+    }
+
+    bool empty() const {
+      return this->head.load(std::memory_order_acquire) ==
+             this->tail.load(std::memory_order_acquire);
+    }
+    size_t size() const {
+      return (this->head.load(std::memory_order_acquire) -
+              this->tail.load(std::memory_order_acquire)) &
+             (Capacity - 1);
+    }
+    static constexpr size_t capacity() {
+      return Capacity - 1;
+    }
+
+  protected:
+    // Kept on separate cache lines so the producer and consumer cores do not
+    // keep invalidating each other
+    alignas(32) std::atomic<size_t> head{0};
+    alignas(32) std::atomic<size_t> tail{0};
+    T items[Capacity];
+};
@@ -0,0 +1,292 @@
+#include <Arduino.h>
+#include "ImageCache.h"
+
+ImageCache* ImageCache::instance = NULL;
+
+bool ImageCache::begin(SdFs* sd) {
+  if (this->began) {
+    return true;
+  }
+
+  this->sd = sd;
+  ImageCache::instance = this;
+
+  this->began = true;
+  return true;
+}
+
+// Returns the cached pixels of the image, or NULL if it is not cached
+const uint16_t* ImageCache::find(const char* path, uint16_t* width,
+                                 uint16_t* height) {
+  Entry* entry = this->findEntry(path);
+  if (entry == NULL) {
+    return NULL;
+  }
+  entry->lastUsed = ++this->useCounter;
+  if (width != NULL) {
+    *width = entry->width;
+  }
+  if (height != NULL) {
+    *height = entry->height;
+  }
+  return entry->pixels;
+}
+
+// Decodes the image into the cache unless it is already there. Returns NULL
+// when it could not be decoded, was aborted or there is no memory for it.
+const uint16_t* ImageCache::load(JPEGDEC* decoder, const char* path,
+                                 ImageCacheAbortCallback shouldAbort,
+                                 void* abortParam) {
+  this->aborted = false;
+  this->outOfMemory = false;
+  if (!this->began || strlen(path) >= IMAGE_CACHE_MAX_PATH_SIZE) {
+    return NULL;
+  }
+  const uint16_t* cached = this->find(path);
+  if (cached != NULL) {
+    return cached;
+  }
+
+  Entry* entry = this->getFreeEntry();
+  if (entry == NULL) {
+    Serial.println("Not enough memory to cache image");
+    this->outOfMemory = true;
+    return NULL;
+  }
+
+  const uint32_t startLoadTime = millis();
+  entry->valid = false;
+  this->target = entry;
+  this->shouldAbort = shouldAbort;
+  this->abortParam = abortParam;
+
+  ExifThumbnailInfo thumbnail;
+  bool hasThumbnail = false;
+  this->file = this->sd->open(path, O_RDONLY);
+  if (this->file) {
+    hasThumbnail = Exif::readThumbnailInfo(&this->file, &thumbnail);
+    this->file.close();
+  }
+  this->fileOffset = hasThumbnail ? thumbnail.offset : 0;
+  this->fileLength = hasThumbnail ? thumbnail.length : 0;
+  this->stretchWidth = 0;
+  this->stretchHeight = 0;
+
+  if (!decoder->open(path, ImageCache::openFile, ImageCache::closeFile,
+                     ImageCache::readFile, ImageCache::seekFile,
+                     ImageCache::drawFile)) {
+    Serial.printf("Could not open %s to cache\n", path);
+    this->target = NULL;
+    return NULL;
+  }
+  decoder->setPixelType(RGB565_BIG_ENDIAN);
+  memset(entry->pixels, 0, IMAGE_CACHE_IMAGE_BYTES);
+  int result = 0;
+  if (hasThumbnail) {
+    entry->width = thumbnail.imageWidth;
+    entry->height = thumbnail.imageHeight;
+    this->sourceWidth = decoder->getWidth();
+    this->sourceHeight = decoder->getHeight();
+    this->stretchWidth = min((int32_t)(entry->width + 7) / 8,
+                             (int32_t)IMAGE_CACHE_WIDTH);
+    this->stretchHeight = min((int32_t)(entry->height + 7) / 8,
+                              (int32_t)IMAGE_CACHE_HEIGHT);
+    result = decoder->decode(0, 0, 0);
+  } else {
+    result = decoder->decode(0, 0, JPEG_SCALE_EIGHTH);
+    entry->width = decoder->getWidth();
+    entry->height = decoder->getHeight();
+  }
+  decoder->close();
+  this->target = NULL;
+  this->fileOffset = 0;
+  this->fileLength = 0;
+
+  if (this->aborted) {
+    Serial.printf("Stopped caching %s\n", path);
+    return NULL;
+  }
+  if (result != 1) {
+    Serial.printf("Could not decode %s to cache\n", path);
+    return NULL;
+  }
+
+  strcpy(entry->path, path);
+  entry->valid = true;
+  entry->lastUsed = ++this->useCounter;
+  this->lastLoadTime = millis() - startLoadTime;
+  Serial.printf("Cached %s in %lu ms%s\n", path, this->lastLoadTime,
+                hasThumbnail ? " from its thumbnail" : "");
+  return entry->pixels;
+}
+
+// Frees every buffer, the cache can be used again right away
+void ImageCache::release() {
+  for (uint8_t i = 0; i < IMAGE_CACHE_ENTRIES; i++) {
+    Entry* entry = &this->entries[i];
+    if (entry->pixels != NULL) {
+      free(entry->pixels);
+      entry->pixels = NULL;
+    }
+    entry->valid = false;
+  }
+  this->allocatedBytes = 0;
+}
+
+uint32_t ImageCache::getAllocatedBytes() { return this->allocatedBytes; }
+
+uint32_t ImageCache::getLastLoadTime() { return this->lastLoadTime; }
+
+// Whether the last load() was stopped by its abort callback
+bool ImageCache::wasAborted() { return this->aborted; }
+
+// Whether the last load() could not get a buffer to decode into
+bool ImageCache::wasOutOfMemory() { return this->outOfMemory; }
+
+ImageCache::Entry* ImageCache::findEntry(const char* path) {
+  for (uint8_t i = 0; i < IMAGE_CACHE_ENTRIES; i++) {
+    Entry* entry = &this->entries[i];
+    if (entry->valid && strcmp(entry->path, path) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+// An entry with a buffer to decode into, preferring unused buffers, then new
+// ones while under the limit, then the least recently used image
+ImageCache::Entry* ImageCache::getFreeEntry() {
+  for (uint8_t i = 0; i < IMAGE_CACHE_ENTRIES; i++) {
+    Entry* entry = &this->entries[i];
+    if (entry->pixels != NULL && !entry->valid) {
+      return entry;
+    }
+  }
+
+  for (uint8_t i = 0; i < IMAGE_CACHE_ENTRIES; i++) {
+    Entry* entry = &this->entries[i];
+    if (entry->pixels == NULL &&
+        this->allocatedBytes + IMAGE_CACHE_IMAGE_BYTES <=
+            IMAGE_CACHE_MAX_BYTES) {
+      entry->pixels = (uint16_t*)malloc(IMAGE_CACHE_IMAGE_BYTES);
+      if (entry->pixels != NULL) {
+        this->allocatedBytes += IMAGE_CACHE_IMAGE_BYTES;
+        return entry;
+      }
+      break;
+    }
+  }
+
+  Entry* oldest = NULL;
+  for (uint8_t i = 0; i < IMAGE_CACHE_ENTRIES; i++) {
+    Entry* entry = &this->entries[i];
+    if (entry->pixels != NULL &&
+        (oldest == NULL || entry->lastUsed < oldest->lastUsed)) {
+      oldest = entry;
+    }
+  }
+  return oldest;
+}
+
+void* ImageCache::openFile(const char* filename, int32_t* size) {
+  ImageCache* self = ImageCache::instance;
+  self->file = self->sd->open(filename, O_RDONLY);
+  if (!self->file) {
+    return NULL;
+  }
+  if (self->fileLength > 0) {
+    *size = self->fileLength;
+    self->file.seek(self->fileOffset);
+  } else {
+    *size = self->file.size();
+  }
+  return &self->file;
+}
+
+void ImageCache::closeFile(void* handle) {
+  ImageCache* self = ImageCache::instance;
+  if (self->file) {
+    self->file.close();
+  }
+}
+
+int32_t ImageCache::readFile(JPEGFILE* handle, uint8_t* buffer,
+                             int32_t length) {
+  ImageCache* self = ImageCache::instance;
+  if (self->fileLength > 0) {
+    const int32_t remaining =
+        self->fileOffset + self->fileLength - self->file.curPosition();
+    length = max(min(length, remaining), (int32_t)0);
+  }
+  return self->file.read(buffer, length);
+}
+
+int32_t ImageCache::seekFile(JPEGFILE* handle, int32_t position) {
+  ImageCache* self = ImageCache::instance;
+  return self->file.seek(self->fileOffset + position);
+}
+
+// Copies the part of the block that falls inside the cached image
+int ImageCache::drawFile(JPEGDRAW* pDraw) {
+  ImageCache* self = ImageCache::instance;
+  if (self->shouldAbort != NULL && self->shouldAbort(self->abortParam)) {
+    self->aborted = true;
+    return 0;
+  }
+
+  if (self->stretchWidth > 0) {
+    ImageCache::stretchBlock(pDraw);
+    return 1;
+  }
+
+  const int32_t width =
+      min((int32_t)pDraw->iWidth, (int32_t)IMAGE_CACHE_WIDTH - pDraw->x);
+  const int32_t height =
+      min((int32_t)pDraw->iHeight, (int32_t)IMAGE_CACHE_HEIGHT - pDraw->y);
+  if (width <= 0 || height <= 0) {
+    return 1;
+  }
+  for (int32_t y = 0; y < height; y++) {
+    memcpy(self->target->pixels + (pDraw->y + y) * IMAGE_CACHE_WIDTH +
+               pDraw->x,
+           pDraw->pPixels + y * pDraw->iWidth, width * sizeof(uint16_t));
+  }
+  return 1;
+}
+
+// Copies every pixel of a thumbnail block to the pixels of the stretched
+// image that are nearest to it
+void ImageCache::stretchBlock(JPEGDRAW* pDraw) {
+  ImageCache* self = ImageCache::instance;
+  const uint32_t sourceWidth = self->sourceWidth;
+  const uint32_t sourceHeight = self->sourceHeight;
+  const uint32_t width = self->stretchWidth;
+  const uint32_t height = self->stretchHeight;
+  for (int32_t y = 0; y < pDraw->iHeight; y++) {
+    const uint32_t sourceY = pDraw->y + y;
+    if (sourceY >= sourceHeight) {
+      break;
+    }
+    const uint16_t* source = pDraw->pPixels + y * pDraw->iWidth;
+    const uint32_t firstRow = (sourceY * height + sourceHeight - 1) /
+                              sourceHeight;
+    const uint32_t lastRow =
+        ((sourceY + 1) * height + sourceHeight - 1) / sourceHeight;
+    for (uint32_t row = firstRow; row < lastRow; row++) {
+      uint16_t* dest = self->target->pixels + row * IMAGE_CACHE_WIDTH;
+      for (int32_t x = 0; x < pDraw->iWidth; x++) {
+        const uint32_t sourceX = pDraw->x + x;
+        if (sourceX >= sourceWidth) {
+          break;
+        }
+        const uint32_t firstColumn =
+            (sourceX * width + sourceWidth - 1) / sourceWidth;
+        const uint32_t lastColumn =
+            ((sourceX + 1) * width + sourceWidth - 1) / sourceWidth;
+        for (uint32_t column = firstColumn; column < lastColumn; column++) {
+          dest[column] = source[x];
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Exif.h>
+#include <JPEGDEC.h>
+#include <SdFat.h>
+
+// Images are cached the way the image viewer shows them unzoomed, decoded at
+// 1/8 scale and cut to the display
+const uint16_t IMAGE_CACHE_WIDTH = 160;
+const uint16_t IMAGE_CACHE_HEIGHT = 128;
+const uint32_t IMAGE_CACHE_IMAGE_BYTES =
+    IMAGE_CACHE_WIDTH * IMAGE_CACHE_HEIGHT * sizeof(uint16_t);
+// The current image and one neighbour either way, never more than this is
+// allocated
+const uint8_t IMAGE_CACHE_ENTRIES = 3;
+const uint32_t IMAGE_CACHE_MAX_BYTES =
+    IMAGE_CACHE_ENTRIES * IMAGE_CACHE_IMAGE_BYTES;
+const size_t IMAGE_CACHE_MAX_PATH_SIZE = 256;
+
+// Called between MCU rows while decoding, returning true stops the decode
+typedef bool (*ImageCacheAbortCallback)(void* param);
+
+// Keeps the last few images decoded to display sized big endian RGB565, so
+// flipping back and forth between images only has to push them. Photos with
+// an embedded EXIF thumbnail have that decoded instead and stretched to where
+// the 1/8 scale photo would have been.
+//
+// Buffers are allocated the first time they are needed, up to
+// IMAGE_CACHE_MAX_BYTES, and the least recently used image is replaced after
+// that. release() gives all of them back to the heap.
+class ImageCache {
+  public:
+    bool begin(SdFs* sd);
+
+    const uint16_t* find(const char* path, uint16_t* width = NULL,
+                         uint16_t* height = NULL);
+    const uint16_t* load(JPEGDEC* decoder, const char* path,
+                         ImageCacheAbortCallback shouldAbort = NULL,
+                         void* abortParam = NULL);
+    void release();
+
+    uint32_t getAllocatedBytes();
+    uint32_t getLastLoadTime();
+    bool wasAborted();
+    bool wasOutOfMemory();
+
+  protected:
+    struct Entry {
+        char path[IMAGE_CACHE_MAX_PATH_SIZE];
+        uint16_t* pixels = NULL;
+        uint16_t width = 0;
+        uint16_t height = 0;
+        uint32_t lastUsed = 0;
+        bool valid = false;
+    };
+
+    Entry* findEntry(const char* path);
+    Entry* getFreeEntry();
+
+    static void* openFile(const char* filename, int32_t* size);
+    static void closeFile(void* handle);
+    static int32_t readFile(JPEGFILE* handle, uint8_t* buffer, int32_t length);
+    static int32_t seekFile(JPEGFILE* handle, int32_t position);
+    static int drawFile(JPEGDRAW* pDraw);
+    static void stretchBlock(JPEGDRAW* pDraw);
+
+    static ImageCache* instance;
+
+    bool began = false;
+
+    SdFs* sd;
+    FsFile file;
+    // Only this part of the file is given to the decoder when it is not 0
+    uint32_t fileOffset = 0;
+    uint32_t fileLength = 0;
+
+    Entry entries[IMAGE_CACHE_ENTRIES];
+    uint32_t allocatedBytes = 0;
+    uint32_t useCounter = 0;
+
+    // The entry being decoded into, and when to give up on it
+    Entry* target = NULL;
+    ImageCacheAbortCallback shouldAbort = NULL;
+    void* abortParam = NULL;
+    bool aborted = false;
+    bool outOfMemory = false;
+    // The size of the thumbnail being decoded and of what it is stretched to,
+    // 0 when decoding the photo itself
+    uint16_t sourceWidth = 0;
+    uint16_t sourceHeight = 0;
+    uint16_t stretchWidth = 0;
+    uint16_t stretchHeight = 0;
+
+    uint32_t lastLoadTime = 0;
+};
@@ -0,0 +1,492 @@
+#include <Arduino.h>
+#include "JPEGEncoder.h"
+
+// Tables from Annex K of the JPEG specification, quantization tables are in
+// natural order
+const uint8_t LUMA_QUANTIZATION[64] = {
+    16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,
+    14, 13, 16, 24, 40,  57,  69,  56,  14, 17, 22, 29, 51,  87,  80,  62,
+    18, 22, 37, 56, 68,  109, 103, 77,  24, 35, 55, 64, 81,  104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99};
+const uint8_t CHROMA_QUANTIZATION[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99};
+
+// Natural order index of every coefficient in zigzag order
+const uint8_t ZIGZAG[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+const uint8_t LUMA_DC_BITS[16] = {0, 1, 5, 1, 1, 1, 1, 1,
+                                  1, 0, 0, 0, 0, 0, 0, 0};
+const uint8_t CHROMA_DC_BITS[16] = {0, 3, 1, 1, 1, 1, 1, 1,
+                                    1, 1, 1, 0, 0, 0, 0, 0};
+const uint8_t DC_VALUES[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+const uint8_t LUMA_AC_BITS[16] = {0, 2, 1, 3, 3, 2, 4, 3,
+                                  5, 5, 4, 4, 0, 0, 1, 0x7D};
+const uint8_t LUMA_AC_VALUES[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
+    0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08,
+    0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0, 0x24, 0x33, 0x62, 0x72,
+    0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x73, 0x74, 0x75,
+    0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3,
+    0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6,
+    0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9,
+    0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4,
+    0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA};
+
+const uint8_t CHROMA_AC_BITS[16] = {0, 2, 1, 2, 4, 4, 3, 4,
+                                    7, 5, 4, 4, 0, 1, 2, 0x77};
+const uint8_t CHROMA_AC_VALUES[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41,
+    0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+    0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0, 0x15, 0x62, 0x72, 0xD1,
+    0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44,
+    0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+    0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x73, 0x74,
+    0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A,
+    0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4,
+    0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7,
+    0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4,
+    0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA};
+
+// Allocates the strip buffers and writes the headers, quality goes from 1 to
+// 100 like it does for libjpeg
+bool JPEGEncoder::begin(uint16_t width, uint16_t height, uint8_t quality,
+                        JPEGEncoderWriteCallback write, void* param) {
+  this->end();
+  if (width == 0 || height == 0 || width > JPEG_ENCODER_MAX_WIDTH) {
+    return false;
+  }
+
+  this->width = width;
+  this->height = height;
+  this->paddedWidth = (width + 15) & ~15;
+  this->rowsAdded = 0;
+  this->stripRow = 0;
+  this->write = write;
+  this->param = param;
+  this->bytesWritten = 0;
+  this->bitBuffer = 0;
+  this->bitCount = 0;
+  this->bufferUsed = 0;
+  memset(this->lastDC, 0, sizeof(this->lastDC));
+
+  const size_t chromaSize = (this->paddedWidth / 2) * 8 * sizeof(uint16_t);
+  this->luma = (uint8_t*)malloc(this->paddedWidth * 16);
+  this->chromaBlue = (uint16_t*)malloc(chromaSize);
+  this->chromaRed = (uint16_t*)malloc(chromaSize);
+  this->lastRow = (uint16_t*)malloc(width * sizeof(uint16_t));
+  if (this->luma == NULL || this->chromaBlue == NULL ||
+      this->chromaRed == NULL || this->lastRow == NULL) {
+    this->end();
+    return false;
+  }
+  memset(this->chromaBlue, 0, chromaSize);
+  memset(this->chromaRed, 0, chromaSize);
+
+  this->setQuality(quality);
+  JPEGEncoder::buildCodes(LUMA_DC_BITS, DC_VALUES, &this->lumaDC);
+  JPEGEncoder::buildCodes(LUMA_AC_BITS, LUMA_AC_VALUES, &this->lumaAC);
+  JPEGEncoder::buildCodes(CHROMA_DC_BITS, DC_VALUES, &this->chromaDC);
+  JPEGEncoder::buildCodes(CHROMA_AC_BITS, CHROMA_AC_VALUES, &this->chromaAC);
+
+  this->began = true;
+  this->ok = true;
+  this->writeHeaders();
+  return this->ok;
+}
+
+// Takes the next row of the image, width pixels of native RGB565
+bool JPEGEncoder::addRow(const uint16_t* row) {
+  if (!this->began || !this->ok || this->rowsAdded >= this->height) {
+    return false;
+  }
+
+  uint8_t* lumaRow = this->luma + this->stripRow * this->paddedWidth;
+  const uint16_t chromaOffset = (this->stripRow / 2) * (this->paddedWidth / 2);
+  uint16_t* blueRow = this->chromaBlue + chromaOffset;
+  uint16_t* redRow = this->chromaRed + chromaOffset;
+  for (uint16_t x = 0; x < this->paddedWidth; x++) {
+    const uint16_t pixel = row[min(x, (uint16_t)(this->width - 1))];
+    const int32_t r = (pixel >> 11) << 3 | (pixel >> 13);
+    const int32_t g = ((pixel >> 5) & 0x3F) << 2 | ((pixel >> 9) & 0x03);
+    const int32_t b = (pixel & 0x1F) << 3 | ((pixel >> 2) & 0x07);
+    lumaRow[x] = (19595 * r + 38470 * g + 7471 * b + 32768) >> 16;
+    blueRow[x / 2] +=
+        (-11059 * r - 21709 * g + 32768 * b + (128 << 16) + 32767) >> 16;
+    redRow[x / 2] +=
+        (32768 * r - 27439 * g - 5329 * b + (128 << 16) + 32767) >> 16;
+  }
+  if (row != this->lastRow) {
+    memcpy(this->lastRow, row, this->width * sizeof(uint16_t));
+  }
+
+  this->rowsAdded++;
+  this->stripRow++;
+  if (this->stripRow == 16) {
+    return this->encodeStrip();
+  }
+  return this->ok;
+}
+
+// Pads out the last strip and writes the end of the file. Returns false if
+// any write failed or rows are missing.
+bool JPEGEncoder::finish() {
+  if (!this->began) {
+    return false;
+  }
+  const bool complete = this->rowsAdded == this->height;
+  if (complete && this->stripRow > 0) {
+    // Repeats the last row, addRow() stops counting past the height
+    const uint8_t padding = 16 - this->stripRow;
+    for (uint8_t i = 0; i < padding && this->ok; i++) {
+      this->rowsAdded--;
+      this->addRow(this->lastRow);
+    }
+  }
+  if (this->ok) {
+    this->flushBits();
+    const uint8_t eoi[2] = {0xFF, 0xD9};
+    this->writeBytes(eoi, sizeof(eoi));
+    this->flushBuffer();
+  }
+  const bool result = this->ok && complete;
+  this->end();
+  return result;
+}
+
+// Frees the strip buffers, also stops an encode that is not finished
+void JPEGEncoder::end() {
+  if (this->luma != NULL) {
+    free(this->luma);
+    this->luma = NULL;
+  }
+  if (this->chromaBlue != NULL) {
+    free(this->chromaBlue);
+    this->chromaBlue = NULL;
+  }
+  if (this->chromaRed != NULL) {
+    free(this->chromaRed);
+    this->chromaRed = NULL;
+  }
+  if (this->lastRow != NULL) {
+    free(this->lastRow);
+    this->lastRow = NULL;
+  }
+  this->began = false;
+}
+
+uint32_t JPEGEncoder::getBytesWritten() { return this->bytesWritten; }
+
+// Scales the standard tables the way libjpeg does, the DCT output is 8 times
+// too big so that goes into the divisors
+void JPEGEncoder::setQuality(uint8_t quality) {
+  quality = constrain(quality, 1, 100);
+  const uint32_t scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+  for (uint8_t i = 0; i < 64; i++) {
+    const uint8_t natural = ZIGZAG[i];
+    const uint32_t luma =
+        constrain((LUMA_QUANTIZATION[natural] * scale + 50) / 100, 1, 255);
+    const uint32_t chroma =
+        constrain((CHROMA_QUANTIZATION[natural] * scale + 50) / 100, 1, 255);
+    this->lumaTable[i] = luma;
+    this->chromaTable[i] = chroma;
+    this->lumaDivisors[natural] = luma * 8;
+    this->chromaDivisors[natural] = chroma * 8;
+  }
+}
+
+// Encodes every MCU of the strip, four luma blocks then one of each chroma
+bool JPEGEncoder::encodeStrip() {
+  const uint16_t chromaWidth = this->paddedWidth / 2;
+  int16_t samples[64];
+  for (uint16_t mcuX = 0; mcuX < this->paddedWidth && this->ok; mcuX += 16) {
+    for (uint8_t block = 0; block < 4; block++) {
+      const uint8_t* source = this->luma +
+                              (block / 2) * 8 * this->paddedWidth + mcuX +
+                              (block % 2) * 8;
+      for (uint8_t y = 0; y < 8; y++) {
+        for (uint8_t x = 0; x < 8; x++) {
+          samples[y * 8 + x] = source[y * this->paddedWidth + x] - 128;
+        }
+      }
+      this->encodeBlock(samples, this->lumaDivisors, &this->lastDC[0],
+                        &this->lumaDC, &this->lumaAC);
+    }
+
+    uint16_t* chroma[2] = {this->chromaBlue, this->chromaRed};
+    for (uint8_t c = 0; c < 2; c++) {
+      const uint16_t* source = chroma[c] + mcuX / 2;
+      for (uint8_t y = 0; y < 8; y++) {
+        for (uint8_t x = 0; x < 8; x++) {
+          samples[y * 8 + x] = ((source[y * chromaWidth + x] + 2) >> 2) - 128;
+        }
+      }
+      this->encodeBlock(samples, this->chromaDivisors, &this->lastDC[c + 1],
+                        &this->chromaDC, &this->chromaAC);
+    }
+  }
+
+  const size_t chromaSize = chromaWidth * 8 * sizeof(uint16_t);
+  memset(this->chromaBlue, 0, chromaSize);
+  memset(this->chromaRed, 0, chromaSize);
+  this->stripRow = 0;
+  return this->ok;
+}
+
+void JPEGEncoder::encodeBlock(int16_t* samples, const uint16_t* divisors,
+                              int16_t* lastDC, const HuffmanCodes* dc,
+                              const HuffmanCodes* ac) {
+  int32_t data[64];
+  for (uint8_t i = 0; i < 64; i++) {
+    data[i] = samples[i];
+  }
+  JPEGEncoder::forwardDCT(data);
+
+  int16_t coefficients[64];
+  for (uint8_t i = 0; i < 64; i++) {
+    const uint8_t natural = ZIGZAG[i];
+    const int32_t value = data[natural];
+    const int32_t divisor = divisors[natural];
+    if (value < 0) {
+      coefficients[i] = -((-value + divisor / 2) / divisor);
+    } else {
+      coefficients[i] = (value + divisor / 2) / divisor;
+    }
+  }
+
+  // Values are sent as a size category followed by that many bits, negative
+  // ones as their ones complement
+  const int16_t diff = coefficients[0] - *lastDC;
+  *lastDC = coefficients[0];
+  uint16_t magnitude = abs(diff);
+  uint8_t size = 0;
+  while (magnitude > 0) {
+    size++;
+    magnitude >>= 1;
+  }
+  this->writeBits(dc->codes[size], dc->sizes[size]);
+  if (size > 0) {
+    this->writeBits((diff < 0 ? diff - 1 : diff) & ((1 << size) - 1), size);
+  }
+
+  uint8_t run = 0;
+  for (uint8_t i = 1; i < 64; i++) {
+    const int16_t value = coefficients[i];
+    if (value == 0) {
+      run++;
+      continue;
+    }
+    while (run >= 16) {
+      this->writeBits(ac->codes[0xF0], ac->sizes[0xF0]);
+      run -= 16;
+    }
+    magnitude = abs(value);
+    size = 0;
+    while (magnitude > 0) {
+      size++;
+      magnitude >>= 1;
+    }
+    const uint8_t symbol = run << 4 | size;
+    this->writeBits(ac->codes[symbol], ac->sizes[symbol]);
+    this->writeBits((value < 0 ? value - 1 : value) & ((1 << size) - 1), size);
+    run = 0;
+  }
+  if (run > 0) {
+    this->writeBits(ac->codes[0x00], ac->sizes[0x00]);
+  }
+}
+
+// SOI, quantization tables, frame header, Huffman tables and scan header
+void JPEGEncoder::writeHeaders() {
+  const uint8_t soi[2] = {0xFF, 0xD8};
+  this->writeBytes(soi, sizeof(soi));
+
+  const uint8_t dqt[4] = {0xFF, 0xDB, 0x00, 2 + 65 * 2};
+  this->writeBytes(dqt, sizeof(dqt));
+  this->writeByte(0x00);
+  this->writeBytes(this->lumaTable, 64);
+  this->writeByte(0x01);
+  this->writeBytes(this->chromaTable, 64);
+
+  const uint8_t sof[19] = {
+      0xFF, 0xC0, 0x00, 17, 8, (uint8_t)(this->height >> 8),
+      (uint8_t)(this->height & 0xFF), (uint8_t)(this->width >> 8),
+      (uint8_t)(this->width & 0xFF), 3, 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1};
+  this->writeBytes(sof, sizeof(sof));
+
+  const uint16_t dhtLength = 2 + 4 * 17 + 12 * 2 + 162 * 2;
+  const uint8_t dht[4] = {0xFF, 0xC4, (uint8_t)(dhtLength >> 8),
+                          (uint8_t)(dhtLength & 0xFF)};
+  this->writeBytes(dht, sizeof(dht));
+  this->writeByte(0x00);
+  this->writeBytes(LUMA_DC_BITS, 16);
+  this->writeBytes(DC_VALUES, 12);
+  this->writeByte(0x10);
+  this->writeBytes(LUMA_AC_BITS, 16);
+  this->writeBytes(LUMA_AC_VALUES, 162);
+  this->writeByte(0x01);
+  this->writeBytes(CHROMA_DC_BITS, 16);
+  this->writeBytes(DC_VALUES, 12);
+  this->writeByte(0x11);
+  this->writeBytes(CHROMA_AC_BITS, 16);
+  this->writeBytes(CHROMA_AC_VALUES, 162);
+
+  const uint8_t sos[14] = {0xFF, 0xDA, 0x00, 12,   3, 1, 0x00,
+                           2,    0x11, 3,    0x11, 0, 63, 0};
+  this->writeBytes(sos, sizeof(sos));
+}
+
+void JPEGEncoder::writeBits(uint32_t bits, uint8_t count) {
+  this->bitBuffer = this->bitBuffer << count | bits;
+  this->bitCount += count;
+  while (this->bitCount >= 8) {
+    this->bitCount -= 8;
+    const uint8_t value = this->bitBuffer >> this->bitCount;
+    this->writeByte(value);
+    // A data byte of 0xFF is followed by a zero so it is not read as a marker
+    if (value == 0xFF) {
+      this->writeByte(0x00);
+    }
+  }
+  this->bitBuffer &= (1 << this->bitCount) - 1;
+}
+
+// Pads the last byte of the entropy coded data with ones
+void JPEGEncoder::flushBits() {
+  if (this->bitCount > 0) {
+    this->writeBits((1 << (8 - this->bitCount)) - 1, 8 - this->bitCount);
+  }
+}
+
+void JPEGEncoder::writeByte(uint8_t value) {
+  if (this->bufferUsed == JPEG_ENCODER_BUFFER_SIZE) {
+    this->flushBuffer();
+  }
+  this->buffer[this->bufferUsed++] = value;
+}
+
+void JPEGEncoder::writeBytes(const uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    this->writeByte(data[i]);
+  }
+}
+
+bool JPEGEncoder::flushBuffer() {
+  if (this->bufferUsed > 0 && this->ok) {
+    this->ok = this->write(this->buffer, this->bufferUsed, this->param);
+    this->bytesWritten += this->bufferUsed;
+  }
+  this->bufferUsed = 0;
+  return this->ok;
+}
+
+// Canonical Huffman codes from the code length counts, indexed by symbol
+void JPEGEncoder::buildCodes(const uint8_t* bits, const uint8_t* values,
+                             HuffmanCodes* codes) {
+  memset(codes, 0, sizeof(HuffmanCodes));
+  uint16_t code = 0;
+  uint16_t k = 0;
+  for (uint8_t length = 1; length <= 16; length++) {
+    for (uint8_t i = 0; i < bits[length - 1]; i++) {
+      codes->codes[values[k]] = code;
+      codes->sizes[values[k]] = length;
+      code++;
+      k++;
+    }
+    code <<= 1;
+  }
+}
+
+// The IJG accurate integer DCT (jfdctint.c), in place on one block. The
+// output is scaled up by 8.
+void JPEGEncoder::forwardDCT(int32_t* data) {
+  const uint8_t constBits = 13;
+  const uint8_t pass1Bits = 2;
+  const int32_t fix_0_298631336 = 2446;
+  const int32_t fix_0_390180644 = 3196;
+  const int32_t fix_0_541196100 = 4433;
+  const int32_t fix_0_765366865 = 6270;
+  const int32_t fix_0_899976223 = 7373;
+  const int32_t fix_1_175875602 = 9633;
+  const int32_t fix_1_501321110 = 12299;
+  const int32_t fix_1_847759065 = 15137;
+  const int32_t fix_1_961570560 = 16069;
+  const int32_t fix_2_053119869 = 16819;
+  const int32_t fix_2_562915447 = 20995;
+  const int32_t fix_3_072711026 = 25172;
+
+  // Rows first, then columns, with the same butterflies and different scaling
+  for (uint8_t pass = 0; pass < 2; pass++) {
+    const uint8_t step = pass == 0 ? 1 : 8;
+    const uint8_t stride = pass == 0 ? 8 : 1;
+    const uint8_t evenShift = pass == 0 ? 0 : pass1Bits;
+    const uint8_t oddShift =
+        pass == 0 ? constBits - pass1Bits : constBits + pass1Bits;
+    const int32_t oddRound = (int32_t)1 << (oddShift - 1);
+
+    for (uint8_t i = 0; i < 8; i++) {
+      int32_t* d = data + i * stride;
+      const int32_t tmp0 = d[0] + d[step * 7];
+      int32_t tmp7 = d[0] - d[step * 7];
+      const int32_t tmp1 = d[step] + d[step * 6];
+      int32_t tmp6 = d[step] - d[step * 6];
+      const int32_t tmp2 = d[step * 2] + d[step * 5];
+      int32_t tmp5 = d[step * 2] - d[step * 5];
+      const int32_t tmp3 = d[step * 3] + d[step * 4];
+      int32_t tmp4 = d[step * 3] - d[step * 4];
+
+      const int32_t tmp10 = tmp0 + tmp3;
+      const int32_t tmp13 = tmp0 - tmp3;
+      const int32_t tmp11 = tmp1 + tmp2;
+      const int32_t tmp12 = tmp1 - tmp2;
+
+      if (pass == 0) {
+        d[0] = (tmp10 + tmp11) * (1 << pass1Bits);
+        d[step * 4] = (tmp10 - tmp11) * (1 << pass1Bits);
+      } else {
+        const int32_t evenRound = 1 << (evenShift - 1);
+        d[0] = (tmp10 + tmp11 + evenRound) >> evenShift;
+        d[step * 4] = (tmp10 - tmp11 + evenRound) >> evenShift;
+      }
+
+      int32_t z1 = (tmp12 + tmp13) * fix_0_541196100;
+      d[step * 2] = (z1 + tmp13 * fix_0_765366865 + oddRound) >> oddShift;
+      d[step * 6] = (z1 - tmp12 * fix_1_847759065 + oddRound) >> oddShift;
+
+      z1 = tmp4 + tmp7;
+      int32_t z2 = tmp5 + tmp6;
+      int32_t z3 = tmp4 + tmp6;
+      int32_t z4 = tmp5 + tmp7;
+      const int32_t z5 = (z3 + z4) * fix_1_175875602;
+
+      tmp4 *= fix_0_298631336;
+      tmp5 *= fix_2_053119869;
+      tmp6 *= fix_3_072711026;
+      tmp7 *= fix_1_501321110;
+      z1 *= -fix_0_899976223;
+      z2 *= -fix_2_562915447;
+      z3 = z3 * -fix_1_961570560 + z5;
+      z4 = z4 * -fix_0_390180644 + z5;
+
+      d[step * 7] = (tmp4 + z1 + z3 + oddRound) >> oddShift;
+      d[step * 5] = (tmp5 + z2 + z4 + oddRound) >> oddShift;
+      d[step * 3] = (tmp6 + z2 + z3 + oddRound) >> oddShift;
+      d[step] = (tmp7 + z1 + z4 + oddRound) >> oddShift;
+    }
+  }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Widest image the encoder takes, its strip buffers are sized for it
+const uint16_t JPEG_ENCODER_MAX_WIDTH = 320;
+// Encoded data is handed to the write callback in chunks of this size
+const size_t JPEG_ENCODER_BUFFER_SIZE = 256;
+
+// Called with consecutive chunks of the encoded file, returning false stops
+// the encode
+typedef bool (*JPEGEncoderWriteCallback)(const uint8_t* data, size_t length,
+                                         void* param);
+
+// Baseline JPEG encoder for small images such as thumbnails. Rows of native
+// RGB565 are fed in one at a time and the file is written out as soon as
+// every 16 row strip is complete, so only one strip is ever kept in RAM.
+//
+// Chroma is subsampled 4:2:0, the DCT is the integer one from the IJG library
+// and the Huffman tables are the standard ones from the JPEG specification.
+class JPEGEncoder {
+  public:
+    bool begin(uint16_t width, uint16_t height, uint8_t quality,
+               JPEGEncoderWriteCallback write, void* param = NULL);
+    bool addRow(const uint16_t* row);
+    bool finish();
+    void end();
+
+    uint32_t getBytesWritten();
+
+  protected:
+    struct HuffmanCodes {
+        uint16_t codes[256];
+        uint8_t sizes[256];
+    };
+
+    void setQuality(uint8_t quality);
+    bool encodeStrip();
+    void encodeBlock(int16_t* samples, const uint16_t* divisors,
+                     int16_t* lastDC, const HuffmanCodes* dc,
+                     const HuffmanCodes* ac);
+    void writeHeaders();
+    void writeBits(uint32_t bits, uint8_t count);
+    void flushBits();
+    void writeByte(uint8_t value);
+    void writeBytes(const uint8_t* data, size_t length);
+    bool flushBuffer();
+
+    static void buildCodes(const uint8_t* bits, const uint8_t* values,
+                           HuffmanCodes* codes);
+    static void forwardDCT(int32_t* data);
+
+    bool began = false;
+    bool ok = false;
+
+    uint16_t width = 0;
+    uint16_t height = 0;
+    uint16_t paddedWidth = 0;
+    uint16_t rowsAdded = 0;
+    uint8_t stripRow = 0;
+
+    JPEGEncoderWriteCallback write = NULL;
+    void* param = NULL;
+    uint32_t bytesWritten = 0;
+
+    // One 16 row strip of luma, and chroma summed over 2x2 pixels. The last
+    // row is kept to pad out a partial strip.
+    uint8_t* luma = NULL;
+    uint16_t* chromaBlue = NULL;
+    uint16_t* chromaRed = NULL;
+    uint16_t* lastRow = NULL;
+
+    // Quantization tables in zigzag order, and the divisors they turn into
+    // for the scaled output of the DCT
+    uint8_t lumaTable[64];
+    uint8_t chromaTable[64];
+    uint16_t lumaDivisors[64];
+    uint16_t chromaDivisors[64];
+
+    HuffmanCodes lumaDC;
+    HuffmanCodes lumaAC;
+    HuffmanCodes chromaDC;
+    HuffmanCodes chromaAC;
+
+    int16_t lastDC[3];
+    uint32_t bitBuffer = 0;
+    uint8_t bitCount = 0;
+    uint8_t buffer[JPEG_ENCODER_BUFFER_SIZE];
+    size_t bufferUsed = 0;
+};
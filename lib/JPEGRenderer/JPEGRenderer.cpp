@@ -0,0 +1,560 @@
+#include <Arduino.h>
+#include "JPEGRenderer.h"
+
+bool JPEGRenderer::begin(TFT_eSPI* tft, bool dualCore, bool useDMA) {
+  if (this->began) {
+    return true;
+  }
+
+  this->tft = tft;
+  this->useDMA = useDMA;
+
+  for (uint16_t i = 0; i < 256; i++) {
+    const uint16_t color = tft->color565(i, i, i);
+    this->grayPalette[i] = (color << 8) | (color >> 8);
+  }
+
+  if (this->useDMA) {
+    this->tft->initDMA();
+  }
+
+  if (dualCore) {
+    Serial.print("Starting display task...");
+    if (xTaskCreatePinnedToCore(JPEGRenderer::displayTask, "JPEGRenderer",
+                                RENDERER_TASK_STACK_SIZE, this,
+                                RENDERER_TASK_PRIORITY, &this->task,
+                                RENDERER_TASK_CORE) == pdPASS) {
+      Serial.println("ok!");
+      this->dualCore = true;
+    } else {
+      Serial.println("error! Falling back to single core rendering");
+      this->task = NULL;
+    }
+  }
+
+  if (!this->dualCore) {
+    this->dmaBuffers[0] = this->pool.acquire();
+    this->dmaBuffers[1] = this->pool.acquire();
+  }
+
+  this->began = true;
+  return true;
+}
+
+void JPEGRenderer::startFrame() {
+  this->frameTiles = 0;
+  this->frameSkippedTiles = 0;
+  if (this->histogram) {
+    memset(this->frameHistogram, 0, sizeof(this->frameHistogram));
+    this->frameHistogramSamples = 0;
+    this->frameHistogramTime = 0;
+  }
+  this->framePeakingMax = 0;
+  this->framePeakingBlocks = 0;
+  this->framePeakingTime = 0;
+  this->frameStartTime = micros();
+  if (!this->dualCore) {
+    this->tft->startWrite();
+  }
+}
+
+// Returns once every block of the frame is on the display and the bus is free
+void JPEGRenderer::finishFrame() {
+  if (this->dualCore) {
+    this->waitForQueue();
+  } else {
+    this->tft->endWrite();
+  }
+  this->lastFrameTiles = this->frameTiles;
+  this->lastFrameSkippedTiles = this->frameSkippedTiles;
+
+  if (this->histogram) {
+    memcpy(this->lastHistogram, this->frameHistogram,
+           sizeof(this->lastHistogram));
+    this->lastHistogramSamples = this->frameHistogramSamples;
+    this->lastFrameHistogramTime = this->frameHistogramTime;
+    if (this->frameHistogramTime > RENDERER_HISTOGRAM_BUDGET &&
+        this->histogramStep < RENDERER_HISTOGRAM_MAX_STEP) {
+      this->histogramStep++;
+    } else if (this->frameHistogramTime < RENDERER_HISTOGRAM_BUDGET / 2 &&
+               this->histogramStep > 1) {
+      this->histogramStep--;
+    }
+  }
+
+  if (this->focusPeaking) {
+    this->lastFramePeakingBlocks = this->framePeakingBlocks;
+    this->lastFramePeakingTime = this->framePeakingTime;
+    this->peakingThreshold =
+        max((uint16_t)RENDERER_PEAKING_MIN_ENERGY,
+            (uint16_t)(this->framePeakingMax * RENDERER_PEAKING_RELATIVE / 100));
+    const uint32_t frameTime = micros() - this->frameStartTime;
+    if (this->framePeakingTime * 100 > frameTime * RENDERER_PEAKING_MAX_PERCENT &&
+        this->peakingStep < RENDERER_TILE_SIZE) {
+      this->peakingStep *= 2;
+    } else if (this->framePeakingTime * 200 <
+                   frameTime * RENDERER_PEAKING_MAX_PERCENT &&
+               this->peakingStep > 1) {
+      this->peakingStep /= 2;
+    }
+  }
+}
+
+// Called before the decoder reads from the SD card, which shares the bus. In
+// dual core mode the display task already gives up the bus whenever its queue
+// runs dry, so there is nothing to do.
+void JPEGRenderer::releaseBus() {
+  if (!this->dualCore) {
+    this->tft->endWrite();
+  }
+}
+
+// Blocks are moved by the origin and clipped to the display. The visible rows
+// of a partly visible block are packed to the front of the decoder's buffer.
+int JPEGRenderer::draw(JPEGDRAW* pDraw) {
+  const int32_t x = pDraw->x - this->originX;
+  const int32_t y = pDraw->y - this->originY;
+  const int32_t left = max((int32_t)0, -x);
+  const int32_t top = max((int32_t)0, -y);
+  const int32_t right = min((int32_t)pDraw->iWidth, this->tft->width() - x);
+  const int32_t bottom = min((int32_t)pDraw->iHeight, this->tft->height() - y);
+  if (left >= right || top >= bottom) {
+    return 1;
+  }
+
+  JPEGDRAW block = *pDraw;
+  block.x = x + left;
+  block.y = y + top;
+  block.iWidth = right - left;
+  block.iHeight = bottom - top;
+  if (left > 0 || top > 0 || block.iWidth != pDraw->iWidth) {
+    const uint8_t bytes = pDraw->iBpp == 8 ? 1 : 2;
+    uint8_t* pixels = (uint8_t*)pDraw->pPixels;
+    for (int32_t i = 0; i < block.iHeight; i++) {
+      memmove(pixels + i * block.iWidth * bytes,
+              pixels + ((top + i) * pDraw->iWidth + left) * bytes,
+              block.iWidth * bytes);
+    }
+  }
+
+  if (block.iBpp == 8) {
+    this->drawGrayscale(&block);
+  } else {
+    this->drawRGB565(&block);
+  }
+  return 1;
+}
+
+void JPEGRenderer::drawRGB565(JPEGDRAW* pDraw) {
+  if (this->histogram) {
+    this->collectHistogram(pDraw);
+  }
+  if (this->focusPeaking) {
+    this->applyFocusPeaking(pDraw);
+  }
+  if (this->dirtyTracking && pDraw->x % RENDERER_TILE_SIZE == 0 &&
+      pDraw->y % RENDERER_TILE_SIZE == 0 &&
+      pDraw->iWidth % RENDERER_TILE_SIZE == 0 &&
+      pDraw->iHeight % RENDERER_TILE_SIZE == 0 &&
+      pDraw->x + pDraw->iWidth <= RENDERER_MAX_WIDTH &&
+      pDraw->y + pDraw->iHeight <= RENDERER_MAX_HEIGHT) {
+    this->drawTiles(pDraw);
+  } else {
+    this->emitBlock(pDraw->x, pDraw->y, pDraw->iWidth, pDraw->iHeight,
+                    pDraw->pPixels, pDraw->iWidth);
+  }
+}
+
+// Expands 8 bit luma through the palette into a borrowed block, in strips a
+// whole number of tiles high so dirty tracking still lines up
+void JPEGRenderer::drawGrayscale(JPEGDRAW* pDraw) {
+  const uint8_t* luma = (const uint8_t*)pDraw->pPixels;
+  const int16_t columns = min(pDraw->iWidth, (int)RENDERER_BLOCK_PIXELS);
+  int16_t rows = RENDERER_BLOCK_PIXELS / columns;
+  if (rows >= RENDERER_TILE_SIZE) {
+    rows -= rows % RENDERER_TILE_SIZE;
+  }
+
+  BlockPool::Handle block = this->pool.acquireBlocking();
+  uint16_t* buffer = (uint16_t*)block.data();
+  JPEGDRAW strip = *pDraw;
+  strip.iBpp = 16;
+  strip.pPixels = buffer;
+
+  for (int16_t y = 0; y < pDraw->iHeight; y += rows) {
+    for (int16_t x = 0; x < pDraw->iWidth; x += columns) {
+      strip.x = pDraw->x + x;
+      strip.y = pDraw->y + y;
+      strip.iWidth = min(columns, (int16_t)(pDraw->iWidth - x));
+      strip.iHeight = min(rows, (int16_t)(pDraw->iHeight - y));
+      for (int16_t i = 0; i < strip.iHeight; i++) {
+        const uint8_t* source = luma + (y + i) * pDraw->iWidth + x;
+        uint16_t* dest = buffer + i * strip.iWidth;
+        for (int16_t j = 0; j < strip.iWidth; j++) {
+          dest[j] = this->grayPalette[source[j]];
+        }
+      }
+      this->drawRGB565(&strip);
+    }
+  }
+}
+
+// Anything drawn over the image (menus, dialogs) makes the signatures stale, so
+// this has to be called before the next frame in that case
+void JPEGRenderer::setDirtyTracking(bool enabled, uint8_t threshold) {
+  this->dirtyTracking = enabled;
+  this->dirtyThreshold = threshold;
+  this->invalidate();
+}
+
+// Where the top left corner of the display is in decoder coordinates
+void JPEGRenderer::setOrigin(int16_t x, int16_t y) {
+  this->originX = x;
+  this->originY = y;
+}
+
+// Whether any of an area, in the same coordinates as the blocks, would end up
+// on the display
+bool JPEGRenderer::isVisible(int32_t x, int32_t y, int32_t width,
+                             int32_t height) {
+  x -= this->originX;
+  y -= this->originY;
+  return x < this->tft->width() && y < this->tft->height() && x + width > 0 &&
+         y + height > 0;
+}
+
+void JPEGRenderer::invalidate() {
+  memset(this->signaturesValid, 0, sizeof(this->signaturesValid));
+}
+
+bool JPEGRenderer::isDualCore() { return this->dualCore; }
+
+bool JPEGRenderer::isUsingDMA() { return this->useDMA; }
+
+bool JPEGRenderer::isDirtyTracking() { return this->dirtyTracking; }
+
+void JPEGRenderer::setHistogram(bool enabled) {
+  this->histogram = enabled;
+  this->histogramStep = 1;
+  memset(this->lastHistogram, 0, sizeof(this->lastHistogram));
+  this->lastHistogramSamples = 0;
+  this->lastFrameHistogramTime = 0;
+}
+
+bool JPEGRenderer::isHistogramEnabled() { return this->histogram; }
+
+// Copies the buckets of the last finished frame and returns how many blocks
+// were counted into them
+uint32_t JPEGRenderer::getHistogram(uint16_t* buckets) {
+  memcpy(buckets, this->lastHistogram, sizeof(this->lastHistogram));
+  return this->lastHistogramSamples;
+}
+
+uint32_t JPEGRenderer::getLastFrameHistogramTime() {
+  return this->lastFrameHistogramTime;
+}
+
+// The first frame only measures, since the threshold comes from the sharpest
+// block of the previous one
+void JPEGRenderer::setFocusPeaking(bool enabled) {
+  this->focusPeaking = enabled;
+  this->peakingStep = 1;
+  this->peakingThreshold = 0xFF;
+  this->lastFramePeakingBlocks = 0;
+  this->lastFramePeakingTime = 0;
+  this->invalidate();
+}
+
+bool JPEGRenderer::isFocusPeaking() { return this->focusPeaking; }
+
+uint16_t JPEGRenderer::getLastFramePeakingBlocks() {
+  return this->lastFramePeakingBlocks;
+}
+
+uint32_t JPEGRenderer::getLastFramePeakingTime() {
+  return this->lastFramePeakingTime;
+}
+
+uint16_t JPEGRenderer::getLastFrameTiles() { return this->lastFrameTiles; }
+
+uint16_t JPEGRenderer::getLastFrameSkippedTiles() {
+  return this->lastFrameSkippedTiles;
+}
+
+uint32_t JPEGRenderer::getLastFrameSkippedBytes() {
+  return this->lastFrameSkippedTiles * RENDERER_TILE_SIZE *
+         RENDERER_TILE_SIZE * sizeof(uint16_t);
+}
+
+// Each row of tiles is pushed as runs of consecutive changed tiles
+void JPEGRenderer::drawTiles(JPEGDRAW* pDraw) {
+  const int16_t stride = pDraw->iWidth;
+  const uint8_t tilesPerRow = pDraw->iWidth / RENDERER_TILE_SIZE;
+
+  for (int16_t tileY = 0; tileY < pDraw->iHeight;
+       tileY += RENDERER_TILE_SIZE) {
+    const uint16_t* row = pDraw->pPixels + tileY * stride;
+    const uint16_t tileRow = (pDraw->y + tileY) / RENDERER_TILE_SIZE;
+    int16_t runStart = -1;
+
+    for (uint8_t i = 0; i <= tilesPerRow; i++) {
+      bool unchanged = true;
+      if (i < tilesPerRow) {
+        const uint16_t tile =
+            tileRow * RENDERER_TILE_COLUMNS +
+            (pDraw->x + i * RENDERER_TILE_SIZE) / RENDERER_TILE_SIZE;
+        unchanged = this->isTileUnchanged(
+            tile, this->getTileSignature(row + i * RENDERER_TILE_SIZE, stride));
+        this->frameTiles++;
+        if (unchanged) {
+          this->frameSkippedTiles++;
+        }
+      }
+      if (!unchanged && runStart == -1) {
+        runStart = i;
+      } else if (unchanged && runStart != -1) {
+        this->emitBlock(pDraw->x + runStart * RENDERER_TILE_SIZE,
+                        pDraw->y + tileY, (i - runStart) * RENDERER_TILE_SIZE,
+                        RENDERER_TILE_SIZE, row + runStart * RENDERER_TILE_SIZE,
+                        stride);
+        runStart = -1;
+      }
+    }
+  }
+}
+
+// Only blocks on the 8x8 grid of the display count, every histogramStep-th
+// one along each diagonal so skipped blocks are spread over the frame
+void JPEGRenderer::collectHistogram(JPEGDRAW* pDraw) {
+  const uint32_t startTime = micros();
+  const uint8_t size = RENDERER_TILE_SIZE;
+  const int16_t firstX = (pDraw->x + size - 1) / size * size - pDraw->x;
+  const int16_t firstY = (pDraw->y + size - 1) / size * size - pDraw->y;
+
+  for (int16_t y = firstY; y + size <= pDraw->iHeight; y += size) {
+    const uint16_t* row = pDraw->pPixels + y * pDraw->iWidth;
+    const uint16_t blockY = (pDraw->y + y) / size;
+    for (int16_t x = firstX; x + size <= pDraw->iWidth; x += size) {
+      if (((pDraw->x + x) / size + blockY) % this->histogramStep != 0) {
+        continue;
+      }
+      uint16_t sum = 0;
+      for (uint8_t i = 0; i < 4; i++) {
+        // Pixels are big endian
+        const uint16_t value =
+            row[((i >> 1) * 3 + 2) * pDraw->iWidth + x + (i & 1) * 3 + 2];
+        const uint16_t pixel = (value << 8) | (value >> 8);
+        sum += (616 * ((pixel >> 11) & 0x1F) + 600 * ((pixel >> 5) & 0x3F) +
+                232 * (pixel & 0x1F)) >>
+               8;
+      }
+      this->frameHistogram[(sum / 4) * RENDERER_HISTOGRAM_BUCKETS / 256]++;
+      this->frameHistogramSamples++;
+    }
+  }
+
+  this->frameHistogramTime += micros() - startTime;
+}
+
+// Tints blocks on the 8x8 grid of the display in place, before they are
+// compared against the tile signatures and pushed
+void JPEGRenderer::applyFocusPeaking(JPEGDRAW* pDraw) {
+  const uint32_t startTime = micros();
+  const uint8_t size = RENDERER_TILE_SIZE;
+  const int16_t firstX = (pDraw->x + size - 1) / size * size - pDraw->x;
+  const int16_t firstY = (pDraw->y + size - 1) / size * size - pDraw->y;
+
+  for (int16_t y = firstY; y + size <= pDraw->iHeight; y += size) {
+    for (int16_t x = firstX; x + size <= pDraw->iWidth; x += size) {
+      uint16_t* block = pDraw->pPixels + y * pDraw->iWidth + x;
+      const uint8_t energy = this->getBlockEnergy(block, pDraw->iWidth);
+      this->framePeakingMax = max(this->framePeakingMax, energy);
+      if (energy < this->peakingThreshold) {
+        continue;
+      }
+      this->framePeakingBlocks++;
+      for (uint8_t i = 0; i < size; i++) {
+        uint16_t* line = block + i * pDraw->iWidth;
+        for (uint8_t j = 0; j < size; j++) {
+          // Half brightness with the top red bit set, still big endian
+          const uint16_t pixel = (line[j] << 8) | (line[j] >> 8);
+          const uint16_t tinted = ((pixel >> 1) & 0x7BEF) | 0x8000;
+          line[j] = (tinted << 8) | (tinted >> 8);
+        }
+      }
+    }
+  }
+
+  this->framePeakingTime += micros() - startTime;
+}
+
+// Mean absolute difference of neighbouring green values (6 bit, close enough
+// to luma) along every peakingStep-th row and column of the block
+uint8_t JPEGRenderer::getBlockEnergy(const uint16_t* pixels, int16_t stride) {
+  const uint8_t size = RENDERER_TILE_SIZE;
+  uint16_t sum = 0;
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < size; i += this->peakingStep) {
+    for (uint8_t j = 0; j + 1 < size; j++) {
+      // Pixels are big endian, so green is split across both bytes
+      const uint16_t a = pixels[i * stride + j];
+      const uint16_t b = pixels[i * stride + j + 1];
+      const uint16_t c = pixels[j * stride + i];
+      const uint16_t d = pixels[(j + 1) * stride + i];
+      const int8_t horizontal =
+          (((a << 3) & 0x38) | (a >> 13)) - (((b << 3) & 0x38) | (b >> 13));
+      const int8_t vertical =
+          (((c << 3) & 0x38) | (c >> 13)) - (((d << 3) & 0x38) | (d >> 13));
+      sum += abs(horizontal) + abs(vertical);
+      count += 2;
+    }
+  }
+  return sum / count;
+}
+
+// Packs the average approximate luma (0 - 125) of the four 4x4 quadrants
+uint32_t JPEGRenderer::getTileSignature(const uint16_t* pixels,
+                                        int16_t stride) {
+  const uint8_t half = RENDERER_TILE_SIZE / 2;
+  uint16_t sums[4] = {0, 0, 0, 0};
+  for (uint8_t y = 0; y < RENDERER_TILE_SIZE; y++) {
+    const uint16_t* line = pixels + y * stride;
+    for (uint8_t x = 0; x < RENDERER_TILE_SIZE; x++) {
+      // Pixels are big endian
+      const uint16_t pixel = (line[x] << 8) | (line[x] >> 8);
+      const uint8_t luma =
+          ((pixel >> 11) & 0x1F) + ((pixel >> 5) & 0x3F) + (pixel & 0x1F);
+      sums[(y / half) * 2 + x / half] += luma;
+    }
+  }
+  return (uint32_t)(sums[0] / (half * half)) |
+         (uint32_t)(sums[1] / (half * half)) << 8 |
+         (uint32_t)(sums[2] / (half * half)) << 16 |
+         (uint32_t)(sums[3] / (half * half)) << 24;
+}
+
+// Updates the stored signature only when the tile gets pushed, so slow drift
+// still triggers a redraw once it adds up past the threshold
+bool JPEGRenderer::isTileUnchanged(uint16_t tile, uint32_t signature) {
+  if (this->signaturesValid[tile]) {
+    const uint32_t previous = this->signatures[tile];
+    bool unchanged = true;
+    for (uint8_t i = 0; i < 32; i += 8) {
+      const int16_t diff =
+          (int16_t)((signature >> i) & 0xFF) - ((previous >> i) & 0xFF);
+      if (abs(diff) > this->dirtyThreshold) {
+        unchanged = false;
+        break;
+      }
+    }
+    if (unchanged) {
+      return true;
+    }
+  }
+  this->signatures[tile] = signature;
+  this->signaturesValid[tile] = true;
+  return false;
+}
+
+void JPEGRenderer::emitBlock(int16_t x, int16_t y, int16_t w, int16_t h,
+                             const uint16_t* pixels, int16_t stride) {
+  if (this->dualCore && (uint32_t)(w * h) <= RENDERER_BLOCK_PIXELS) {
+    this->queueBlock(x, y, w, h, pixels, stride);
+  } else {
+    if (this->dualCore) {
+      this->waitForQueue();
+    }
+    this->pushBlock(x, y, w, h, pixels, stride);
+  }
+}
+
+void JPEGRenderer::pushBlock(int16_t x, int16_t y, int16_t w, int16_t h,
+                             const uint16_t* pixels, int16_t stride) {
+  const uint32_t pixelCount = w * h;
+  this->tft->startWrite();
+  if (!this->dualCore && pixelCount <= RENDERER_BLOCK_PIXELS) {
+    // Copy into the buffer that is not being sent right now, pushImageDMA
+    // waits for the previous transfer before starting this one
+    uint16_t* buffer = (uint16_t*)this->dmaBuffers[this->dmaBufferIndex].data();
+    for (int16_t i = 0; i < h; i++) {
+      memcpy(buffer + i * w, pixels + i * stride, w * sizeof(uint16_t));
+    }
+    if (this->useDMA) {
+      this->tft->pushImageDMA(x, y, w, h, (const uint16_t*)buffer);
+      this->dmaBufferIndex ^= 1;
+    } else {
+      this->tft->setAddrWindow(x, y, w, h);
+      this->tft->pushPixels(buffer, pixelCount);
+    }
+    return;
+  }
+  // Only whole JPEGDEC blocks can be bigger than a buffer, so stride == w here
+  this->tft->dmaWait();
+  this->tft->setAddrWindow(x, y, w, h);
+  this->tft->pushPixels(pixels, pixelCount);
+  if (this->dualCore) {
+    this->tft->endWrite();
+  }
+}
+
+void JPEGRenderer::queueBlock(int16_t x, int16_t y, int16_t w, int16_t h,
+                              const uint16_t* pixels, int16_t stride) {
+  Block block;
+  block.pixels = this->pool.acquireBlocking();
+  uint16_t* dest = (uint16_t*)block.pixels.data();
+  for (int16_t i = 0; i < h; i++) {
+    memcpy(dest + i * w, pixels + i * stride, w * sizeof(uint16_t));
+  }
+  block.x = x;
+  block.y = y;
+  block.w = w;
+  block.h = h;
+
+  this->pendingBlocks.fetch_add(1, std::memory_order_relaxed);
+  while (!this->queue.push(std::move(block))) {
+    xTaskNotifyGive(this->task);
+    taskYIELD();
+  }
+  xTaskNotifyGive(this->task);
+}
+
+void JPEGRenderer::waitForQueue() {
+  while (this->pendingBlocks.load(std::memory_order_acquire) > 0) {
+    taskYIELD();
+  }
+}
+
+void JPEGRenderer::displayTask(void* param) {
+  JPEGRenderer* renderer = (JPEGRenderer*)param;
+  Block block;
+  BlockPool::Handle inFlight;
+
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    uint32_t pushed = 0;
+    while (renderer->queue.pop(block)) {
+      if (pushed == 0) {
+        renderer->tft->startWrite();
+      }
+      if (renderer->useDMA) {
+        // Waits for the previous transfer before queueing this one, after
+        // which the previous block can go back to the pool
+        renderer->tft->pushImageDMA(block.x, block.y, block.w, block.h,
+                                    (const uint16_t*)block.pixels.data());
+        inFlight = std::move(block.pixels);
+      } else {
+        renderer->tft->setAddrWindow(block.x, block.y, block.w, block.h);
+        renderer->tft->pushPixels(block.pixels.data(), block.w * block.h);
+        block.pixels.release();
+      }
+      pushed++;
+    }
+
+    if (pushed > 0) {
+      renderer->tft->endWrite();
+      inFlight.release();
+      renderer->pendingBlocks.fetch_sub(pushed, std::memory_order_release);
+    }
+  }
+}
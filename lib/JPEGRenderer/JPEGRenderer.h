@@ -0,0 +1,175 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FramePipeline.h>
+#include <JPEGDEC.h>
+#include <TFT_eSPI.h>
+
+// JPEGDEC never hands more pixels than this to a draw callback
+const uint32_t RENDERER_BLOCK_PIXELS = 4096;
+const size_t RENDERER_BLOCK_COUNT = 4;
+const size_t RENDERER_QUEUE_SIZE = 4;
+
+// Dirty block tracking works on 8x8 tiles over the whole (rotated) display
+const uint8_t RENDERER_TILE_SIZE = 8;
+const uint16_t RENDERER_MAX_WIDTH = 160;
+const uint16_t RENDERER_MAX_HEIGHT = 128;
+const uint16_t RENDERER_TILE_COLUMNS = RENDERER_MAX_WIDTH / RENDERER_TILE_SIZE;
+const uint16_t RENDERER_TILE_ROWS = RENDERER_MAX_HEIGHT / RENDERER_TILE_SIZE;
+const uint8_t RENDERER_DEFAULT_DIRTY_THRESHOLD = 3;
+
+// The histogram samples the mean luma of 8x8 blocks, thinning out the blocks
+// when collecting them takes longer than the budget (in microseconds)
+const uint8_t RENDERER_HISTOGRAM_BUCKETS = 32;
+const uint32_t RENDERER_HISTOGRAM_BUDGET = 300;
+const uint8_t RENDERER_HISTOGRAM_MAX_STEP = 8;
+
+// Focus peaking tints 8x8 blocks whose mean luma gradient is at least a
+// percentage of the sharpest block of the last frame. Fewer rows and columns
+// of each block are sampled while peaking takes more than a percentage of the
+// frame time.
+const uint8_t RENDERER_PEAKING_RELATIVE = 60;
+const uint8_t RENDERER_PEAKING_MIN_ENERGY = 4;
+const uint8_t RENDERER_PEAKING_MAX_PERCENT = 10;
+
+const uint32_t RENDERER_TASK_STACK_SIZE = 4096;
+const UBaseType_t RENDERER_TASK_PRIORITY = 1;
+const BaseType_t RENDERER_TASK_CORE = 0;
+
+// Pushes decoded JPEG blocks (big endian RGB565) to the display.
+//
+// In dual core mode the decoder only copies each block into a fixed pool and
+// queues it, a task on the other core drains the queue to the display. When
+// the pool is exhausted the decoder waits, so memory use never grows. In
+// single core mode blocks are pushed from the decoder itself, alternating
+// between two DMA buffers.
+//
+// With dirty tracking on, every 8x8 tile gets a signature made of its four
+// quadrant luma averages. Tiles whose quadrants all moved by no more than the
+// threshold since the last frame are not pushed at all.
+//
+// Blocks are clipped to the display, so a decode can be moved under it with
+// setOrigin() to show part of an image bigger than the display.
+//
+// Blocks decoded as EIGHT_BIT_GRAYSCALE are expanded to RGB565 through a 256
+// entry palette on the way, after which they take the same path.
+//
+// With the histogram on, the luma of every 8x8 block (approximated from four
+// of its pixels, about what the DC coefficient carries) is counted into
+// buckets while the frame passes through. Focus peaking measures the luma
+// gradients inside every block and tints the sharpest ones red before they
+// are pushed.
+class JPEGRenderer {
+  public:
+    bool begin(TFT_eSPI* tft, bool dualCore = true, bool useDMA = true);
+
+    void startFrame();
+    void finishFrame();
+    void releaseBus();
+
+    int draw(JPEGDRAW* pDraw);
+    void setOrigin(int16_t x, int16_t y);
+    bool isVisible(int32_t x, int32_t y, int32_t width, int32_t height);
+
+    void setDirtyTracking(bool enabled,
+                          uint8_t threshold = RENDERER_DEFAULT_DIRTY_THRESHOLD);
+    void invalidate();
+
+    bool isDualCore();
+    bool isUsingDMA();
+    bool isDirtyTracking();
+
+    void setHistogram(bool enabled);
+    bool isHistogramEnabled();
+    uint32_t getHistogram(uint16_t* buckets);
+    uint32_t getLastFrameHistogramTime();
+
+    void setFocusPeaking(bool enabled);
+    bool isFocusPeaking();
+    uint16_t getLastFramePeakingBlocks();
+    uint32_t getLastFramePeakingTime();
+
+    uint16_t getLastFrameTiles();
+    uint16_t getLastFrameSkippedTiles();
+    uint32_t getLastFrameSkippedBytes();
+
+  protected:
+    typedef FramePool<RENDERER_BLOCK_COUNT, RENDERER_BLOCK_PIXELS * 2>
+        BlockPool;
+
+    struct Block {
+        BlockPool::Handle pixels;
+        int16_t x;
+        int16_t y;
+        int16_t w;
+        int16_t h;
+    };
+
+    void drawRGB565(JPEGDRAW* pDraw);
+    void drawGrayscale(JPEGDRAW* pDraw);
+    void drawTiles(JPEGDRAW* pDraw);
+    void collectHistogram(JPEGDRAW* pDraw);
+    void applyFocusPeaking(JPEGDRAW* pDraw);
+    uint8_t getBlockEnergy(const uint16_t* pixels, int16_t stride);
+    uint32_t getTileSignature(const uint16_t* pixels, int16_t stride);
+    bool isTileUnchanged(uint16_t tile, uint32_t signature);
+
+    void emitBlock(int16_t x, int16_t y, int16_t w, int16_t h,
+                   const uint16_t* pixels, int16_t stride);
+    void pushBlock(int16_t x, int16_t y, int16_t w, int16_t h,
+                   const uint16_t* pixels, int16_t stride);
+    void queueBlock(int16_t x, int16_t y, int16_t w, int16_t h,
+                    const uint16_t* pixels, int16_t stride);
+    void waitForQueue();
+
+    static void displayTask(void* param);
+
+    bool began = false;
+    bool dualCore = false;
+    bool useDMA = false;
+
+    BlockPool pool;
+    SPSCRing<Block, RENDERER_QUEUE_SIZE> queue;
+    std::atomic<uint32_t> pendingBlocks{0};
+    TaskHandle_t task = NULL;
+
+    int16_t originX = 0;
+    int16_t originY = 0;
+
+    BlockPool::Handle dmaBuffers[2];
+    uint8_t dmaBufferIndex = 0;
+
+    // Big endian RGB565 for every 8 bit luma value
+    uint16_t grayPalette[256];
+
+    bool dirtyTracking = false;
+    uint8_t dirtyThreshold = RENDERER_DEFAULT_DIRTY_THRESHOLD;
+    bool signaturesValid[RENDERER_TILE_COLUMNS * RENDERER_TILE_ROWS];
+    uint32_t signatures[RENDERER_TILE_COLUMNS * RENDERER_TILE_ROWS];
+
+    bool histogram = false;
+    uint8_t histogramStep = 1;
+    uint16_t frameHistogram[RENDERER_HISTOGRAM_BUCKETS];
+    uint16_t lastHistogram[RENDERER_HISTOGRAM_BUCKETS];
+    uint32_t frameHistogramSamples = 0;
+    uint32_t lastHistogramSamples = 0;
+    uint32_t frameHistogramTime = 0;
+    uint32_t lastFrameHistogramTime = 0;
+
+    bool focusPeaking = false;
+    uint8_t peakingStep = 1;
+    uint8_t peakingThreshold = 0xFF;
+    uint8_t framePeakingMax = 0;
+    uint16_t framePeakingBlocks = 0;
+    uint16_t lastFramePeakingBlocks = 0;
+    uint32_t framePeakingTime = 0;
+    uint32_t lastFramePeakingTime = 0;
+    uint32_t frameStartTime = 0;
+
+    uint16_t frameTiles = 0;
+    uint16_t frameSkippedTiles = 0;
+    uint16_t lastFrameTiles = 0;
+    uint16_t lastFrameSkippedTiles = 0;
+
+    TFT_eSPI* tft;
+};
@@ -0,0 +1,672 @@
+#include <Arduino.h>
+#include "ParallelJPEG.h"
+
+#include <new>
+
+ParallelJPEG* ParallelJPEG::instance = NULL;
+
+bool ParallelJPEG::begin(SdFs* sd, JPEGRenderer* renderer) {
+  if (this->began) {
+    return true;
+  }
+
+  this->sd = sd;
+  this->renderer = renderer;
+  ParallelJPEG::instance = this;
+
+  this->secondary = new (std::nothrow) JPEGDEC;
+  this->fileMutex = xSemaphoreCreateMutex();
+  this->drawMutex = xSemaphoreCreateMutex();
+  if (this->secondary == NULL || this->fileMutex == NULL ||
+      this->drawMutex == NULL) {
+    Serial.println("Not enough memory for parallel JPEG decoding");
+    return false;
+  }
+
+  Serial.print("Starting parallel JPEG decode task...");
+  if (xTaskCreatePinnedToCore(ParallelJPEG::decodeTask, "ParallelJPEG",
+                              PARALLEL_JPEG_TASK_STACK_SIZE, this,
+                              PARALLEL_JPEG_TASK_PRIORITY, &this->task,
+                              PARALLEL_JPEG_TASK_CORE) != pdPASS) {
+    Serial.println("error!");
+    this->task = NULL;
+    return false;
+  }
+  Serial.println("ok!");
+
+  this->began = true;
+  return true;
+}
+
+// Returns 1 like JPEGDEC::decode when both halves decoded, when the file
+// could not be split it has to be decoded normally
+int ParallelJPEG::decode(JPEGDEC* primary, const char* path, int16_t x,
+                         int16_t y, int options) {
+  return this->decodeRows(primary, path, x, y, 0, 0xFFFF, options, true, NULL,
+                          NULL);
+}
+
+// Decodes the MCU rows covering the image rows top to top + height (at full
+// scale), drawn where they would be if the whole image was decoded at x, y.
+// Returns PARALLEL_JPEG_NOT_SPLIT only for files that are not baseline.
+int ParallelJPEG::decodeRegion(JPEGDEC* primary, const char* path, int16_t x,
+                               int16_t y, uint16_t top, uint16_t height,
+                               int options,
+                               ParallelJPEGAbortCallback shouldAbort,
+                               void* abortParam) {
+  return this->decodeRows(primary, path, x, y, top, height, options, false,
+                          shouldAbort, abortParam);
+}
+
+int ParallelJPEG::decodeRows(JPEGDEC* primary, const char* path, int16_t x,
+                             int16_t y, uint16_t top, uint16_t height,
+                             int options, bool requireSplit,
+                             ParallelJPEGAbortCallback shouldAbort,
+                             void* abortParam) {
+  if (!this->began || (requireSplit && !this->renderer->isDualCore())) {
+    return PARALLEL_JPEG_NOT_SPLIT;
+  }
+
+  const uint32_t startScanTime = micros();
+
+  Slice* first = &this->slices[0];
+  Slice* second = &this->slices[1];
+
+  this->renderer->releaseBus();
+  first->file = this->sd->open(path, O_RDONLY);
+  if (!first->file) {
+    return PARALLEL_JPEG_NOT_SPLIT;
+  }
+
+  FrameInfo info;
+  if (!this->readFrameInfo(&first->file, &info)) {
+    first->file.close();
+    return PARALLEL_JPEG_NOT_SPLIT;
+  }
+
+  const uint16_t mcuRows = (info.height + info.mcuHeight - 1) / info.mcuHeight;
+  const uint16_t firstRow =
+      min((uint16_t)(top / info.mcuHeight), (uint16_t)(mcuRows - 1));
+  const uint16_t endRow =
+      max((uint32_t)firstRow + 1,
+          min(((uint32_t)top + height + info.mcuHeight - 1) / info.mcuHeight,
+              (uint32_t)mcuRows));
+
+  const bool indexed = this->loadRowIndex(&first->file, path, &info);
+
+  // The band is widened to whole index entries, and split on the entry
+  // closest to its middle
+  uint16_t startEntry = 0;
+  uint16_t endEntry = 0;
+  if (indexed) {
+    startEntry = firstRow / this->indexRowStep;
+    endEntry = min((uint16_t)((endRow + this->indexRowStep - 1) /
+                              this->indexRowStep),
+                   this->indexRows);
+  }
+  const bool split =
+      indexed && this->renderer->isDualCore() && endEntry - startEntry >= 2;
+  if (requireSplit && !split) {
+    first->file.close();
+    return PARALLEL_JPEG_NOT_SPLIT;
+  }
+  if (split) {
+    second->file = this->sd->open(path, O_RDONLY);
+    if (!second->file) {
+      first->file.close();
+      return PARALLEL_JPEG_NOT_SPLIT;
+    }
+  }
+
+  uint8_t scaleShift = 0;
+  if (options & JPEG_SCALE_EIGHTH) {
+    scaleShift = 3;
+  } else if (options & JPEG_SCALE_QUARTER) {
+    scaleShift = 2;
+  } else if (options & JPEG_SCALE_HALF) {
+    scaleShift = 1;
+  }
+
+  // Without restart markers every band is decoded from the top of the file,
+  // so a band that was already decoded is drawn from the card instead
+  if (!indexed) {
+    const uint32_t fileSize = first->file.size();
+    if (this->bandValid && this->bandFileSize == fileSize &&
+        this->bandX == x && this->bandY == y && this->bandTop == top &&
+        this->bandHeight == height && this->bandOptions == options &&
+        strcmp(this->bandPath, path) == 0) {
+      first->file.close();
+      this->shouldAbort = shouldAbort;
+      this->abortParam = abortParam;
+      this->aborted = false;
+      const int result = this->drawBand();
+      this->shouldAbort = NULL;
+      if (result != PARALLEL_JPEG_NOT_SPLIT) {
+        return result;
+      }
+      first->file = this->sd->open(path, O_RDONLY);
+      if (!first->file) {
+        return PARALLEL_JPEG_NOT_SPLIT;
+      }
+    }
+    this->startBand(path, fileSize, x, y, top, height, options, scaleShift);
+  }
+
+  const uint8_t sliceCount = split ? 2 : 1;
+  const uint16_t entries[3] = {startEntry,
+                               (uint16_t)((startEntry + endEntry) / 2),
+                               endEntry};
+  for (uint8_t i = 0; i < sliceCount; i++) {
+    Slice* slice = &this->slices[i];
+    slice->owner = this;
+    slice->decoder = i == 0 ? primary : this->secondary;
+    slice->headerSize = info.headerSize - info.appSize;
+    slice->headerSkip = info.appSize;
+    slice->heightOffset = info.heightOffset - info.appSize;
+    slice->position = 0;
+    slice->previousFF = false;
+    slice->x = x;
+    slice->options = options;
+    slice->result = 0;
+
+    uint16_t sliceStartRow = 0;
+    uint16_t sliceEndRow = endRow;
+    slice->dataStart = info.headerSize;
+    slice->dataEnd = slice->file.size();
+    slice->appendEOI = false;
+    slice->restartShift = 0;
+    if (indexed) {
+      const uint16_t entryStart = split ? entries[i] : startEntry;
+      const uint16_t entryEnd = split ? entries[i + 1] : endEntry;
+      sliceStartRow = entryStart * this->indexRowStep;
+      sliceEndRow = min((uint16_t)(entryEnd * this->indexRowStep), mcuRows);
+      slice->dataStart = this->rowOffsets[entryStart];
+      // Slices ending before the last entry stop at its restart marker
+      if (entryEnd < this->indexRows) {
+        slice->dataEnd = this->rowOffsets[entryEnd] - 2;
+        slice->appendEOI = true;
+      }
+      // The first marker in the slice has to read as RST0
+      slice->restartShift = (entryStart * this->indexIntervalStep) & 7;
+    }
+
+    const uint16_t startPixelRow = sliceStartRow * info.mcuHeight;
+    slice->height =
+        min((uint32_t)sliceEndRow * info.mcuHeight, (uint32_t)info.height) -
+        startPixelRow;
+    slice->y = y + (startPixelRow >> scaleShift);
+    slice->size = slice->headerSize + slice->dataEnd - slice->dataStart +
+                  (slice->appendEOI ? 2 : 0);
+  }
+
+  this->shouldAbort = shouldAbort;
+  this->abortParam = abortParam;
+  this->aborted = false;
+
+  this->lastScanTime = micros() - startScanTime;
+  const uint32_t startDecodeTime = micros();
+
+  if (split) {
+    this->caller = xTaskGetCurrentTaskHandle();
+    xTaskNotifyGive(this->task);
+    this->decodeSlice(first);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  } else {
+    this->decodeSlice(first);
+  }
+
+  this->lastDecodeTime = micros() - startDecodeTime;
+
+  first->file.close();
+  if (split) {
+    second->file.close();
+  }
+  if (this->bandFile) {
+    // Closed even when writing stopped early, the band is only kept if every
+    // block made it to the card
+    const bool closed = this->bandFile.close();
+    this->bandValid = this->bandWriting && closed && first->result == 1 &&
+                      !this->aborted;
+    this->bandWriting = false;
+  }
+
+  this->shouldAbort = NULL;
+  if (this->aborted) {
+    Serial.printf("Stopped decode after %lu us\n", this->lastDecodeTime);
+    return PARALLEL_JPEG_ABORTED;
+  }
+  if (split) {
+    Serial.printf("Parallel decode of %u rows split at row %u: scan %lu us, "
+                  "decode %lu us\n",
+                  first->height + second->height,
+                  (second->y - y) << scaleShift, this->lastScanTime,
+                  this->lastDecodeTime);
+    return first->result == 1 && second->result == 1 ? 1 : 0;
+  }
+  Serial.printf("Decode of %u rows from row %u: scan %lu us, decode %lu us\n",
+                first->height, (first->y - y) << scaleShift,
+                this->lastScanTime, this->lastDecodeTime);
+  return first->result;
+}
+
+uint32_t ParallelJPEG::getLastScanTime() { return this->lastScanTime; }
+
+uint32_t ParallelJPEG::getLastDecodeTime() { return this->lastDecodeTime; }
+
+// Walks the marker segments up to the start of scan, only baseline and
+// extended sequential frames are accepted. restartInterval is 0 when the file
+// has no restart markers.
+bool ParallelJPEG::readFrameInfo(FsFile* file, FrameInfo* info) {
+  uint8_t* buf = this->scanBuffer;
+  memset(info, 0, sizeof(FrameInfo));
+
+  if (!file->seek(0) || file->read(buf, 2) != 2 || buf[0] != 0xFF ||
+      buf[1] != 0xD8) {
+    return false;
+  }
+
+  int32_t position = 2;
+  bool leadingSegments = true;
+  while (true) {
+    if (!file->seek(position) || file->read(buf, 4) != 4 || buf[0] != 0xFF) {
+      return false;
+    }
+    const uint8_t marker = buf[1];
+    if (marker == 0xFF) {
+      position++;
+      continue;
+    }
+    const uint16_t length = (buf[2] << 8) | buf[3];
+    // Slices do not need the EXIF segment and its thumbnail
+    if (leadingSegments && marker >= 0xE0 && marker <= 0xEF) {
+      info->appSize = position + length;
+    } else {
+      leadingSegments = false;
+    }
+
+    if (marker == 0xC0 || marker == 0xC1) {
+      if (length < 8 || length > PARALLEL_JPEG_SCAN_BUFFER_SIZE ||
+          file->read(buf, length - 2) != length - 2) {
+        return false;
+      }
+      info->heightOffset = position + 5;
+      info->height = (buf[1] << 8) | buf[2];
+      info->width = (buf[3] << 8) | buf[4];
+      const uint8_t components = buf[5];
+      uint8_t maxH = 1;
+      uint8_t maxV = 1;
+      // Single component scans are not interleaved, so their MCU is one block
+      if (components > 1) {
+        for (uint8_t i = 0; i < components && 8 + i * 3 < length - 2; i++) {
+          const uint8_t sampling = buf[7 + i * 3];
+          maxH = max(maxH, (uint8_t)(sampling >> 4));
+          maxV = max(maxV, (uint8_t)(sampling & 0x0F));
+        }
+      }
+      info->mcuWidth = maxH * 8;
+      info->mcuHeight = maxV * 8;
+    } else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 &&
+               marker != 0xC8 && marker != 0xCC) {
+      return false;
+    } else if (marker == 0xDD) {
+      if (file->read(buf, 2) != 2) {
+        return false;
+      }
+      info->restartInterval = (buf[0] << 8) | buf[1];
+    } else if (marker == 0xDA) {
+      info->headerSize = position + 2 + length;
+      return info->heightOffset > 0 && info->width > 0 && info->height > 0;
+    }
+    position += 2 + length;
+  }
+}
+
+// Finds where each restart aligned MCU row starts in the entropy coded data,
+// unless the index already belongs to this file. Returns false when the file
+// has no restart markers on row boundaries. Stuffed 0xFF00 bytes and fill
+// bytes can never be mistaken for a marker.
+bool ParallelJPEG::loadRowIndex(FsFile* file, const char* path,
+                                const FrameInfo* info) {
+  if (info->restartInterval == 0) {
+    return false;
+  }
+
+  const uint16_t mcuColumns =
+      (info->width + info->mcuWidth - 1) / info->mcuWidth;
+  const uint16_t mcuRows =
+      (info->height + info->mcuHeight - 1) / info->mcuHeight;
+  uint16_t rowStep = 0;
+  uint32_t intervalStep = 0;
+  if (info->restartInterval % mcuColumns == 0) {
+    rowStep = info->restartInterval / mcuColumns;
+    intervalStep = 1;
+  } else if (mcuColumns % info->restartInterval == 0) {
+    rowStep = 1;
+    intervalStep = mcuColumns / info->restartInterval;
+  } else {
+    return false;
+  }
+  while ((mcuRows + rowStep - 1) / rowStep > PARALLEL_JPEG_MAX_INDEX_ROWS) {
+    rowStep *= 2;
+    intervalStep *= 2;
+  }
+  const uint16_t rows = (mcuRows + rowStep - 1) / rowStep;
+
+  const uint32_t fileSize = file->size();
+  if (this->indexRows == rows && this->indexRowStep == rowStep &&
+      this->indexFileSize == fileSize && strcmp(this->indexPath, path) == 0) {
+    return true;
+  }
+
+  const uint32_t startIndexTime = micros();
+  this->indexRows = 0;
+  this->rowOffsets[0] = info->headerSize;
+  if (!file->seek(info->headerSize)) {
+    return false;
+  }
+  uint16_t entry = 1;
+  uint32_t found = 0;
+  bool previousFF = false;
+  int32_t position = info->headerSize;
+  while (entry < rows) {
+    const int32_t read =
+        file->read(this->scanBuffer, PARALLEL_JPEG_SCAN_BUFFER_SIZE);
+    if (read <= 0) {
+      return false;
+    }
+    for (int32_t i = 0; i < read && entry < rows; i++) {
+      const uint8_t value = this->scanBuffer[i];
+      if (previousFF) {
+        if (value >= 0xD0 && value <= 0xD7) {
+          found++;
+          if (found % intervalStep == 0) {
+            this->rowOffsets[entry] = position + i + 1;
+            entry++;
+          }
+        } else if (value == 0xD9) {
+          return false;
+        }
+      }
+      previousFF = value == 0xFF;
+    }
+    position += read;
+  }
+
+  // Paths too long to remember are indexed again every time
+  if (strlen(path) < PARALLEL_JPEG_MAX_PATH_SIZE) {
+    strcpy(this->indexPath, path);
+  } else {
+    this->indexPath[0] = '\0';
+  }
+  this->indexFileSize = fileSize;
+  this->indexRows = rows;
+  this->indexRowStep = rowStep;
+  this->indexIntervalStep = intervalStep;
+
+  Serial.printf("Indexed %u rows of %s in %lu us\n", rows, path,
+                micros() - startIndexTime);
+  return true;
+}
+
+void ParallelJPEG::decodeSlice(Slice* slice) {
+  slice->result = 0;
+  if (slice->decoder->open(slice, slice->size, ParallelJPEG::closeSlice,
+                           ParallelJPEG::readSlice, ParallelJPEG::seekSlice,
+                           ParallelJPEG::drawSlice)) {
+    slice->decoder->setPixelType(RGB565_BIG_ENDIAN);
+    slice->result = slice->decoder->decode(slice->x, slice->y, slice->options);
+    slice->decoder->close();
+  }
+}
+
+int32_t ParallelJPEG::readSlice(JPEGFILE* handle, uint8_t* buffer,
+                                int32_t length) {
+  Slice* slice = (Slice*)handle->fHandle;
+  const int32_t dataSize = slice->dataEnd - slice->dataStart;
+  int32_t total = 0;
+
+  slice->owner->renderer->releaseBus();
+  xSemaphoreTake(slice->owner->fileMutex, portMAX_DELAY);
+  while (length > 0 && slice->position < slice->size) {
+    uint8_t* dest = buffer + total;
+    int32_t read = 0;
+    if (slice->position < slice->headerSize) {
+      // Everything after the SOI comes from past the skipped segments
+      const int32_t skip = slice->position < 2 ? 0 : slice->headerSkip;
+      const int32_t end = slice->position < 2 ? 2 : slice->headerSize;
+      const int32_t chunk = min(length, end - slice->position);
+      if (!slice->file.seek(slice->position + skip)) {
+        break;
+      }
+      read = slice->file.read(dest, chunk);
+      for (int32_t i = 0; i < read; i++) {
+        const int32_t offset = slice->position + i;
+        if (offset == slice->heightOffset) {
+          dest[i] = slice->height >> 8;
+        } else if (offset == slice->heightOffset + 1) {
+          dest[i] = slice->height & 0xFF;
+        }
+      }
+    } else if (slice->position < slice->headerSize + dataSize) {
+      const int32_t dataPosition = slice->position - slice->headerSize;
+      const int32_t chunk = min(length, dataSize - dataPosition);
+      if (!slice->file.seek(slice->dataStart + dataPosition)) {
+        break;
+      }
+      read = slice->file.read(dest, chunk);
+      for (int32_t i = 0; i < read; i++) {
+        if (slice->previousFF && dest[i] >= 0xD0 && dest[i] <= 0xD7) {
+          dest[i] = 0xD0 | ((dest[i] - slice->restartShift) & 0x07);
+        }
+        slice->previousFF = dest[i] == 0xFF;
+      }
+    } else {
+      const uint8_t eoi[2] = {0xFF, 0xD9};
+      const int32_t eoiPosition = slice->position - slice->headerSize - dataSize;
+      read = min(length, 2 - eoiPosition);
+      memcpy(dest, eoi + eoiPosition, read);
+    }
+    if (read <= 0) {
+      break;
+    }
+    slice->position += read;
+    total += read;
+    length -= read;
+  }
+  xSemaphoreGive(slice->owner->fileMutex);
+
+  return total;
+}
+
+int32_t ParallelJPEG::seekSlice(JPEGFILE* handle, int32_t position) {
+  Slice* slice = (Slice*)handle->fHandle;
+  if (position < 0 || position > slice->size) {
+    return 0;
+  }
+  slice->position = position;
+  slice->previousFF = false;
+  return 1;
+}
+
+// The files are closed by decodeRows() once all slices are done
+void ParallelJPEG::closeSlice(void* handle) {}
+
+int ParallelJPEG::drawSlice(JPEGDRAW* pDraw) {
+  ParallelJPEG* self = ParallelJPEG::instance;
+  xSemaphoreTake(self->drawMutex, portMAX_DELAY);
+  if (!self->aborted && self->shouldAbort != NULL &&
+      self->shouldAbort(self->abortParam)) {
+    self->aborted = true;
+  }
+  if (!self->aborted && self->bandWriting) {
+    self->writeBandBlock(pDraw);
+  }
+  const int result = self->aborted ? 0 : self->renderer->draw(pDraw);
+  xSemaphoreGive(self->drawMutex);
+  return result;
+}
+
+// Empties the band cache and keeps what it is for, returns false when the
+// band can not be cached
+bool ParallelJPEG::startBand(const char* path, uint32_t fileSize, int16_t x,
+                             int16_t y, uint16_t top, uint16_t height,
+                             int options, uint8_t scaleShift) {
+  this->bandValid = false;
+  this->bandWriting = false;
+  if (strlen(path) >= PARALLEL_JPEG_MAX_PATH_SIZE) {
+    return false;
+  }
+
+  if (!this->sd->exists(PARALLEL_JPEG_BAND_CACHE_DIRECTORY)) {
+    this->sd->mkdir(PARALLEL_JPEG_BAND_CACHE_DIRECTORY);
+  }
+  this->bandFile = this->sd->open(PARALLEL_JPEG_BAND_CACHE_PATH,
+                                  O_RDWR | O_CREAT | O_TRUNC);
+  if (!this->bandFile) {
+    Serial.printf("Failed to open band cache %s\n",
+                  PARALLEL_JPEG_BAND_CACHE_PATH);
+    return false;
+  }
+
+  strcpy(this->bandPath, path);
+  this->bandFileSize = fileSize;
+  this->bandX = x;
+  this->bandY = y;
+  this->bandTop = top;
+  this->bandHeight = height;
+  this->bandOptions = options;
+  const uint32_t scale = 1 << scaleShift;
+  this->bandFirstRow = y + (top >> scaleShift);
+  this->bandEndRow = y + (((uint32_t)top + height + scale - 1) >> scaleShift);
+  this->bandBlockCount = 0;
+  this->bandWriting = true;
+  return true;
+}
+
+// Appends the rows of a block that are in the band, before the renderer packs
+// them for the display. Anything that does not fit stops the band from being
+// cached.
+void ParallelJPEG::writeBandBlock(JPEGDRAW* pDraw) {
+  const int32_t firstRow = max((int32_t)pDraw->y, this->bandFirstRow);
+  const int32_t endRow =
+      min((int32_t)(pDraw->y + pDraw->iHeight), this->bandEndRow);
+  if (firstRow >= endRow) {
+    return;
+  }
+  if (pDraw->iBpp != 16 ||
+      this->bandBlockCount == PARALLEL_JPEG_MAX_BAND_BLOCKS) {
+    this->bandWriting = false;
+    return;
+  }
+
+  const uint8_t* pixels =
+      (const uint8_t*)(pDraw->pPixels + (firstRow - pDraw->y) * pDraw->iWidth);
+  const size_t bytes = (endRow - firstRow) * pDraw->iWidth * sizeof(uint16_t);
+  this->renderer->releaseBus();
+  xSemaphoreTake(this->fileMutex, portMAX_DELAY);
+  const bool written = this->bandFile.write(pixels, bytes) == bytes;
+  xSemaphoreGive(this->fileMutex);
+  if (!written) {
+    this->bandWriting = false;
+    return;
+  }
+
+  BandBlock* block = &this->bandBlocks[this->bandBlockCount++];
+  block->x = pDraw->x;
+  block->y = firstRow;
+  block->width = pDraw->iWidth;
+  block->height = endRow - firstRow;
+}
+
+// Draws the parts of the cached band that are on the display, a few whole
+// rows of a block at a time or pieces of a row for blocks wider than the
+// buffer. Returns PARALLEL_JPEG_NOT_SPLIT, with nothing drawn, when the cache
+// can not be opened and the band has to be decoded after all.
+int ParallelJPEG::drawBand() {
+  const uint32_t startDrawTime = micros();
+  this->renderer->releaseBus();
+  this->bandFile = this->sd->open(PARALLEL_JPEG_BAND_CACHE_PATH, O_RDONLY);
+  if (!this->bandFile) {
+    this->bandValid = false;
+    return PARALLEL_JPEG_NOT_SPLIT;
+  }
+
+  JPEGDRAW draw;
+  memset(&draw, 0, sizeof(draw));
+  draw.iBpp = 16;
+  draw.pPixels = (uint16_t*)this->scanBuffer;
+  uint32_t offset = 0;
+  uint16_t blocksDrawn = 0;
+  int result = 1;
+  for (uint16_t i = 0; i < this->bandBlockCount && result == 1; i++) {
+    const BandBlock* block = &this->bandBlocks[i];
+    const uint32_t rowBytes = block->width * sizeof(uint16_t);
+    if (this->renderer->isVisible(block->x, block->y, block->width,
+                                  block->height)) {
+      const bool wholeRows = rowBytes <= PARALLEL_JPEG_SCAN_BUFFER_SIZE;
+      const uint16_t columnsPerRead =
+          wholeRows ? block->width
+                    : PARALLEL_JPEG_SCAN_BUFFER_SIZE / sizeof(uint16_t);
+      const uint16_t rowsPerRead =
+          wholeRows ? PARALLEL_JPEG_SCAN_BUFFER_SIZE / rowBytes : 1;
+      for (uint16_t row = 0; row < block->height && result == 1;
+           row += rowsPerRead) {
+        const uint16_t rows = min(rowsPerRead, (uint16_t)(block->height - row));
+        for (uint16_t column = 0; column < block->width;
+             column += columnsPerRead) {
+          const uint16_t columns =
+              min(columnsPerRead, (uint16_t)(block->width - column));
+          if (!this->renderer->isVisible(block->x + column, block->y + row,
+                                         columns, rows)) {
+            continue;
+          }
+          const int32_t bytes = rows * columns * sizeof(uint16_t);
+          this->renderer->releaseBus();
+          if (!this->bandFile.seek(offset + row * rowBytes +
+                                   column * sizeof(uint16_t)) ||
+              this->bandFile.read(this->scanBuffer, bytes) != bytes) {
+            result = 0;
+            break;
+          }
+          if (this->shouldAbort != NULL &&
+              this->shouldAbort(this->abortParam)) {
+            this->aborted = true;
+            result = 0;
+            break;
+          }
+          draw.x = block->x + column;
+          draw.y = block->y + row;
+          draw.iWidth = columns;
+          draw.iHeight = rows;
+          this->renderer->draw(&draw);
+        }
+      }
+      blocksDrawn++;
+    }
+    offset += block->height * rowBytes;
+  }
+  this->bandFile.close();
+
+  this->lastScanTime = 0;
+  this->lastDecodeTime = micros() - startDrawTime;
+  if (this->aborted) {
+    Serial.printf("Stopped decode after %lu us\n", this->lastDecodeTime);
+    return PARALLEL_JPEG_ABORTED;
+  }
+  if (result != 1) {
+    this->bandValid = false;
+    return result;
+  }
+  Serial.printf("Drew %u of %u cached band blocks in %lu us\n", blocksDrawn,
+                this->bandBlockCount, this->lastDecodeTime);
+  return 1;
+}
+
+void ParallelJPEG::decodeTask(void* param) {
+  ParallelJPEG* self = (ParallelJPEG*)param;
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    self->decodeSlice(&self->slices[1]);
+    xTaskNotifyGive(self->caller);
+  }
+}
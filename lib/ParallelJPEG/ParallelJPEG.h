@@ -0,0 +1,187 @@
+#pragma once
+
+#include <Arduino.h>
+#include <JPEGDEC.h>
+#include <JPEGRenderer.h>
+#include <SdFat.h>
+
+const uint32_t PARALLEL_JPEG_TASK_STACK_SIZE = 8192;
+const UBaseType_t PARALLEL_JPEG_TASK_PRIORITY = 1;
+const BaseType_t PARALLEL_JPEG_TASK_CORE = 0;
+
+const size_t PARALLEL_JPEG_SCAN_BUFFER_SIZE = 2048;
+
+// The row index of the last file holds the entropy data offset of at most this
+// many restart aligned MCU rows, taller images get an entry every few rows
+const uint16_t PARALLEL_JPEG_MAX_INDEX_ROWS = 256;
+const size_t PARALLEL_JPEG_MAX_PATH_SIZE = 256;
+
+// The last band decoded from a file without restart markers is kept here, as
+// at most this many blocks the way the decoder drew them
+#define PARALLEL_JPEG_BAND_CACHE_DIRECTORY "/cache/"
+#define PARALLEL_JPEG_BAND_CACHE_PATH "/cache/band.raw"
+const uint16_t PARALLEL_JPEG_MAX_BAND_BLOCKS = 256;
+
+// Returned by decode() when the file can not be split, nothing has been drawn
+// and the primary decoder was not touched
+const int PARALLEL_JPEG_NOT_SPLIT = -1;
+// Returned by decodeRegion() when it was stopped by its abort callback
+const int PARALLEL_JPEG_ABORTED = -2;
+
+// Called before every draw, returning true stops both decoders
+typedef bool (*ParallelJPEGAbortCallback)(void* param);
+
+// Decodes baseline JPEGs with restart markers on MCU row boundaries in two
+// halves at once, the top half on the calling task and the bottom half on a
+// task pinned to the other core.
+//
+// The entropy coded data is scanned up to the restart marker closest to the
+// middle row. Each decoder then reads a virtual file made of the original
+// headers, with the frame height patched to its half, followed by its half of
+// the data. The bottom half has its restart markers renumbered so it reads
+// like a standalone image.
+//
+// Both decoders share the SD card and the renderer, so reads and draws are
+// serialized with mutexes. Only works with the renderer in dual core mode,
+// where the display bus belongs to the display task alone.
+//
+// decodeRegion() decodes only the MCU rows covering a band of the image. The
+// restart markers of the last file are indexed on first use, so the band
+// starts at the closest indexed row instead of the top of the file. Files
+// without restart markers are decoded from the top, with the frame height cut
+// off at the bottom of the band. The rows of the last such band are also
+// written to the SD card, so panning sideways within it only reads back the
+// blocks that end up on the display. It can be given a callback to stop it
+// early, for decodes that refine something already on screen.
+class ParallelJPEG {
+  public:
+    bool begin(SdFs* sd, JPEGRenderer* renderer);
+
+    int decode(JPEGDEC* primary, const char* path, int16_t x, int16_t y,
+               int options);
+    int decodeRegion(JPEGDEC* primary, const char* path, int16_t x, int16_t y,
+                     uint16_t top, uint16_t height, int options,
+                     ParallelJPEGAbortCallback shouldAbort = NULL,
+                     void* abortParam = NULL);
+
+    uint32_t getLastScanTime();
+    uint32_t getLastDecodeTime();
+
+  protected:
+    struct Slice {
+        ParallelJPEG* owner;
+        FsFile file;
+        JPEGDEC* decoder;
+
+        // The virtual file is headerSize bytes of the original headers, the
+        // data between dataStart and dataEnd and optionally an EOI marker.
+        // The APPn segments after the SOI, headerSkip bytes, are left out.
+        int32_t headerSize;
+        int32_t headerSkip;
+        int32_t heightOffset;
+        uint16_t height;
+        int32_t dataStart;
+        int32_t dataEnd;
+        bool appendEOI;
+        uint8_t restartShift;
+
+        int32_t size;
+        int32_t position;
+        bool previousFF;
+
+        int16_t x;
+        int16_t y;
+        int options;
+        int result;
+    };
+
+    struct FrameInfo {
+        uint16_t width;
+        uint16_t height;
+        int32_t heightOffset;
+        uint8_t mcuWidth;
+        uint8_t mcuHeight;
+        uint16_t restartInterval;
+        int32_t headerSize;
+        int32_t appSize;
+    };
+
+    struct BandBlock {
+        int16_t x;
+        int16_t y;
+        uint16_t width;
+        uint16_t height;
+    };
+
+    int decodeRows(JPEGDEC* primary, const char* path, int16_t x, int16_t y,
+                   uint16_t top, uint16_t height, int options,
+                   bool requireSplit, ParallelJPEGAbortCallback shouldAbort,
+                   void* abortParam);
+    bool readFrameInfo(FsFile* file, FrameInfo* info);
+    bool loadRowIndex(FsFile* file, const char* path, const FrameInfo* info);
+    void decodeSlice(Slice* slice);
+    bool startBand(const char* path, uint32_t fileSize, int16_t x, int16_t y,
+                   uint16_t top, uint16_t height, int options,
+                   uint8_t scaleShift);
+    void writeBandBlock(JPEGDRAW* pDraw);
+    int drawBand();
+
+    static int32_t readSlice(JPEGFILE* handle, uint8_t* buffer,
+                             int32_t length);
+    static int32_t seekSlice(JPEGFILE* handle, int32_t position);
+    static void closeSlice(void* handle);
+    static int drawSlice(JPEGDRAW* pDraw);
+    static void decodeTask(void* param);
+
+    static ParallelJPEG* instance;
+
+    bool began = false;
+
+    SdFs* sd;
+    JPEGRenderer* renderer;
+    JPEGDEC* secondary = NULL;
+
+    Slice slices[2];
+    // Also holds rows of the cached band on their way to the renderer
+    alignas(uint16_t) uint8_t scanBuffer[PARALLEL_JPEG_SCAN_BUFFER_SIZE];
+
+    // Entry i is where the entropy data of MCU row i * indexRowStep starts,
+    // right after the restart marker ending the interval before it
+    char indexPath[PARALLEL_JPEG_MAX_PATH_SIZE] = "";
+    uint32_t indexFileSize = 0;
+    int32_t rowOffsets[PARALLEL_JPEG_MAX_INDEX_ROWS];
+    uint16_t indexRows = 0;
+    uint16_t indexRowStep = 0;
+    uint32_t indexIntervalStep = 0;
+
+    // Which band of which file the cache holds, and the blocks in the order
+    // they are stored. Only rows between bandFirstRow and bandEndRow (in
+    // output coordinates) are kept.
+    FsFile bandFile;
+    char bandPath[PARALLEL_JPEG_MAX_PATH_SIZE] = "";
+    uint32_t bandFileSize = 0;
+    int16_t bandX = 0;
+    int16_t bandY = 0;
+    uint16_t bandTop = 0;
+    uint16_t bandHeight = 0;
+    int bandOptions = 0;
+    int32_t bandFirstRow = 0;
+    int32_t bandEndRow = 0;
+    BandBlock bandBlocks[PARALLEL_JPEG_MAX_BAND_BLOCKS];
+    uint16_t bandBlockCount = 0;
+    bool bandValid = false;
+    bool bandWriting = false;
+
+    // Only touched with drawMutex held
+    ParallelJPEGAbortCallback shouldAbort = NULL;
+    void* abortParam = NULL;
+    bool aborted = false;
+
+    SemaphoreHandle_t fileMutex = NULL;
+    SemaphoreHandle_t drawMutex = NULL;
+    TaskHandle_t task = NULL;
+    TaskHandle_t caller = NULL;
+
+    uint32_t lastScanTime = 0;
+    uint32_t lastDecodeTime = 0;
+};
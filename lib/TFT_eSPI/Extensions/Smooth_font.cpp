@@ -245,6 +245,39 @@ void TFT_eSPI::loadMetrics(void)
   gFont.yAdvance = gFont.maxAscent + gFont.maxDescent;
 
   gFont.spaceWidth = (gFont.ascent + gFont.descent) * 2/7;  // Guess at space width
+
+  sortMetrics();
+}
+
+
+/***************************************************************************************
+** Function name:           sortMetrics
+** Description:             Build an index of the glyphs sorted by Unicode code point
+*************************************************************************************x*/
+// Fonts made by the Processing sketch are already in code point order, so the
+// insertion sort is a single pass in the usual case
+void TFT_eSPI::sortMetrics(void)
+{
+#if defined (ESP32) && defined (CONFIG_SPIRAM_SUPPORT)
+  if ( psramFound() ) gSorted = (uint16_t*)ps_malloc( gFont.gCount * 2);
+  else
+#endif
+  gSorted = (uint16_t*)malloc( gFont.gCount * 2);
+
+  // getUnicodeIndex() falls back to a linear search
+  if (!gSorted) return;
+
+  for (uint16_t i = 0; i < gFont.gCount; i++)
+  {
+    uint16_t gNum = i;
+    uint16_t j = i;
+    while (j > 0 && gUnicode[gSorted[j - 1]] > gUnicode[gNum])
+    {
+      gSorted[j] = gSorted[j - 1];
+      j--;
+    }
+    gSorted[j] = gNum;
+  }
 }
 
 
@@ -296,6 +329,14 @@ void TFT_eSPI::unloadFont( void )
     gBitmap = NULL;
   }
 
+  if (gSorted)
+  {
+    free(gSorted);
+    gSorted = NULL;
+  }
+
+  clearGlyphAtlas();
+
   gFont.gArray = nullptr;
 
 #ifdef FONT_FS_AVAILABLE
@@ -340,6 +381,25 @@ uint32_t TFT_eSPI::readInt32(void)
 *************************************************************************************x*/
 bool TFT_eSPI::getUnicodeIndex(uint16_t unicode, uint16_t *index)
 {
+  if (gSorted)
+  {
+    int32_t low  = 0;
+    int32_t high = gFont.gCount - 1;
+    while (low <= high)
+    {
+      int32_t mid = (low + high) >> 1;
+      uint16_t code = gUnicode[gSorted[mid]];
+      if (code == unicode)
+      {
+        *index = gSorted[mid];
+        return true;
+      }
+      if (code < unicode) low = mid + 1;
+      else high = mid - 1;
+    }
+    return false;
+  }
+
   for (uint16_t i = 0; i < gFont.gCount; i++)
   {
     if (gUnicode[i] == unicode)
@@ -407,14 +467,6 @@ void TFT_eSPI::drawGlyph(uint16_t code)
     uint8_t* pbuffer = nullptr;
     const uint8_t* gPtr = (const uint8_t*) gFont.gArray;
 
-#ifdef FONT_FS_AVAILABLE
-    if (fs_font)
-    {
-      fontFile.seek(gBitmap[gNum], fs::SeekSet);
-      pbuffer =  (uint8_t*)malloc(gWidth[gNum]);
-    }
-#endif
-
     int16_t cy = cursor_y + gFont.maxAscent - gdY[gNum];
     int16_t cx = cursor_x + gdX[gNum];
 
@@ -458,6 +510,29 @@ void TFT_eSPI::drawGlyph(uint16_t code)
       }
     }
 
+    // A cached glyph covers its whole bitmap, so it can only be used when every
+    // pixel of it would have been drawn anyway
+    uint16_t* atlasPixels = nullptr;
+    if (atlasMaxBytes && _fillbg && !getColor && bx == 0) atlasPixels = getAtlasGlyph(gNum, fg, bg);
+
+#ifdef FONT_FS_AVAILABLE
+    if (fs_font && !atlasPixels)
+    {
+      if (!spiffs) endWrite(); // Release SPI for SD card transaction
+      fontFile.seek(gBitmap[gNum], fs::SeekSet);
+      if (!spiffs) startWrite();
+      pbuffer =  (uint8_t*)malloc(gWidth[gNum]);
+    }
+#endif
+
+    if (atlasPixels)
+    {
+      bool swap = _swapBytes;
+      _swapBytes = true; // Atlas pixels are in native byte order
+      pushImage(cx, cy, gWidth[gNum], gHeight[gNum], atlasPixels);
+      _swapBytes = swap;
+    }
+    else
     for (int32_t y = 0; y < gHeight[gNum]; y++)
     {
 #ifdef FONT_FS_AVAILABLE
@@ -541,6 +616,127 @@ void TFT_eSPI::drawGlyph(uint16_t code)
   last_cursor_x = cursor_x;
 }
 
+/***************************************************************************************
+** Function name:           setGlyphAtlas
+** Description:             Set the RAM budget for rendered glyphs, 0 to disable
+*************************************************************************************x*/
+void TFT_eSPI::setGlyphAtlas(uint32_t maxBytes)
+{
+  clearGlyphAtlas();
+  atlasMaxBytes = maxBytes;
+  atlasHits = 0;
+  atlasMisses = 0;
+}
+
+
+/***************************************************************************************
+** Function name:           clearGlyphAtlas
+** Description:             Free all rendered glyphs
+*************************************************************************************x*/
+void TFT_eSPI::clearGlyphAtlas(void)
+{
+  for (uint16_t i = 0; i < GLYPH_ATLAS_ENTRIES; i++)
+  {
+    if (atlas[i].pixels) free(atlas[i].pixels);
+    atlas[i].pixels = nullptr;
+  }
+  atlasBytes = 0;
+}
+
+
+/***************************************************************************************
+** Function name:           readGlyphRow
+** Description:             Read one row of a glyph greyscale bitmap
+*************************************************************************************x*/
+void TFT_eSPI::readGlyphRow(uint16_t gNum, int32_t y, uint8_t* pbuffer)
+{
+#ifdef FONT_FS_AVAILABLE
+  if (fs_font) {
+    if (!spiffs) endWrite();    // Release SPI for SD card transaction
+    if (y == 0) fontFile.seek(gBitmap[gNum], fs::SeekSet);
+    fontFile.read(pbuffer, gWidth[gNum]);
+    if (!spiffs) startWrite();  // Re-start SPI for TFT transaction
+    return;
+  }
+#endif
+  const uint8_t* gPtr = (const uint8_t*) gFont.gArray + gBitmap[gNum] + gWidth[gNum] * y;
+  for (int32_t x = 0; x < gWidth[gNum]; x++) pbuffer[x] = pgm_read_byte(gPtr + x);
+}
+
+
+/***************************************************************************************
+** Function name:           getAtlasGlyph
+** Description:             Find or render a glyph blended with the fg/bg colours
+*************************************************************************************x*/
+// Returns nullptr if the glyph does not fit in the atlas, the least recently used
+// glyphs are freed to make room for a new one
+uint16_t* TFT_eSPI::getAtlasGlyph(uint16_t gNum, uint16_t fg, uint16_t bg)
+{
+  atlasClock++;
+
+  int16_t slot = -1;
+  for (uint16_t i = 0; i < GLYPH_ATLAS_ENTRIES; i++)
+  {
+    if (atlas[i].pixels == nullptr)
+    {
+      if (slot < 0) slot = i;
+      continue;
+    }
+    if (atlas[i].gNum == gNum && atlas[i].fg == fg && atlas[i].bg == bg)
+    {
+      atlas[i].lastUse = atlasClock;
+      atlasHits++;
+      return atlas[i].pixels;
+    }
+  }
+
+  atlasMisses++;
+
+  uint32_t size = gWidth[gNum] * gHeight[gNum] * 2;
+  if (size == 0 || size > atlasMaxBytes) return nullptr;
+
+  while (slot < 0 || atlasBytes + size > atlasMaxBytes)
+  {
+    int16_t oldest = -1;
+    for (uint16_t i = 0; i < GLYPH_ATLAS_ENTRIES; i++)
+    {
+      if (atlas[i].pixels && (oldest < 0 || atlas[i].lastUse < atlas[oldest].lastUse)) oldest = i;
+    }
+    if (oldest < 0) return nullptr;
+    free(atlas[oldest].pixels);
+    atlas[oldest].pixels = nullptr;
+    atlasBytes -= gWidth[atlas[oldest].gNum] * gHeight[atlas[oldest].gNum] * 2;
+    if (slot < 0) slot = oldest;
+  }
+
+  uint16_t* pixels = (uint16_t*)malloc(size);
+  if (!pixels) return nullptr;
+
+  uint8_t pbuffer[256]; // gWidth is 8 bit
+  uint16_t* p = pixels;
+  for (int32_t y = 0; y < gHeight[gNum]; y++)
+  {
+    readGlyphRow(gNum, y, pbuffer);
+    for (int32_t x = 0; x < gWidth[gNum]; x++)
+    {
+      uint8_t pixel = pbuffer[x];
+      if (pixel == 0xFF) *p++ = fg;
+      else if (pixel == 0) *p++ = bg;
+      else *p++ = alphaBlend(pixel, fg, bg);
+    }
+  }
+
+  atlas[slot].pixels  = pixels;
+  atlas[slot].gNum    = gNum;
+  atlas[slot].fg      = fg;
+  atlas[slot].bg      = bg;
+  atlas[slot].lastUse = atlasClock;
+  atlasBytes += size;
+
+  return pixels;
+}
+
+
 /***************************************************************************************
 ** Function name:           showFont
 ** Description:             Page through all characters in font, td ms between screens
@@ -16,6 +16,14 @@
 
   void     showFont(uint32_t td);
 
+  // Optional RAM cache of rendered glyphs for the current fg/bg colour pair, only
+  // used when the background is filled and no colour callback is set.
+  // maxBytes = 0 disables and frees the cache.
+  void     setGlyphAtlas(uint32_t maxBytes);
+  void     clearGlyphAtlas(void);
+  uint32_t getGlyphAtlasHits(void)   { return atlasHits; }
+  uint32_t getGlyphAtlasMisses(void) { return atlasMisses; }
+
  // This is for the whole font
   typedef struct
   {
@@ -39,6 +47,7 @@ fontMetrics gFont = { nullptr, 0, 0, 0, 0, 0, 0, 0 };
   int16_t*  gdY = NULL;       //topExtent
   int8_t*   gdX = NULL;       //leftExtent
   uint32_t* gBitmap = NULL;   //file pointer to greyscale bitmap
+  uint16_t* gSorted = NULL;   //glyph indexes sorted by Unicode code point
 
   bool     fontLoaded = false; // Flags when a anti-aliased font is loaded
 
@@ -55,7 +64,31 @@ fontMetrics gFont = { nullptr, 0, 0, 0, 0, 0, 0, 0 };
   private:
 
   void     loadMetrics(void);
+  void     sortMetrics(void);
   uint32_t readInt32(void);
 
+  void     readGlyphRow(uint16_t gNum, int32_t y, uint8_t* pbuffer);
+  uint16_t* getAtlasGlyph(uint16_t gNum, uint16_t fg, uint16_t bg);
+
+#ifndef GLYPH_ATLAS_ENTRIES
+  #define GLYPH_ATLAS_ENTRIES 48
+#endif
+
+  typedef struct
+  {
+    uint16_t* pixels;    // Blended RGB565 glyph, gWidth x gHeight, NULL if unused
+    uint16_t  gNum;
+    uint16_t  fg;
+    uint16_t  bg;
+    uint32_t  lastUse;
+  } atlasEntry;
+
+  atlasEntry atlas[GLYPH_ATLAS_ENTRIES] = {};
+  uint32_t atlasMaxBytes = 0;
+  uint32_t atlasBytes    = 0;
+  uint32_t atlasClock    = 0;
+  uint32_t atlasHits     = 0;
+  uint32_t atlasMisses   = 0;
+
   uint8_t* fontPtr = nullptr;
 
@@ -1982,6 +1982,20 @@ void TFT_eSprite::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t
 }
 
 
+/***************************************************************************************
+** Function name:           drawTextRun
+** Description:             draw a run of characters in the Adafruit GLCD font
+***************************************************************************************/
+void TFT_eSprite::drawTextRun(int32_t x, int32_t y, const char *text, int32_t len, uint16_t fg, uint16_t bg, int32_t padToChars)
+{
+  int32_t chars = (padToChars > len) ? padToChars : len;
+
+  for (int32_t i = 0; i < chars; i++) {
+    drawChar(x + i * 6, y, (i < len) ? (uint8_t)text[i] : ' ', fg, bg, textsize);
+  }
+}
+
+
 /***************************************************************************************
 ** Function name:           drawChar
 ** Description:             draw a single character in the Adafruit GLCD or freefont
@@ -2192,7 +2206,7 @@ int16_t TFT_eSprite::drawChar(uint16_t uniCode, int32_t x, int32_t y, uint8_t fo
 
   int32_t width  = 0;
   int32_t height = 0;
-  uint32_t flash_address = 0;
+  uintptr_t flash_address = 0;
   uniCode -= 32;
 
 #ifdef LOAD_FONT2
@@ -55,6 +55,10 @@ class TFT_eSprite : public TFT_eSPI {
            // Draw a single pixel at x,y
   void     drawPixel(int32_t x, int32_t y, uint32_t color);
 
+           // Draw a run of GLCD characters, a Sprite has no window overhead so this just
+           // draws each character in turn
+  void     drawTextRun(int32_t x, int32_t y, const char *text, int32_t len, uint16_t fg, uint16_t bg, int32_t padToChars = 0);
+
            // Draw a single character in the GLCD or GFXFF font
   void     drawChar(int32_t x, int32_t y, uint16_t c, uint32_t color, uint32_t bg, uint8_t size),
 
@@ -0,0 +1,415 @@
+        ////////////////////////////////////////////////////
+        //    TFT_eSPI native (host) framebuffer driver   //
+        ////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Global variables
+////////////////////////////////////////////////////////////////////////////////////////
+
+// The host Arduino shim provides the SPI object, only its transaction calls are used
+#ifdef TFT_SPI_PORT
+  SPIClass& spi = TFT_SPI_PORT;
+#else
+  SPIClass& spi = SPI;
+#endif
+
+TFT_eSPI_NativePanel tft_native;
+
+/***************************************************************************************
+** Function name:           select
+** Description:             Chip select, each assertion counts as one transaction
+***************************************************************************************/
+void TFT_eSPI_NativePanel::select(bool active)
+{
+  if (active && !_selected) transactions++;
+  _selected = active;
+}
+
+/***************************************************************************************
+** Function name:           write8
+** Description:             Decode one byte sent to the controller
+***************************************************************************************/
+void TFT_eSPI_NativePanel::write8(uint8_t c)
+{
+  bytes++;
+
+  if (!_data) {
+    commands++;
+    _command = c;
+    _paramCount = 0;
+    if (c == TFT_RAMWR) {
+      windows++;
+      _x = _xs;
+      _y = _ys;
+      _havePixelHigh = false;
+    }
+    return;
+  }
+
+  if (_command == TFT_CASET || _command == TFT_PASET) {
+    if (_paramCount < 4) _params[_paramCount++] = c;
+    if (_paramCount == 4) {
+      int32_t s = (_params[0] << 8) | _params[1];
+      int32_t e = (_params[2] << 8) | _params[3];
+      if (_command == TFT_CASET) { _xs = s; _xe = e; }
+      else                       { _ys = s; _ye = e; }
+    }
+    return;
+  }
+
+  if (_command != TFT_RAMWR) return;
+
+  if (!_havePixelHigh) {
+    _pixelHigh = c;
+    _havePixelHigh = true;
+    return;
+  }
+  _havePixelHigh = false;
+
+  if (_x >= 0 && _x < TFT_NATIVE_FB_SIZE && _y >= 0 && _y < TFT_NATIVE_FB_SIZE) {
+    _framebuffer[_x + _y * TFT_NATIVE_FB_SIZE] = (_pixelHigh << 8) | c;
+  }
+  pixels++;
+
+  // Same auto increment as the controller, wraps back to the top of the window
+  if (++_x > _xe) {
+    _x = _xs;
+    if (++_y > _ye) _y = _ys;
+  }
+}
+
+/***************************************************************************************
+** Function name:           getPixel
+** Description:             Read back a framebuffer pixel
+***************************************************************************************/
+uint16_t TFT_eSPI_NativePanel::getPixel(int32_t x, int32_t y)
+{
+  if (x < 0 || x >= TFT_NATIVE_FB_SIZE || y < 0 || y >= TFT_NATIVE_FB_SIZE) return 0;
+  return _framebuffer[x + y * TFT_NATIVE_FB_SIZE];
+}
+
+/***************************************************************************************
+** Function name:           writePPM
+** Description:             Save an area of the framebuffer as a binary PPM file
+***************************************************************************************/
+bool TFT_eSPI_NativePanel::writePPM(const char* path, int32_t x, int32_t y, int32_t w, int32_t h)
+{
+  FILE* file = fopen(path, "wb");
+  if (!file) return false;
+
+  fprintf(file, "P6\n%d %d\n255\n", (int)w, (int)h);
+  for (int32_t yp = y; yp < y + h; yp++) {
+    for (int32_t xp = x; xp < x + w; xp++) {
+      uint16_t color = getPixel(xp, yp);
+      uint8_t rgb[3];
+      rgb[0] = ((color >> 11) & 0x1F) * 255 / 31;
+      rgb[1] = ((color >>  5) & 0x3F) * 255 / 63;
+      rgb[2] = ( color        & 0x1F) * 255 / 31;
+      fwrite(rgb, 1, 3, file);
+    }
+  }
+
+  return fclose(file) == 0;
+}
+
+// Deflate with the fixed Huffman codes. Each match is found by only looking one
+// pixel back and one row up, which is all flat GUI screens need to compress well.
+struct NativeBitWriter {
+  uint8_t* data;
+  uint32_t length;
+  uint32_t bits;
+  uint8_t  bitCount;
+
+  void put(uint32_t value, uint8_t count) { // LSB first
+    bits |= value << bitCount;
+    bitCount += count;
+    while (bitCount >= 8) {
+      data[length++] = bits;
+      bits >>= 8;
+      bitCount -= 8;
+    }
+  }
+
+  void putCode(uint32_t code, uint8_t count) { // Huffman codes go MSB first
+    uint32_t reversed = 0;
+    for (uint8_t i = 0; i < count; i++) reversed |= ((code >> i) & 1) << (count - 1 - i);
+    put(reversed, count);
+  }
+
+  void putSymbol(uint16_t symbol) {
+    if      (symbol < 144) putCode(0x30  +  symbol,        8);
+    else if (symbol < 256) putCode(0x190 + (symbol - 144), 9);
+    else if (symbol < 280) putCode(         symbol - 256,  7);
+    else                   putCode(0xC0  + (symbol - 280), 8);
+  }
+};
+
+static uint32_t nativeDeflate(const uint8_t* in, uint32_t length, uint32_t stride, uint8_t* out)
+{
+  static const uint16_t lengthBase[29]  = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                           35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+  static const uint8_t  lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                           3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+  static const uint16_t distBase[30]    = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                           257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                           8193, 12289, 16385, 24577};
+  static const uint8_t  distExtra[30]   = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                           7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+  NativeBitWriter writer = {out, 0, 0, 0};
+  writer.put(1, 1); // Final block
+  writer.put(1, 2); // Fixed Huffman codes
+
+  const uint32_t distances[2] = {3, stride};
+  uint32_t i = 0;
+  while (i < length) {
+    uint32_t bestLength = 0, bestDistance = 0;
+    for (uint8_t d = 0; d < 2; d++) {
+      uint32_t distance = distances[d];
+      if (distance > i || distance > 32768) continue;
+      uint32_t matchLength = 0;
+      while (matchLength < 258 && i + matchLength < length &&
+             in[i + matchLength] == in[i + matchLength - distance]) matchLength++;
+      if (matchLength > bestLength) { bestLength = matchLength; bestDistance = distance; }
+    }
+
+    if (bestLength < 3) {
+      writer.putSymbol(in[i++]);
+      continue;
+    }
+
+    uint8_t code = 28;
+    while (lengthBase[code] > bestLength) code--;
+    writer.putSymbol(257 + code);
+    writer.put(bestLength - lengthBase[code], lengthExtra[code]);
+
+    code = 29;
+    while (distBase[code] > bestDistance) code--;
+    writer.putCode(code, 5);
+    writer.put(bestDistance - distBase[code], distExtra[code]);
+
+    i += bestLength;
+  }
+
+  writer.putSymbol(256); // End of block
+  if (writer.bitCount > 0) writer.put(0, 8 - writer.bitCount);
+  return writer.length;
+}
+
+static uint32_t nativeCRC32(uint32_t crc, const uint8_t* data, uint32_t length)
+{
+  crc = ~crc;
+  while (length--) {
+    crc ^= *data++;
+    for (uint8_t k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static void nativePut32(uint8_t* dest, uint32_t value)
+{
+  dest[0] = value >> 24;
+  dest[1] = value >> 16;
+  dest[2] = value >>  8;
+  dest[3] = value;
+}
+
+static bool nativeWriteChunk(FILE* file, const char* type, const uint8_t* data, uint32_t length)
+{
+  uint8_t header[8];
+  nativePut32(header, length);
+  memcpy(header + 4, type, 4);
+  uint8_t crc[4];
+  nativePut32(crc, nativeCRC32(nativeCRC32(0, header + 4, 4), data, length));
+  return fwrite(header, 1, 8, file) == 8 && fwrite(data, 1, length, file) == length &&
+         fwrite(crc, 1, 4, file) == 4;
+}
+
+/***************************************************************************************
+** Function name:           writePNG
+** Description:             Save an area of the framebuffer as an RGB PNG file
+***************************************************************************************/
+bool TFT_eSPI_NativePanel::writePNG(const char* path, int32_t x, int32_t y, int32_t w, int32_t h)
+{
+  if (w <= 0 || h <= 0) return false;
+
+  // Each row is a filter type byte (0, none) and the RGB bytes
+  const uint32_t stride = 1 + w * 3;
+  const uint32_t rawLength = stride * h;
+  uint8_t* raw = (uint8_t*)malloc(rawLength);
+  // Worst case is every byte as a 9 bit literal, plus the zlib header and checksum
+  uint8_t* compressed = (uint8_t*)malloc(rawLength * 9 / 8 + 16);
+  if (!raw || !compressed) {
+    free(raw);
+    free(compressed);
+    return false;
+  }
+
+  uint8_t* p = raw;
+  for (int32_t yp = y; yp < y + h; yp++) {
+    *p++ = 0;
+    for (int32_t xp = x; xp < x + w; xp++) {
+      uint16_t color = getPixel(xp, yp);
+      *p++ = ((color >> 11) & 0x1F) * 255 / 31;
+      *p++ = ((color >>  5) & 0x3F) * 255 / 63;
+      *p++ = ( color        & 0x1F) * 255 / 31;
+    }
+  }
+
+  compressed[0] = 0x78; // zlib, 32K window
+  compressed[1] = 0x01; // No preset dictionary, header checksum
+  uint32_t length = 2 + nativeDeflate(raw, rawLength, stride, compressed + 2);
+  uint32_t a = 1, b = 0;
+  for (uint32_t i = 0; i < rawLength; i++) {
+    a = (a + raw[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  nativePut32(compressed + length, (b << 16) | a);
+  length += 4;
+
+  uint8_t ihdr[13];
+  nativePut32(ihdr,     w);
+  nativePut32(ihdr + 4, h);
+  ihdr[8]  = 8; // Bit depth
+  ihdr[9]  = 2; // RGB
+  ihdr[10] = 0; // Deflate
+  ihdr[11] = 0; // Adaptive filtering
+  ihdr[12] = 0; // Not interlaced
+
+  static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  FILE* file = fopen(path, "wb");
+  bool ok = file != NULL;
+  if (ok) {
+    ok = fwrite(signature, 1, 8, file) == 8 &&
+         nativeWriteChunk(file, "IHDR", ihdr, sizeof(ihdr)) &&
+         nativeWriteChunk(file, "IDAT", compressed, length) &&
+         nativeWriteChunk(file, "IEND", NULL, 0);
+    ok = fclose(file) == 0 && ok;
+  }
+
+  free(raw);
+  free(compressed);
+  return ok;
+}
+
+/***************************************************************************************
+** Function name:           clear
+** Description:             Fill the framebuffer without counting any bus traffic
+***************************************************************************************/
+void TFT_eSPI_NativePanel::clear(uint16_t color)
+{
+  for (uint32_t i = 0; i < TFT_NATIVE_FB_SIZE * TFT_NATIVE_FB_SIZE; i++) _framebuffer[i] = color;
+}
+
+/***************************************************************************************
+** Function name:           resetCounters
+** Description:             Zero the bus traffic counters
+***************************************************************************************/
+void TFT_eSPI_NativePanel::resetCounters(void)
+{
+  bytes        = 0;
+  commands     = 0;
+  windows      = 0;
+  transactions = 0;
+  pixels       = 0;
+}
+
+/***************************************************************************************
+** Function name:           pushBlock - for native framebuffer
+** Description:             Write a block of pixels of the same colour
+***************************************************************************************/
+void TFT_eSPI::pushBlock(uint16_t color, uint32_t len){
+
+  while ( len-- ) {tft_Write_16(color);}
+}
+
+/***************************************************************************************
+** Function name:           pushPixels - for native framebuffer
+** Description:             Write a sequence of pixels
+***************************************************************************************/
+void TFT_eSPI::pushPixels(const void* data_in, uint32_t len){
+
+  uint16_t *data = (uint16_t*)data_in;
+
+  if (_swapBytes) while ( len-- ) {tft_Write_16(*data); data++;}
+  else while ( len-- ) {tft_Write_16S(*data); data++;}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+//                                DMA FUNCTIONS
+////////////////////////////////////////////////////////////////////////////////////////
+
+// Transfers are synchronous, these only mirror the byte order behaviour of the
+// ESP32 functions so code written for DMA renders the same
+
+/***************************************************************************************
+** Function name:           initDMA
+** Description:             Nothing to set up
+***************************************************************************************/
+bool TFT_eSPI::initDMA(bool ctrl_cs)
+{
+  ctrl_cs = ctrl_cs; // Not used
+  DMA_Enabled = true;
+  return true;
+}
+
+/***************************************************************************************
+** Function name:           deInitDMA
+** Description:             Nothing to tear down
+***************************************************************************************/
+void TFT_eSPI::deInitDMA(void)
+{
+  DMA_Enabled = false;
+}
+
+/***************************************************************************************
+** Function name:           dmaBusy
+** Description:             Transfers complete immediately
+***************************************************************************************/
+bool TFT_eSPI::dmaBusy(void)
+{
+  return false;
+}
+
+/***************************************************************************************
+** Function name:           dmaWait
+** Description:             Transfers complete immediately
+***************************************************************************************/
+void TFT_eSPI::dmaWait(void)
+{
+}
+
+/***************************************************************************************
+** Function name:           pushPixelsDMA
+** Description:             Push pixels to the current window
+***************************************************************************************/
+void TFT_eSPI::pushPixelsDMA(uint16_t* image, uint32_t len)
+{
+  if ((len == 0) || (!DMA_Enabled)) return;
+  pushPixels(image, len);
+}
+
+/***************************************************************************************
+** Function name:           pushImageDMA
+** Description:             Push image to a window, bytes are sent as they are in memory
+***************************************************************************************/
+void TFT_eSPI::pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t const* image)
+{
+  if ((w == 0) || (h == 0) || (!DMA_Enabled)) return;
+
+  bool swap = _swapBytes;
+  _swapBytes = false;
+  pushImage(x, y, w, h, image);
+  _swapBytes = swap;
+}
+
+/***************************************************************************************
+** Function name:           pushImageDMA
+** Description:             Push image to a window, swaps bytes if setSwapBytes(true)
+***************************************************************************************/
+void TFT_eSPI::pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t* image, uint16_t* buffer)
+{
+  buffer = buffer; // Nothing is sent in the background, so no copy is needed
+  if (!DMA_Enabled) return;
+  pushImage(x, y, w, h, image);
+}
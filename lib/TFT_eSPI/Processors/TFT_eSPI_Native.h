@@ -0,0 +1,115 @@
+        ////////////////////////////////////////////////////
+        //    TFT_eSPI native (host) framebuffer driver   //
+        ////////////////////////////////////////////////////
+
+// Used when TFT_NATIVE is defined, e.g. for a Linux build with Arduino shims.
+// Nothing is sent anywhere, instead a model of the display controller decodes
+// the SPI byte stream into an RGB565 framebuffer and counts the bus traffic, so
+// rendering can be checked and measured off the device. Only the standard
+// CASET/PASET/RAMWR address window commands are decoded, which covers the
+// ST7735, ST7789 and ILI9341 style drivers.
+
+#ifndef _TFT_eSPI_NATIVEH_
+#define _TFT_eSPI_NATIVEH_
+
+#include <stdio.h>
+
+// Processor ID reported by getSetup()
+#define PROCESSOR_ID 0x0F00
+
+// Framebuffer is square so it fits the controller memory in any rotation
+#ifndef TFT_NATIVE_FB_SIZE
+  #define TFT_NATIVE_FB_SIZE 320
+#endif
+
+// Model of the display controller on the other end of the bus
+class TFT_eSPI_NativePanel {
+  public:
+    void     select(bool active);
+    void     dataMode(bool data) { _data = data; }
+
+    void     write8(uint8_t c);
+    void     write16(uint16_t c)  { write8(c >> 8); write8(c); }
+    void     write16S(uint16_t c) { write8(c); write8(c >> 8); }
+    void     write32C(uint16_t c, uint16_t d) { write16(c); write16(d); }
+    uint8_t  read8(void) { bytes++; return 0; }
+
+    uint16_t getPixel(int32_t x, int32_t y);
+             // Writes a binary PPM of an area of the framebuffer. Note that x and y
+             // are controller coordinates, which include any column/row start offset
+             // the driver adds for the panel in use.
+    bool     writePPM(const char* path, int32_t x, int32_t y, int32_t w, int32_t h);
+             // Same as writePPM but as an RGB PNG. The encoder has no options and
+             // no randomness, so the same pixels always give the same file and
+             // snapshots can be compared byte for byte.
+    bool     writePNG(const char* path, int32_t x, int32_t y, int32_t w, int32_t h);
+    void     clear(uint16_t color = 0);
+    void     resetCounters(void);
+
+    uint32_t bytes        = 0; // All bytes on the bus, commands included
+    uint32_t commands     = 0; // Command bytes
+    uint32_t windows      = 0; // RAMWR commands, i.e. address windows written to
+    uint32_t transactions = 0; // Chip select assertions
+    uint32_t pixels       = 0; // Pixels written to the framebuffer
+
+  private:
+    bool     _data     = true;
+    bool     _selected = false;
+    uint8_t  _command  = 0;
+    uint8_t  _params[4];
+    uint8_t  _paramCount = 0;
+    uint8_t  _pixelHigh  = 0;
+    bool     _havePixelHigh = false;
+    int32_t  _xs = 0, _xe = 0, _ys = 0, _ye = 0;
+    int32_t  _x  = 0, _y  = 0;
+
+    uint16_t _framebuffer[TFT_NATIVE_FB_SIZE * TFT_NATIVE_FB_SIZE];
+};
+
+extern TFT_eSPI_NativePanel tft_native;
+
+// Processor specific code used by SPI bus transaction startWrite and endWrite functions
+#define SET_BUS_WRITE_MODE // Not used
+#define SET_BUS_READ_MODE  // Not used
+
+// Transfers complete immediately, so there is never a DMA transfer in progress
+#define DMA_BUSY_CHECK // Not used so leave blank
+
+// Initialise processor specific SPI functions, used by init()
+#define INIT_TFT_DATA_BUS
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Control lines drive the controller model
+////////////////////////////////////////////////////////////////////////////////////////
+#define DC_C tft_native.dataMode(false)
+#define DC_D tft_native.dataMode(true)
+
+#define CS_L tft_native.select(true)
+#define CS_H tft_native.select(false)
+
+#define T_CS_L // No macro allocated so it generates no code
+#define T_CS_H // No macro allocated so it generates no code
+
+#ifndef TFT_RD
+  #define TFT_RD -1
+#endif
+
+#ifndef TFT_MISO
+  #define TFT_MISO -1
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Macros to write commands/pixel colour data
+////////////////////////////////////////////////////////////////////////////////////////
+#define tft_Write_8(C)     tft_native.write8((uint8_t)(C))
+#define tft_Write_16(C)    tft_native.write16((uint16_t)(C))
+#define tft_Write_16S(C)   tft_native.write16S((uint16_t)(C))
+#define tft_Write_16N      tft_Write_16
+
+#define tft_Write_32(C)    tft_native.write32C((uint16_t)((C)>>16), (uint16_t)(C))
+#define tft_Write_32C(C,D) tft_native.write32C((uint16_t)(C), (uint16_t)(D))
+#define tft_Write_32D(C)   tft_native.write32C((uint16_t)(C), (uint16_t)(C))
+
+#define tft_Read_8()       tft_native.read8()
+
+#endif // Header end
@@ -15,7 +15,9 @@
 
 #include "TFT_eSPI.h"
 
-#if defined (ESP32)
+#if defined (TFT_NATIVE)
+  #include "Processors/TFT_eSPI_Native.c"
+#elif defined (ESP32)
   #if defined(CONFIG_IDF_TARGET_ESP32S3)
     #include "Processors/TFT_eSPI_ESP32_S3.c" // Tested with SPI and 8 bit parallel
   #elif defined(CONFIG_IDF_TARGET_ESP32C3)
@@ -449,6 +451,9 @@ TFT_eSPI::TFT_eSPI(int16_t w, int16_t h)
   rotation  = 0;
   cursor_y  = cursor_x  = last_cursor_x = bg_cursor_x = 0;
   textfont  = 1;
+#ifdef LOAD_GFXFF
+  gfxFont   = nullptr; // GLCD font until a free font is set
+#endif
   textsize  = 1;
   textcolor   = bitmap_fg = 0xFFFF; // White
   textbgcolor = bitmap_bg = 0x0000; // Black
@@ -3008,6 +3013,70 @@ int16_t TFT_eSPI::fontHeight(void)
   return fontHeight(textfont);
 }
 
+/***************************************************************************************
+** Function name:           drawTextRun
+** Description:             draw a run of GLCD characters with a single address window
+***************************************************************************************/
+// Each pixel row of the whole run is rendered into a line buffer and pushed in turn,
+// so the run costs one window and one transaction instead of one per character.
+// Falls back to drawChar() when the run is clipped or another font/size is active.
+void TFT_eSPI::drawTextRun(int32_t x, int32_t y, const char *text, int32_t len, uint16_t fg, uint16_t bg, int32_t padToChars)
+{
+  if (_vpOoB) return;
+
+  int32_t chars = (padToChars > len) ? padToChars : len;
+  if (chars <= 0) return;
+
+  int32_t xd = x + _xDatum;
+  int32_t yd = y + _yDatum;
+  int32_t w  = chars * 6;
+
+  bool fast = (textsize == 1) && (fg != bg) && (w <= TEXT_RUN_MAX_WIDTH) &&
+              xd >= _vpX && xd + w <= _vpW && yd >= _vpY && yd + 8 <= _vpH;
+#ifdef LOAD_GFXFF
+  if (gfxFont) fast = false;
+#endif
+#ifndef LOAD_GLCD
+  fast = false;
+#endif
+
+  if (!fast) {
+    for (int32_t i = 0; i < chars; i++) {
+      drawChar(x + i * 6, y, (i < len) ? (uint8_t)text[i] : ' ', fg, bg, textsize);
+    }
+    return;
+  }
+
+#ifdef LOAD_GLCD
+  // pushPixels() only swaps when _swapBytes is set, so store the colours in the
+  // byte order that ends up big endian on the bus
+  uint16_t fgw = _swapBytes ? fg : (fg >> 8) | (fg << 8);
+  uint16_t bgw = _swapBytes ? bg : (bg >> 8) | (bg << 8);
+
+  uint16_t line[TEXT_RUN_MAX_WIDTH];
+
+  begin_tft_write();
+
+  setWindow(xd, yd, xd + w - 1, yd + 7);
+
+  for (uint8_t row = 0; row < 8; row++) {
+    uint8_t mask = 1 << row;
+    uint16_t *p = line;
+    for (int32_t i = 0; i < chars; i++) {
+      uint8_t c = (i < len) ? (uint8_t)text[i] : ' ';
+      if (c < 32) c = ' ';
+      for (uint8_t k = 0; k < 5; k++) {
+        *p++ = (pgm_read_byte(font + (c * 5) + k) & mask) ? fgw : bgw;
+      }
+      *p++ = bgw;
+    }
+    pushPixels(line, w);
+  }
+
+  end_tft_write();
+#endif
+}
+
 /***************************************************************************************
 ** Function name:           drawChar
 ** Description:             draw a single character in the GLCD or GFXFF font
@@ -4645,7 +4714,7 @@ int16_t TFT_eSPI::drawChar(uint16_t uniCode, int32_t x, int32_t y, uint8_t font)
 
   int32_t width  = 0;
   int32_t height = 0;
-  uint32_t flash_address = 0;
+  uintptr_t flash_address = 0;
   uniCode -= 32;
 
 #ifdef LOAD_FONT2
@@ -81,6 +81,11 @@
     typeof(addr) _addr = (addr); \
     *(const unsigned long *)(_addr); \
   })
+#elif defined(TFT_NATIVE)
+  // The font tables hold pointers, which are read with pgm_read_dword() and
+  // are 64 bits on most hosts
+  #undef pgm_read_dword
+  #define pgm_read_dword(addr) (*(const uintptr_t *)(addr))
 #elif defined(__AVR__)
   #include <avr/pgmspace.h>
 #elif defined(ARDUINO_ARCH_ESP8266) || defined(ESP32)
@@ -90,7 +95,9 @@
 #endif
 
 // Include the processor specific drivers
-#if defined(CONFIG_IDF_TARGET_ESP32S3)
+#if defined (TFT_NATIVE)
+  #include "Processors/TFT_eSPI_Native.h"
+#elif defined(CONFIG_IDF_TARGET_ESP32S3)
   #include "Processors/TFT_eSPI_ESP32_S3.h"
 #elif defined(CONFIG_IDF_TARGET_ESP32C3)
   #include "Processors/TFT_eSPI_ESP32_C3.h"
@@ -141,6 +148,12 @@
   #define SPI_BUSY_CHECK
 #endif
 
+// Longest run in pixels drawTextRun() renders with a single window, its line buffer
+// lives on the stack
+#ifndef TEXT_RUN_MAX_WIDTH
+  #define TEXT_RUN_MAX_WIDTH 320
+#endif
+
 /***************************************************************************************
 **                         Section 4: Setup fonts
 ***************************************************************************************/
@@ -434,6 +447,10 @@ class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has ac
                    height(void),
                    width(void);
 
+                   // Draw a run of GLCD font characters (text size 1) in one address window,
+                   // optionally padded with background colour up to padToChars characters
+  virtual void     drawTextRun(int32_t x, int32_t y, const char *text, int32_t len, uint16_t fg, uint16_t bg, int32_t padToChars = 0);
+
                    // Read the colour of a pixel at x,y and return value in 565 format
   virtual uint16_t readPixel(int32_t x, int32_t y);
 
@@ -724,7 +741,7 @@ class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has ac
            // in progress, this simplifies the sketch and helps avoid "gotchas".
   void     pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t* data, uint16_t* buffer = nullptr);
 
-#if defined (ESP32) // ESP32 only at the moment
+#if defined (ESP32) || defined (TFT_NATIVE) // ESP32 only at the moment
            // For case where pointer is a const and the image data must not be modified (clipped or byte swapped)
   void     pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t const* data);
 #endif
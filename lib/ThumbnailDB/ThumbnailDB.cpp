@@ -0,0 +1,622 @@
+#include <Arduino.h>
+#include "ThumbnailDB.h"
+
+static_assert(THUMBNAIL_ENTRY_BYTES + THUMBNAIL_PIXEL_BYTES ==
+                  THUMBNAIL_RECORD_BYTES,
+              "Thumbnail records have to be packed");
+
+ThumbnailDB* ThumbnailDB::instance = NULL;
+
+bool ThumbnailDB::begin(SdFs* sd) {
+  if (this->began) {
+    return true;
+  }
+
+  this->sd = sd;
+  ThumbnailDB::instance = this;
+
+  if (!this->sd->exists(THUMBNAIL_DB_DIRECTORY)) {
+    this->sd->mkdir(THUMBNAIL_DB_DIRECTORY);
+    Serial.println("Created directory " THUMBNAIL_DB_DIRECTORY);
+  }
+  FsFile db;
+  if (this->openDatabase(&db, true)) {
+    db.close();
+  }
+  Serial.printf("%u thumbnail records\n", this->recordCount);
+
+  this->began = true;
+  return true;
+}
+
+// Adds the thumbnail of a photo that was just taken. The index is not looked
+// at, a photo that replaced another one of the same name leaves the old record
+// behind until the next update().
+bool ThumbnailDB::add(JPEGDEC* decoder, const char* path) {
+  if (!this->began ||
+      strncmp(path, THUMBNAIL_IMAGES_DIRECTORY,
+              strlen(THUMBNAIL_IMAGES_DIRECTORY)) != 0) {
+    return false;
+  }
+  const char* name = path + strlen(THUMBNAIL_IMAGES_DIRECTORY);
+  if (strlen(name) >= THUMBNAIL_NAME_SIZE) {
+    return false;
+  }
+
+  FsFile db;
+  if (!this->openDatabase(&db, true)) {
+    return false;
+  }
+  FsFile image = this->sd->open(path, O_RDONLY);
+  if (!image) {
+    db.close();
+    return false;
+  }
+  const uint32_t startTime = millis();
+  const bool result = this->addFile(decoder, &db, &image, name, -1);
+  image.close();
+  db.close();
+  Serial.printf("Added thumbnail of %s in %lu ms\n", path,
+                millis() - startTime);
+  return result;
+}
+
+// Brings the database in line with /images/: photos without a record or whose
+// modify time or size changed get a new thumbnail, records of photos that are
+// gone are marked deleted
+bool ThumbnailDB::update(JPEGDEC* decoder, ThumbnailProgressCallback progress,
+                         void* progressParam) {
+  if (!this->began || !this->loadIndex()) {
+    return false;
+  }
+  FsFile dir = this->sd->open(THUMBNAIL_IMAGES_DIRECTORY, O_RDONLY);
+  if (!dir) {
+    Serial.println("Could not open " THUMBNAIL_IMAGES_DIRECTORY);
+    return false;
+  }
+  FsFile db;
+  if (!this->openDatabase(&db, true)) {
+    dir.close();
+    return false;
+  }
+
+  const uint32_t startTime = millis();
+  for (uint16_t i = 0; i < this->recordCount; i++) {
+    this->index[i].seen = false;
+  }
+
+  uint16_t checked = 0;
+  uint16_t added = 0;
+  uint16_t removed = 0;
+  char name[THUMBNAIL_NAME_SIZE];
+  FsFile image;
+  dir.rewindDirectory();
+  while (image.openNext(&dir, O_RDONLY)) {
+    // Names that do not fit come back empty
+    if (image.isHidden() || image.isDir() ||
+        image.getName(name, THUMBNAIL_NAME_SIZE) == 0 ||
+        !ThumbnailDB::isImageName(name)) {
+      image.close();
+      continue;
+    }
+
+    const uint32_t modified = ThumbnailDB::getModified(&image);
+    const uint32_t size = image.fileSize();
+    const int32_t record = this->findRecord(&db, name, modified, size);
+    if (record >= 0 && this->index[record].modified == modified &&
+        this->index[record].size == size) {
+      this->index[record].seen = true;
+    } else if (this->addFile(decoder, &db, &image, name, record)) {
+      added++;
+    }
+    image.close();
+
+    checked++;
+    if (progress != NULL) {
+      progress(checked, progressParam);
+    }
+  }
+  dir.close();
+
+  // Left over are photos that were deleted and duplicate records
+  const uint16_t flags = 0;
+  for (uint16_t i = 0; i < this->recordCount; i++) {
+    IndexEntry* entry = &this->index[i];
+    if (!entry->valid || entry->seen) {
+      continue;
+    }
+    if (db.seek((uint32_t)(i + 1) * THUMBNAIL_RECORD_BYTES +
+                offsetof(Entry, flags)) &&
+        db.write(&flags, sizeof(flags)) == sizeof(flags)) {
+      entry->valid = false;
+      removed++;
+    }
+  }
+  db.close();
+
+  Serial.printf("Checked %u photos in %lu ms, %u thumbnails added, %u "
+                "removed\n",
+                checked, millis() - startTime, added, removed);
+  return true;
+}
+
+// Starts the database over from /images/, dropping deleted records
+bool ThumbnailDB::rebuild(JPEGDEC* decoder, ThumbnailProgressCallback progress,
+                          void* progressParam) {
+  if (!this->began) {
+    return false;
+  }
+  Serial.println("Rebuilding thumbnails");
+  if (this->sd->exists(THUMBNAIL_DB_PATH) &&
+      !this->sd->remove(THUMBNAIL_DB_PATH)) {
+    Serial.println("Could not remove " THUMBNAIL_DB_PATH);
+    return false;
+  }
+  this->recordCount = 0;
+  return this->update(decoder, progress, progressParam);
+}
+
+// Frees the index, it is read again the next time it is needed
+void ThumbnailDB::release() {
+  if (this->index != NULL) {
+    free(this->index);
+    this->index = NULL;
+  }
+}
+
+// Photos with a thumbnail
+uint16_t ThumbnailDB::getCount() {
+  if (!this->began || !this->loadIndex()) {
+    return 0;
+  }
+  uint16_t count = 0;
+  for (uint16_t i = 0; i < this->recordCount; i++) {
+    if (this->index[i].valid) {
+      count++;
+    }
+  }
+  return count;
+}
+
+bool ThumbnailDB::getPath(uint16_t index, char* result, size_t resultSize) {
+  const int32_t record = this->getRecord(index);
+  if (record < 0) {
+    return false;
+  }
+  FsFile db;
+  if (!this->openDatabase(&db, false)) {
+    return false;
+  }
+  Entry entry;
+  const bool read = this->readEntry(&db, record, &entry);
+  db.close();
+  if (!read) {
+    return false;
+  }
+  entry.name[THUMBNAIL_NAME_SIZE - 1] = '\0';
+  return snprintf(result, resultSize, "%s%s", THUMBNAIL_IMAGES_DIRECTORY,
+                  entry.name) < (int)resultSize;
+}
+
+// Calls draw with the big endian RGB565 thumbnails of count photos starting
+// at first, which are read front to back in one pass over the file
+bool ThumbnailDB::readThumbnails(uint16_t first, uint16_t count,
+                                 ThumbnailDrawCallback draw, void* drawParam) {
+  int32_t record = this->getRecord(first);
+  if (record < 0) {
+    return false;
+  }
+  FsFile db;
+  if (!this->openDatabase(&db, false)) {
+    return false;
+  }
+  if (!db.seek((uint32_t)(record + 1) * THUMBNAIL_RECORD_BYTES)) {
+    db.close();
+    return false;
+  }
+
+  Entry entry;
+  uint16_t drawn = 0;
+  while (drawn < count && record < this->recordCount) {
+    if (db.read(&entry, THUMBNAIL_ENTRY_BYTES) != THUMBNAIL_ENTRY_BYTES ||
+        db.read(this->pixels, THUMBNAIL_PIXEL_BYTES) != THUMBNAIL_PIXEL_BYTES) {
+      break;
+    }
+    if ((entry.flags & ThumbnailDB::ENTRY_VALID) != 0) {
+      draw(first + drawn, this->pixels, drawParam);
+      drawn++;
+    }
+    record++;
+  }
+  db.close();
+  return drawn == count;
+}
+
+// The thumbnail of a photo in /images/ and the size of the photo, or NULL
+// when there is none or the photo changed since. The pixels are only valid
+// until the database is used again.
+const uint16_t* ThumbnailDB::find(const char* path, uint16_t* width,
+                                  uint16_t* height) {
+  if (!this->began || !this->loadIndex() ||
+      strncmp(path, THUMBNAIL_IMAGES_DIRECTORY,
+              strlen(THUMBNAIL_IMAGES_DIRECTORY)) != 0) {
+    return NULL;
+  }
+  const char* name = path + strlen(THUMBNAIL_IMAGES_DIRECTORY);
+  if (strlen(name) >= THUMBNAIL_NAME_SIZE) {
+    return NULL;
+  }
+  FsFile image = this->sd->open(path, O_RDONLY);
+  if (!image) {
+    return NULL;
+  }
+  const uint32_t modified = ThumbnailDB::getModified(&image);
+  const uint32_t size = image.fileSize();
+  image.close();
+
+  FsFile db;
+  if (!this->openDatabase(&db, false)) {
+    return NULL;
+  }
+  const int32_t record = this->findRecord(&db, name, modified, size);
+  Entry entry;
+  const bool found =
+      record >= 0 && this->index[record].modified == modified &&
+      this->index[record].size == size &&
+      this->readEntry(&db, record, &entry) &&
+      db.read(this->pixels, THUMBNAIL_PIXEL_BYTES) == THUMBNAIL_PIXEL_BYTES;
+  db.close();
+  if (!found || (entry.flags & ThumbnailDB::ENTRY_BLANK) != 0) {
+    return NULL;
+  }
+  if (width != NULL) {
+    *width = entry.width;
+  }
+  if (height != NULL) {
+    *height = entry.height;
+  }
+  return this->pixels;
+}
+
+// Opens the database for reading and writing, a file that is missing (when
+// create is true) or was written by another version is started over
+bool ThumbnailDB::openDatabase(FsFile* db, bool create) {
+  *db = this->sd->open(THUMBNAIL_DB_PATH, create ? O_RDWR | O_CREAT : O_RDWR);
+  if (!*db) {
+    Serial.println("Could not open " THUMBNAIL_DB_PATH);
+    return false;
+  }
+
+  Header header;
+  if (db->fileSize() >= THUMBNAIL_RECORD_BYTES &&
+      db->read(&header, sizeof(header)) == sizeof(header) &&
+      memcmp(header.magic, "THDB", 4) == 0 &&
+      header.version == THUMBNAIL_DB_VERSION &&
+      header.width == THUMBNAIL_WIDTH && header.height == THUMBNAIL_HEIGHT &&
+      header.recordBytes == THUMBNAIL_RECORD_BYTES) {
+    this->recordCount =
+        min((uint32_t)THUMBNAIL_MAX_RECORDS,
+            (uint32_t)(db->fileSize() / THUMBNAIL_RECORD_BYTES - 1));
+    return true;
+  }
+
+  Serial.println("Creating new thumbnail database");
+  memcpy(header.magic, "THDB", 4);
+  header.version = THUMBNAIL_DB_VERSION;
+  header.width = THUMBNAIL_WIDTH;
+  header.height = THUMBNAIL_HEIGHT;
+  header.recordBytes = THUMBNAIL_RECORD_BYTES;
+  this->recordCount = 0;
+  // Records are only ever written at or before the end of the file, so the
+  // header is padded out to a whole record
+  memset(this->pixels, 0, THUMBNAIL_PIXEL_BYTES);
+  if (!db->truncate(0) ||
+      db->write(&header, sizeof(header)) != sizeof(header) ||
+      db->write(this->pixels, THUMBNAIL_ENTRY_BYTES - sizeof(header)) !=
+          THUMBNAIL_ENTRY_BYTES - sizeof(header) ||
+      db->write(this->pixels, THUMBNAIL_PIXEL_BYTES) != THUMBNAIL_PIXEL_BYTES) {
+    Serial.println("Could not write " THUMBNAIL_DB_PATH);
+    db->close();
+    return false;
+  }
+  return true;
+}
+
+// Reads the entry of every record, once until release()
+bool ThumbnailDB::loadIndex() {
+  if (this->index != NULL) {
+    return true;
+  }
+  FsFile db;
+  if (!this->openDatabase(&db, true)) {
+    return false;
+  }
+  this->index =
+      (IndexEntry*)malloc(THUMBNAIL_MAX_RECORDS * sizeof(IndexEntry));
+  if (this->index == NULL) {
+    Serial.println("Not enough memory for the thumbnail index");
+    db.close();
+    return false;
+  }
+
+  const uint32_t startTime = millis();
+  Entry entry;
+  for (uint16_t i = 0; i < this->recordCount; i++) {
+    IndexEntry* indexEntry = &this->index[i];
+    indexEntry->valid = false;
+    if (!this->readEntry(&db, i, &entry)) {
+      // Cut short by a failed write, it is overwritten by the next one
+      this->recordCount = i;
+      break;
+    }
+    entry.name[THUMBNAIL_NAME_SIZE - 1] = '\0';
+    indexEntry->nameHash = ThumbnailDB::hashName(entry.name);
+    indexEntry->modified = entry.modified;
+    indexEntry->size = entry.size;
+    indexEntry->valid = (entry.flags & ThumbnailDB::ENTRY_VALID) != 0;
+  }
+  db.close();
+  Serial.printf("Loaded %u thumbnail records in %lu ms\n", this->recordCount,
+                millis() - startTime);
+  return true;
+}
+
+// The valid record with this name, or -1. Hashes that match a record of
+// another modify time or size are checked against the name in the file.
+int32_t ThumbnailDB::findRecord(FsFile* db, const char* name,
+                                uint32_t modified, uint32_t size) {
+  const uint32_t nameHash = ThumbnailDB::hashName(name);
+  Entry entry;
+  for (uint16_t i = 0; i < this->recordCount; i++) {
+    const IndexEntry* indexEntry = &this->index[i];
+    if (!indexEntry->valid || indexEntry->nameHash != nameHash) {
+      continue;
+    }
+    if (indexEntry->modified == modified && indexEntry->size == size) {
+      return i;
+    }
+    if (this->readEntry(db, i, &entry) &&
+        strncmp(entry.name, name, THUMBNAIL_NAME_SIZE) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// The record of the index-th valid record, or -1
+int32_t ThumbnailDB::getRecord(uint16_t index) {
+  if (!this->began || !this->loadIndex()) {
+    return -1;
+  }
+  for (uint16_t i = 0; i < this->recordCount; i++) {
+    if (!this->index[i].valid) {
+      continue;
+    }
+    if (index == 0) {
+      return i;
+    }
+    index--;
+  }
+  return -1;
+}
+
+bool ThumbnailDB::readEntry(FsFile* db, uint16_t record, Entry* entry) {
+  return db->seek((uint32_t)(record + 1) * THUMBNAIL_RECORD_BYTES) &&
+         db->read(entry, THUMBNAIL_ENTRY_BYTES) == THUMBNAIL_ENTRY_BYTES;
+}
+
+// Writes the entry followed by the thumbnail in pixels
+bool ThumbnailDB::writeRecord(FsFile* db, uint16_t record,
+                              const Entry* entry) {
+  return db->seek((uint32_t)(record + 1) * THUMBNAIL_RECORD_BYTES) &&
+         db->write(entry, THUMBNAIL_ENTRY_BYTES) == THUMBNAIL_ENTRY_BYTES &&
+         db->write(this->pixels, THUMBNAIL_PIXEL_BYTES) ==
+             THUMBNAIL_PIXEL_BYTES;
+}
+
+// Makes the thumbnail of an open photo in /images/ and writes it over record,
+// or after the last record when record is -1
+bool ThumbnailDB::addFile(JPEGDEC* decoder, FsFile* db, FsFile* image,
+                          const char* name, int32_t record) {
+  if (record < 0) {
+    if (this->recordCount >= THUMBNAIL_MAX_RECORDS) {
+      Serial.println("Thumbnail database is full");
+      return false;
+    }
+    record = this->recordCount;
+  }
+
+  char path[THUMBNAIL_NAME_SIZE + sizeof(THUMBNAIL_IMAGES_DIRECTORY)];
+  snprintf(path, sizeof(path), "%s%s", THUMBNAIL_IMAGES_DIRECTORY, name);
+
+  Entry entry;
+  memset(&entry, 0, sizeof(entry));
+  strncpy(entry.name, name, THUMBNAIL_NAME_SIZE - 1);
+  entry.modified = ThumbnailDB::getModified(image);
+  entry.size = image->fileSize();
+  entry.flags = ThumbnailDB::ENTRY_VALID;
+  // Photos that do not decode keep a blank record so they are not tried again
+  // until they change
+  if (this->makeThumbnail(decoder, path)) {
+    entry.width = this->imageWidth;
+    entry.height = this->imageHeight;
+  } else {
+    Serial.printf("Could not make thumbnail of %s\n", path);
+    memset(this->pixels, 0, THUMBNAIL_PIXEL_BYTES);
+    entry.flags |= ThumbnailDB::ENTRY_BLANK;
+  }
+  if (!this->writeRecord(db, record, &entry)) {
+    Serial.println("Could not write " THUMBNAIL_DB_PATH);
+    return false;
+  }
+
+  if (record == this->recordCount) {
+    this->recordCount++;
+  }
+  if (this->index != NULL) {
+    IndexEntry* indexEntry = &this->index[record];
+    indexEntry->nameHash = ThumbnailDB::hashName(name);
+    indexEntry->modified = entry.modified;
+    indexEntry->size = entry.size;
+    indexEntry->valid = true;
+    indexEntry->seen = true;
+  }
+  return true;
+}
+
+// Decodes the photo, or the thumbnail embedded in it, at the smallest scale
+// that still covers the thumbnail and averages it down into pixels
+bool ThumbnailDB::makeThumbnail(JPEGDEC* decoder, const char* path) {
+  ExifThumbnailInfo thumbnail;
+  bool hasThumbnail = false;
+  this->imageFile = this->sd->open(path, O_RDONLY);
+  if (this->imageFile) {
+    hasThumbnail = Exif::readThumbnailInfo(&this->imageFile, &thumbnail);
+    this->imageFile.close();
+  }
+  this->imageOffset = hasThumbnail ? thumbnail.offset : 0;
+  this->imageLength = hasThumbnail ? thumbnail.length : 0;
+
+  if (!decoder->open(path, ThumbnailDB::openFile, ThumbnailDB::closeFile,
+                     ThumbnailDB::readFile, ThumbnailDB::seekFile,
+                     ThumbnailDB::drawFile)) {
+    this->imageOffset = 0;
+    this->imageLength = 0;
+    return false;
+  }
+
+  const int scaleOptions[4] = {JPEG_SCALE_EIGHTH, JPEG_SCALE_QUARTER,
+                               JPEG_SCALE_HALF, 0};
+  uint8_t scale = 0;
+  uint8_t shift = 3;
+  while (shift > 0 && ((decoder->getWidth() >> shift) < THUMBNAIL_WIDTH ||
+                       (decoder->getHeight() >> shift) < THUMBNAIL_HEIGHT)) {
+    scale++;
+    shift--;
+  }
+  this->imageWidth = hasThumbnail ? thumbnail.imageWidth : decoder->getWidth();
+  this->imageHeight =
+      hasThumbnail ? thumbnail.imageHeight : decoder->getHeight();
+  this->scaledWidth = decoder->getWidth() >> shift;
+  this->scaledHeight = decoder->getHeight() >> shift;
+
+  const uint16_t pixelCount = THUMBNAIL_WIDTH * THUMBNAIL_HEIGHT;
+  this->sums = (uint16_t*)calloc(pixelCount * 3, sizeof(uint16_t));
+  this->counts = (uint16_t*)calloc(pixelCount, sizeof(uint16_t));
+  int result = 0;
+  if (this->sums != NULL && this->counts != NULL &&
+      this->scaledWidth > 0 && this->scaledHeight > 0) {
+    decoder->setPixelType(RGB565_LITTLE_ENDIAN);
+    result = decoder->decode(0, 0, scaleOptions[scale]);
+  }
+  decoder->close();
+  this->imageOffset = 0;
+  this->imageLength = 0;
+
+  if (result == 1) {
+    for (uint16_t i = 0; i < pixelCount; i++) {
+      const uint16_t count = max(this->counts[i], (uint16_t)1);
+      const uint16_t pixel = (this->sums[i * 3] / count) << 11 |
+                             (this->sums[i * 3 + 1] / count) << 5 |
+                             (this->sums[i * 3 + 2] / count);
+      this->pixels[i] = pixel >> 8 | pixel << 8;
+    }
+  }
+
+  if (this->sums != NULL) {
+    free(this->sums);
+    this->sums = NULL;
+  }
+  if (this->counts != NULL) {
+    free(this->counts);
+    this->counts = NULL;
+  }
+  return result == 1;
+}
+
+bool ThumbnailDB::isImageName(const char* name) {
+  const char* extension = strrchr(name, '.');
+  return extension != NULL && (strcasecmp(extension, ".jpg") == 0 ||
+                               strcasecmp(extension, ".jpeg") == 0);
+}
+
+uint32_t ThumbnailDB::getModified(FsFile* file) {
+  uint16_t date = 0;
+  uint16_t time = 0;
+  file->getModifyDateTime(&date, &time);
+  return (uint32_t)date << 16 | time;
+}
+
+// FNV-1a
+uint32_t ThumbnailDB::hashName(const char* name) {
+  uint32_t hash = 2166136261;
+  while (*name != '\0') {
+    hash ^= (uint8_t)*name++;
+    hash *= 16777619;
+  }
+  return hash;
+}
+
+void* ThumbnailDB::openFile(const char* filename, int32_t* size) {
+  ThumbnailDB* self = ThumbnailDB::instance;
+  self->imageFile = self->sd->open(filename, O_RDONLY);
+  if (!self->imageFile) {
+    return NULL;
+  }
+  if (self->imageLength > 0) {
+    *size = self->imageLength;
+    self->imageFile.seek(self->imageOffset);
+  } else {
+    *size = self->imageFile.size();
+  }
+  return &self->imageFile;
+}
+
+void ThumbnailDB::closeFile(void* handle) {
+  ThumbnailDB* self = ThumbnailDB::instance;
+  if (self->imageFile) {
+    self->imageFile.close();
+  }
+}
+
+int32_t ThumbnailDB::readFile(JPEGFILE* handle, uint8_t* buffer,
+                              int32_t length) {
+  ThumbnailDB* self = ThumbnailDB::instance;
+  if (self->imageLength > 0) {
+    const int32_t remaining =
+        self->imageOffset + self->imageLength - self->imageFile.curPosition();
+    length = max(min(length, remaining), (int32_t)0);
+  }
+  return self->imageFile.read(buffer, length);
+}
+
+int32_t ThumbnailDB::seekFile(JPEGFILE* handle, int32_t position) {
+  ThumbnailDB* self = ThumbnailDB::instance;
+  return self->imageFile.seek(self->imageOffset + position);
+}
+
+// Adds every pixel of the block to the thumbnail pixel it falls in
+int ThumbnailDB::drawFile(JPEGDRAW* pDraw) {
+  ThumbnailDB* self = ThumbnailDB::instance;
+  const int32_t width =
+      min((int32_t)pDraw->iWidth, (int32_t)self->scaledWidth - pDraw->x);
+  const int32_t height =
+      min((int32_t)pDraw->iHeight, (int32_t)self->scaledHeight - pDraw->y);
+  for (int32_t y = 0; y < height; y++) {
+    const uint16_t* row = pDraw->pPixels + y * pDraw->iWidth;
+    const uint32_t rowStart =
+        (uint32_t)(pDraw->y + y) * THUMBNAIL_HEIGHT / self->scaledHeight *
+        THUMBNAIL_WIDTH;
+    for (int32_t x = 0; x < width; x++) {
+      const uint32_t i =
+          rowStart + (uint32_t)(pDraw->x + x) * THUMBNAIL_WIDTH /
+                         self->scaledWidth;
+      const uint16_t pixel = row[x];
+      self->sums[i * 3] += pixel >> 11;
+      self->sums[i * 3 + 1] += (pixel >> 5) & 0x3F;
+      self->sums[i * 3 + 2] += pixel & 0x1F;
+      self->counts[i]++;
+    }
+  }
+  return 1;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Exif.h>
+#include <JPEGDEC.h>
+#include <SdFat.h>
+
+#define THUMBNAIL_DB_DIRECTORY "/thumbnails/"
+#define THUMBNAIL_DB_PATH "/thumbnails/images.db"
+#define THUMBNAIL_IMAGES_DIRECTORY "/images/"
+
+// Thumbnails are made from the 1/8 scale decode, which is 160x128 for photos
+const uint16_t THUMBNAIL_WIDTH = 36;
+const uint16_t THUMBNAIL_HEIGHT = 28;
+const uint32_t THUMBNAIL_PIXEL_BYTES =
+    THUMBNAIL_WIDTH * THUMBNAIL_HEIGHT * sizeof(uint16_t);
+
+// Every record is an entry followed by the pixels, and the file header takes
+// up the first record so all of them start on a sector boundary
+const size_t THUMBNAIL_NAME_SIZE = 18;
+const uint32_t THUMBNAIL_ENTRY_BYTES = 32;
+const uint32_t THUMBNAIL_RECORD_BYTES = 2048;
+const uint16_t THUMBNAIL_DB_VERSION = 2;
+// Photos past this many are not indexed
+const uint16_t THUMBNAIL_MAX_RECORDS = 1024;
+
+typedef void (*ThumbnailProgressCallback)(uint16_t done, void* param);
+typedef void (*ThumbnailDrawCallback)(uint16_t index, const uint16_t* pixels,
+                                      void* param);
+
+// Thumbnails of the photos in /images/, packed into a single file of fixed
+// size records in the order they were added, which is the order the gallery
+// shows them in.
+//
+// Each record starts with the file name, modify time and size of the photo it
+// was made from. update() compares them to the directory, making thumbnails
+// for new or changed photos and marking records of photos that are gone as
+// deleted. rebuild() starts over, which also drops deleted records.
+//
+// A hash of every name with its modify time and size is kept in memory while
+// the database is in use, release() frees it.
+class ThumbnailDB {
+  public:
+    bool begin(SdFs* sd);
+
+    bool add(JPEGDEC* decoder, const char* path);
+    bool update(JPEGDEC* decoder, ThumbnailProgressCallback progress = NULL,
+                void* progressParam = NULL);
+    bool rebuild(JPEGDEC* decoder, ThumbnailProgressCallback progress = NULL,
+                 void* progressParam = NULL);
+    void release();
+
+    uint16_t getCount();
+    bool getPath(uint16_t index, char* result, size_t resultSize);
+    bool readThumbnails(uint16_t first, uint16_t count,
+                        ThumbnailDrawCallback draw, void* drawParam);
+    const uint16_t* find(const char* path, uint16_t* width = NULL,
+                         uint16_t* height = NULL);
+
+  protected:
+    struct Header {
+        char magic[4];
+        uint16_t version;
+        uint16_t width;
+        uint16_t height;
+        uint16_t recordBytes;
+    };
+
+    struct Entry {
+        char name[THUMBNAIL_NAME_SIZE];
+        uint16_t flags;
+        // FAT date in the high half, time in the low half
+        uint32_t modified;
+        uint32_t size;
+        // Of the photo, 0 when it could not be decoded
+        uint16_t width;
+        uint16_t height;
+    };
+
+    struct IndexEntry {
+        uint32_t nameHash;
+        uint32_t modified;
+        uint32_t size;
+        bool valid;
+        bool seen;
+    };
+
+    static const uint16_t ENTRY_VALID = 1;
+    // Could not be decoded, the thumbnail is blank
+    static const uint16_t ENTRY_BLANK = 2;
+
+    bool openDatabase(FsFile* db, bool create);
+    bool loadIndex();
+    int32_t findRecord(FsFile* db, const char* name, uint32_t modified,
+                       uint32_t size);
+    int32_t getRecord(uint16_t index);
+    bool readEntry(FsFile* db, uint16_t record, Entry* entry);
+    bool writeRecord(FsFile* db, uint16_t record, const Entry* entry);
+    bool addFile(JPEGDEC* decoder, FsFile* db, FsFile* image, const char* name,
+                 int32_t record);
+    bool makeThumbnail(JPEGDEC* decoder, const char* path);
+
+    static bool isImageName(const char* name);
+    static uint32_t getModified(FsFile* file);
+    static uint32_t hashName(const char* name);
+
+    static void* openFile(const char* filename, int32_t* size);
+    static void closeFile(void* handle);
+    static int32_t readFile(JPEGFILE* handle, uint8_t* buffer, int32_t length);
+    static int32_t seekFile(JPEGFILE* handle, int32_t position);
+    static int drawFile(JPEGDRAW* pDraw);
+
+    static ThumbnailDB* instance;
+
+    bool began = false;
+
+    SdFs* sd;
+    FsFile imageFile;
+    // Only this part of the photo is given to the decoder when it is not 0
+    uint32_t imageOffset = 0;
+    uint32_t imageLength = 0;
+
+    uint16_t recordCount = 0;
+    IndexEntry* index = NULL;
+
+    // Box filter sums while making a thumbnail, red, green and blue for every
+    // pixel, which are packed into pixels once the decode is done
+    uint16_t* sums = NULL;
+    uint16_t* counts = NULL;
+    uint16_t scaledWidth = 0;
+    uint16_t scaledHeight = 0;
+    uint16_t imageWidth = 0;
+    uint16_t imageHeight = 0;
+    uint16_t pixels[THUMBNAIL_WIDTH * THUMBNAIL_HEIGHT];
+};
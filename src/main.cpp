@@ -3,21 +3,50 @@
 #include <Arduino.h>
 #include <Button.h>
 #include <ESP32_Camera_GUI.h>
+#include <Exif.h>
+#include <FrameGovernor.h>
+#include <ImageCache.h>
 #include <JPEGDEC.h>
+#include <JPEGRenderer.h>
+#include <ParallelJPEG.h>
 #include <RTClib.h>
 #include <SD.h>  // Needed by JPEGDEC because it needs "File"
 #include <SPI.h> // Needed by TFT_eSPI
 #include <SdFat.h>
 #include <TFT_eSPI.h>
+#include <ThumbnailDB.h>
 #include <memorysaver.h> // Needed by ArduCAM
 
 // #define DEBUG_FPS
+// #define DISABLE_DMA_RENDER
+// #define SINGLE_CORE_RENDER
+// #define DISABLE_FRAME_GOVERNOR
 
 ArduCamera arduCamera;
 
 const uint8_t previewImageSize = OV2640_160x120;
 uint8_t captureImageSize = OV2640_1280x1024;
 
+// JPEG preview modes the governor picks from, cheapest first. 320x240 is
+// decoded at half scale so every mode fills the same 160x120 area with the
+// same field of view.
+struct PreviewMode {
+    uint8_t imageSize;
+    uint8_t quality;
+    int scale;
+    const char* name;
+};
+const uint8_t previewModeCount = 4;
+const PreviewMode previewModes[previewModeCount] = {
+    {OV2640_160x120, 0x20, 0, "160 q32"},
+    {OV2640_160x120, OV2640_DEFAULT_JPEG_QUALITY, 0, "160 q12"},
+    {OV2640_320x240, 0x20, JPEG_SCALE_HALF, "320/2 q32"},
+    {OV2640_320x240, 0x10, JPEG_SCALE_HALF, "320/2 q16"}};
+const uint8_t DEFAULT_PREVIEW_MODE = 1;
+const uint16_t PREVIEW_TARGET_FPS = 15;
+
+FrameGovernor governor;
+
 const uint8_t SD_CS = 5;
 #define SPI_CLOCK SD_SCK_MHZ(24)
 #define SD_CONFIG SdSpiConfig(SD_CS, SHARED_SPI, SPI_CLOCK)
@@ -32,6 +61,20 @@ const uint32_t PREVIEW_BUF_SIZE = 160 * 120 * 12 / 8;
 uint8_t previewBuf[PREVIEW_BUF_SIZE];
 JPEGDEC jpeg;
 
+// RGB565 previews are streamed straight from the FIFO to the display one line
+// at a time, so only a single line has to be buffered
+const uint16_t RGB_PREVIEW_WIDTH = 160;
+const uint16_t RGB_PREVIEW_HEIGHT = 120;
+const size_t RGB_PREVIEW_LINE_SIZE = RGB_PREVIEW_WIDTH * 2;
+uint8_t rgbPreviewLine[RGB_PREVIEW_LINE_SIZE];
+
+JPEGRenderer renderer;
+// Splits photos with restart markers between the two cores in the viewer
+ParallelJPEG parallelJPEG;
+ImageCache imageCache;
+ThumbnailDB thumbnailDB;
+Exif exif;
+
 const uint8_t UP_BUTTON = 25;
 const uint8_t SELECT_BUTTON = 33;
 const uint8_t DOWN_BUTTON = 32;
@@ -47,15 +90,42 @@ const uint8_t BATT_PIN = A0;
 ESP32CameraGUI gui;
 
 const char* optionsTitle = "Options";
-const uint8_t optionsCount = 4;
-const char* optionsMenu[optionsCount] = {"Exit", "View files",
-                                         "Change camera settings", "Set clock"};
+const uint8_t optionsCount = 8;
+const char* optionsMenu[optionsCount] = {
+    "Exit",          "View files",    "Change camera settings",
+    "Set clock",     "Run benchmark", "Gallery",
+    "Rebuild thumbnails", "Slideshow"};
+
+const char* slideshowOptionsTitle = "Slideshow interval";
+const uint8_t slideshowOptionsCount = 5;
+const char* slideshowOptionsMenu[slideshowOptionsCount] = {
+    "Exit", "1 second", "3 seconds", "5 seconds", "10 seconds"};
+const uint32_t slideshowOptionsValues[slideshowOptionsCount] = {0, 1000, 3000,
+                                                                5000, 10000};
+
+const uint16_t BENCHMARK_ITERATIONS = 10;
+const uint16_t BENCHMARK_TEXT_LINES = 64;
 
 const char* cameraSettingOptionsTitle = "Camera settings";
-const uint8_t cameraSettingOptionsCount = 7;
+const uint8_t cameraSettingOptionsCount = 10;
 const char* cameraSettingOptionsMenu[cameraSettingOptionsCount] = {
-    "Exit",         "Set light mode",     "Set saturation", "Set brightness",
-    "Set contrast", "Set special effect", "Reset settings"};
+    "Exit",           "Set light mode",     "Set saturation",
+    "Set brightness", "Set contrast",       "Set special effect",
+    "Reset settings", "Set preview mode",   "Toggle histogram",
+    "Toggle focus peaking"};
+
+const char* previewModeOptionsTitle = "Set preview mode";
+const uint8_t previewModeOptionsCount = 4;
+const char* previewModeOptionsMenu[previewModeOptionsCount] = {
+    "Exit", "JPEG", "JPEG grayscale", "RGB565"};
+const uint8_t previewModeOptionsValues[previewModeOptionsCount] = {0xFF, JPEG,
+                                                                  JPEG, BMP};
+const bool previewModeOptionsGrayscale[previewModeOptionsCount] = {
+    false, false, true, false};
+
+// Decodes JPEG previews to luma only, which skips the chroma blocks and the
+// color conversion
+bool grayscalePreview = false;
 
 const char* cameraLightModeOptionsTitle = "Set light mode";
 const uint8_t cameraLightModeOptionsCount = 6;
@@ -96,6 +166,11 @@ const uint8_t
         0xFF, Antique,  Bluish,     Greenish, Reddish,
         BW,   Negative, BWnegative, Normal};
 
+void applyPreviewMode(uint8_t mode) {
+  arduCamera.setImageSize(previewModes[mode].imageSize);
+  arduCamera.setJPEGQuality(previewModes[mode].quality);
+}
+
 FsFile jpegFile;
 
 void* JPEGOpen(const char* filename, int32_t* size) {
@@ -120,7 +195,10 @@ void JPEGClose(void* handle) {
   }
 }
 
+// The SD card shares the bus with the display, so it has to be released before
+// the decoder reads more of the file
 int32_t JPEGRead(JPEGFILE* handle, uint8_t* buffer, int32_t length) {
+  renderer.releaseBus();
   if (!jpegFile) {
     Serial.printf("Attempted reading %ld bytes to %p but file is not open!\n",
                   length, buffer);
@@ -134,6 +212,7 @@ int32_t JPEGRead(JPEGFILE* handle, uint8_t* buffer, int32_t length) {
 }
 
 int32_t JPEGSeek(JPEGFILE* handle, int32_t position) {
+  renderer.releaseBus();
   if (!jpegFile) {
     Serial.printf("Attempted seeking to %ld but file is not open!\n", position);
     return 0;
@@ -143,20 +222,57 @@ int32_t JPEGSeek(JPEGFILE* handle, int32_t position) {
   }
 }
 
+// Time spent pushing pixels in JPEGDraw in microseconds, used to split decode
+// time from display time
+uint32_t jpegPushTime = 0;
+
+// Pixels are decoded as big endian RGB565 or 8 bit grayscale (see setPixelType
+// after every open), so the renderer sends them to the display without
+// swapping bytes
 int JPEGDraw(JPEGDRAW* pDraw) {
-  tft.setAddrWindow(pDraw->x, pDraw->y, pDraw->iWidth, pDraw->iHeight);
-  tft.setSwapBytes(true);
-  tft.pushPixels(pDraw->pPixels, pDraw->iWidth * pDraw->iHeight);
+  const uint32_t startPushTime = micros();
+  renderer.draw(pDraw);
+  jpegPushTime += micros() - startPushTime;
   return 1;
 }
 
-int JPEGDrawContained(JPEGDRAW* pDraw) {
-  tft.startWrite();
-  tft.setAddrWindow(pDraw->x, pDraw->y, pDraw->iWidth, pDraw->iHeight);
-  tft.setSwapBytes(true);
-  tft.pushPixels(pDraw->pPixels, pDraw->iWidth * pDraw->iHeight);
-  tft.endWrite();
-  return 1;
+bool RGBPreviewStream(uint8_t* buf, size_t len) {
+  tft.pushPixels(buf, len / 2);
+  return true;
+}
+
+bool benchmarkRender(uint8_t* buf, size_t len, bool grayscale,
+                     uint32_t* decodeTime, uint32_t* pushTime) {
+  const uint32_t startRenderTime = micros();
+  jpegPushTime = 0;
+  if (!jpeg.openRAM(buf, len, JPEGDraw)) {
+    return false;
+  }
+  jpeg.setPixelType(grayscale ? EIGHT_BIT_GRAYSCALE : RGB565_BIG_ENDIAN);
+  renderer.startFrame();
+  const bool result = jpeg.decode(0, 0, grayscale ? JPEG_LUMA_ONLY : 0);
+  renderer.finishFrame();
+  jpeg.close();
+  *pushTime = jpegPushTime;
+  *decodeTime = micros() - startRenderTime - jpegPushTime;
+  return result;
+}
+
+// The histogram and focus peaking are for framing shots, so photos in the
+// viewer and benchmark frames are drawn without them
+bool pausedHistogram = false;
+bool pausedFocusPeaking = false;
+
+void pausePreviewOverlays() {
+  pausedHistogram = renderer.isHistogramEnabled();
+  pausedFocusPeaking = renderer.isFocusPeaking();
+  renderer.setHistogram(false);
+  renderer.setFocusPeaking(false);
+}
+
+void resumePreviewOverlays() {
+  renderer.setHistogram(pausedHistogram);
+  renderer.setFocusPeaking(pausedFocusPeaking);
 }
 
 // https://github.com/greiman/SdFat/blob/master/examples/RtcTimestampTest/RtcTimestampTest.ino#L77
@@ -186,6 +302,19 @@ uint16_t hardwareBegin() {
   tft.begin();
   tft.fillScreen(TFT_BLACK);
   tft.setRotation(1);
+  tft.setSwapBytes(false);
+#if defined(SINGLE_CORE_RENDER)
+  const bool dualCoreRender = false;
+#else
+  const bool dualCoreRender = true;
+#endif
+#if defined(DISABLE_DMA_RENDER)
+  const bool dmaRender = false;
+#else
+  const bool dmaRender = true;
+#endif
+  renderer.begin(&tft, dualCoreRender, dmaRender);
+  renderer.setDirtyTracking(true);
 
   Serial.println("Initiating hardware...");
 
@@ -226,11 +355,17 @@ uint16_t hardwareBegin() {
     Serial.println("ok!");
   }
 
-  if (!arduCamera.begin(&sd)) {
+  parallelJPEG.begin(&sd, &renderer);
+  imageCache.begin(&sd);
+  thumbnailDB.begin(&sd);
+  exif.begin(&sd);
+
+  if (!arduCamera.begin(&sd, &rtc)) {
     Serial.println("Hardware initialization...error!");
     returnCode |= HARDWARE_BEGIN_CAMERA_FAIL;
   }
-  arduCamera.setImageSize(previewImageSize);
+  governor.begin(previewModeCount, DEFAULT_PREVIEW_MODE, PREVIEW_TARGET_FPS);
+  applyPreviewMode(governor.getMode());
   arduCamera.loadCameraSettings();
 
   upButton.begin();
@@ -296,9 +431,17 @@ void fileExplorerAndApps(const char* preselectPath = NULL) {
                          endingDirectory, MAX_PATH_SIZE, &startingIndex,
                          &startingOffset)) {
       if (jpeg.open(result, JPEGOpen, JPEGClose, JPEGRead, JPEGSeek,
-                    JPEGDrawContained)) {
+                    JPEGDraw)) {
+        jpeg.setPixelType(RGB565_BIG_ENDIAN);
         Serial.println("Decoded headers successfully, opening image viewer");
-        gui.imageViewer(result, &jpeg);
+        renderer.setDirtyTracking(false);
+        pausePreviewOverlays();
+        gui.imageViewer(result, &jpeg, &renderer, &parallelJPEG, &imageCache,
+                        &thumbnailDB);
+        imageCache.release();
+        thumbnailDB.release();
+        resumePreviewOverlays();
+        renderer.setDirtyTracking(true);
         alreadyUseExplorer = true;
       }
     } else {
@@ -307,6 +450,30 @@ void fileExplorerAndApps(const char* preselectPath = NULL) {
   }
 }
 
+void gallery() {
+  const size_t MAX_PATH_SIZE = 255;
+  char result[MAX_PATH_SIZE];
+  uint16_t index = 0;
+  bool update = true;
+  while (gui.gallery(&thumbnailDB, &jpeg, result, MAX_PATH_SIZE, update, index,
+                     &index)) {
+    update = false;
+    if (jpeg.open(result, JPEGOpen, JPEGClose, JPEGRead, JPEGSeek,
+                  JPEGDraw)) {
+      jpeg.setPixelType(RGB565_BIG_ENDIAN);
+      Serial.println("Decoded headers successfully, opening image viewer");
+      renderer.setDirtyTracking(false);
+      pausePreviewOverlays();
+      gui.imageViewer(result, &jpeg, &renderer, &parallelJPEG, &imageCache,
+                      &thumbnailDB);
+      imageCache.release();
+      resumePreviewOverlays();
+      renderer.setDirtyTracking(true);
+    }
+  }
+  thumbnailDB.release();
+}
+
 void setup() {
   pinMode(LED_BUILTIN, OUTPUT);
   STATUS_LOW();
@@ -344,29 +511,80 @@ void setup() {
 
 void loop() {
   const uint32_t startCaptureTime = millis();
+  const uint32_t startFrameMicros = micros();
+  const PreviewMode& previewMode = previewModes[governor.getMode()];
 
-  memset(previewBuf, 0, PREVIEW_BUF_SIZE);
-  const size_t previewSize =
-      arduCamera.captureToMemory(previewBuf, PREVIEW_BUF_SIZE);
+  size_t previewSize = 0;
+  uint32_t elapsedCaptureTime = 0;
+  uint32_t startRenderTime = 0;
+
+  if (arduCamera.getFormat() == JPEG) {
+    memset(previewBuf, 0, PREVIEW_BUF_SIZE);
+    previewSize = arduCamera.captureToMemory(previewBuf, PREVIEW_BUF_SIZE);
+
+    elapsedCaptureTime = millis() - startCaptureTime;
+    startRenderTime = millis();
+  } else {
+    // Capture and render overlap here, so the FIFO drain counts as rendering
+    tft.startWrite();
+    tft.setSwapBytes(false);
+    tft.setAddrWindow(0, 0, RGB_PREVIEW_WIDTH, RGB_PREVIEW_HEIGHT);
+    if (arduCamera.captureToStream(rgbPreviewLine, RGB_PREVIEW_LINE_SIZE,
+                                   RGBPreviewStream) == 0) {
+      gui.setBottomText("Error showing preview!", 3000);
+    }
+    tft.endWrite();
 
-  const uint32_t elapsedCaptureTime = millis() - startCaptureTime;
+    const CameraCaptureStats stats = arduCamera.getLastCaptureStats();
+    elapsedCaptureTime = stats.captureTime / 1000;
+    startRenderTime = millis() - stats.drainTime / 1000;
+  }
 
-  const uint32_t startRenderTime = millis();
-  if (previewSize > 0) {
+  if (arduCamera.getFormat() == JPEG && previewSize > 0) {
 
     if (jpeg.openRAM(previewBuf, previewSize, JPEGDraw)) {
-      tft.startWrite();
-      if (!jpeg.decode(0, 0, 0)) {
+      jpeg.setPixelType(grayscalePreview ? EIGHT_BIT_GRAYSCALE
+                                         : RGB565_BIG_ENDIAN);
+      renderer.startFrame();
+      if (!jpeg.decode(0, 0,
+                       previewMode.scale |
+                           (grayscalePreview ? JPEG_LUMA_ONLY : 0))) {
         gui.setBottomText("Error showing preview!", 3000);
       }
-      tft.endWrite();
+      renderer.finishFrame();
       jpeg.close();
     } else {
       gui.setBottomText("Error showing preview!", 3000);
     }
   }
+
+  if (renderer.isHistogramEnabled() && arduCamera.getFormat() == JPEG &&
+      previewSize > 0) {
+    uint16_t buckets[RENDERER_HISTOGRAM_BUCKETS];
+    const uint32_t samples = renderer.getHistogram(buckets);
+    gui.drawHistogram(buckets, RENDERER_HISTOGRAM_BUCKETS, samples,
+                      tft.width() - HISTOGRAM_WIDTH - 2, 2);
+  }
   const uint32_t elapsedRenderTime = millis() - startRenderTime;
 
+#if !defined(DISABLE_FRAME_GOVERNOR)
+  if (arduCamera.getFormat() == JPEG) {
+    const CameraCaptureStats stats = arduCamera.getLastCaptureStats();
+    const uint32_t captureMicros = stats.captureTime + stats.drainTime;
+    bool modeChanged = false;
+    if (previewSize == 0 || previewSize > PREVIEW_BUF_SIZE) {
+      modeChanged = governor.drop();
+    } else {
+      modeChanged = governor.update(
+          captureMicros, micros() - startFrameMicros - captureMicros);
+    }
+    if (modeChanged) {
+      applyPreviewMode(governor.getMode());
+    }
+    delay(governor.getPacingDelay(micros() - startFrameMicros) / 1000);
+  }
+#endif
+
 #ifdef DEBUG_FPS
   tft.setCursor(0, 0);
   tft.setTextColor(TFT_WHITE, TFT_BLACK);
@@ -376,12 +594,57 @@ void loop() {
   tft.print("R: ");
   tft.print(elapsedRenderTime);
   tft.print(" ms");
+  tft.print(renderer.isDualCore() ? " 2C" : " 1C");
+  tft.println(renderer.isUsingDMA() ? " DMA" : "");
+  if (renderer.isDirtyTracking() && renderer.getLastFrameTiles() > 0) {
+    tft.print("S: ");
+    tft.print(renderer.getLastFrameSkippedTiles() * 100 /
+              renderer.getLastFrameTiles());
+    tft.print("% ");
+    tft.print((uint32_t)((uint64_t)renderer.getLastFrameSkippedBytes() * 8 *
+                         1000000 / SPI_FREQUENCY));
+    tft.println(" us");
+  }
+  if (renderer.isHistogramEnabled()) {
+    tft.print("H: ");
+    tft.print(renderer.getLastFrameHistogramTime());
+    tft.println(" us");
+  }
+#if !defined(DISABLE_FRAME_GOVERNOR)
+  if (arduCamera.getFormat() == JPEG) {
+    tft.print("M: ");
+    tft.println(previewModes[governor.getMode()].name);
+    tft.print("T: ");
+    tft.print(governor.getFrameTimePercentile(50) / 1000);
+    tft.print("/");
+    tft.print(governor.getFrameTimePercentile(90) / 1000);
+    tft.print("/");
+    tft.print(governor.getFrameTimePercentile(99) / 1000);
+    tft.println(" ms");
+  }
+#endif
+  if (renderer.isFocusPeaking()) {
+    tft.print("P: ");
+    tft.print(renderer.getLastFramePeakingTime());
+    tft.print(" us ");
+    tft.print(renderer.getLastFramePeakingBlocks());
+    tft.println(" blk");
+  }
+  tft.print("F: ");
+  tft.print(1000 / max((uint32_t)1, millis() - startCaptureTime));
+  if (arduCamera.getFormat() != JPEG) {
+    tft.print(" fps RGB");
+  } else {
+    tft.print(grayscalePreview ? " fps gray" : " fps JPEG");
+  }
 #endif
 
   if (selectButton.pressed()) {
     bool exitOptionsMenu = false;
     while (!exitOptionsMenu) {
-      switch (gui.menu(optionsTitle, optionsMenu, optionsCount)) {
+      const uint8_t option = gui.menu(optionsTitle, optionsMenu, optionsCount);
+      gui.pushOverlay();
+      switch (option) {
         default:
         case 0: {
           exitOptionsMenu = true;
@@ -394,9 +657,11 @@ void loop() {
         case 2: {
           bool exitCameraSettingOptionsMenu = false;
           while (!exitCameraSettingOptionsMenu) {
-            switch (gui.menu(cameraSettingOptionsTitle,
-                             cameraSettingOptionsMenu,
-                             cameraSettingOptionsCount)) {
+            const uint8_t cameraSettingOption =
+                gui.menu(cameraSettingOptionsTitle, cameraSettingOptionsMenu,
+                         cameraSettingOptionsCount);
+            gui.pushOverlay();
+            switch (cameraSettingOption) {
               default:
               case 0: {
                 exitCameraSettingOptionsMenu = true;
@@ -573,7 +838,51 @@ void loop() {
                 exitCameraSettingOptionsMenu = true;
                 break;
               }
+              case 7: { // preview mode
+                uint8_t selected = 1;
+                for (uint8_t i = 0; i < previewModeOptionsCount; i++) {
+                  if (previewModeOptionsValues[i] == arduCamera.getFormat() &&
+                      previewModeOptionsGrayscale[i] == grayscalePreview) {
+                    selected = i;
+                    break;
+                  }
+                }
+                const uint8_t result =
+                    gui.menu(previewModeOptionsTitle, previewModeOptionsMenu,
+                             previewModeOptionsCount, selected);
+                if (result > 0) {
+                  arduCamera.setFormat(previewModeOptionsValues[result]);
+                  grayscalePreview = previewModeOptionsGrayscale[result];
+                  tft.fillScreen(TFT_BLACK);
+                  const size_t bufSize = 32;
+                  char buf[bufSize];
+                  memset(buf, 0, bufSize);
+                  snprintf(buf, bufSize, "Set preview to %s!",
+                           previewModeOptionsMenu[result]);
+                  gui.setBottomText(buf, 3000);
+                }
+                break;
+              }
+              case 8: { // histogram
+                renderer.setHistogram(!renderer.isHistogramEnabled());
+                gui.setBottomText(renderer.isHistogramEnabled()
+                                      ? "Showing histogram!"
+                                      : "Hid histogram!",
+                                  3000);
+                exitCameraSettingOptionsMenu = true;
+                break;
+              }
+              case 9: { // focus peaking
+                renderer.setFocusPeaking(!renderer.isFocusPeaking());
+                gui.setBottomText(renderer.isFocusPeaking()
+                                      ? "Focus peaking on!"
+                                      : "Focus peaking off!",
+                                  3000);
+                exitCameraSettingOptionsMenu = true;
+                break;
+              }
             }
+            gui.popOverlay(!exitCameraSettingOptionsMenu);
           }
           arduCamera.saveCameraSettings();
           break;
@@ -586,12 +895,64 @@ void loop() {
           }
           break;
         }
+        case 4: {
+          gui.setBottomText("Running benchmark...", UNLIMITED_BOTTOM_TEXT_TIME);
+          gui.drawBottomToolbar();
+          const size_t MAX_PATH_SIZE = 255;
+          char reportPath[MAX_PATH_SIZE];
+          memset(reportPath, 0, MAX_PATH_SIZE);
+          STATUS_HIGH();
+          gui.benchmarkText(BENCHMARK_TEXT_LINES);
+          pausePreviewOverlays();
+          const bool result = arduCamera.runBenchmark(
+              BENCHMARK_ITERATIONS, previewBuf, PREVIEW_BUF_SIZE,
+              previewImageSize, captureImageSize, benchmarkRender, reportPath,
+              MAX_PATH_SIZE);
+          resumePreviewOverlays();
+          STATUS_LOW();
+          if (result) {
+            gui.setBottomText("Benchmark saved!", 3000);
+          } else {
+            gui.setBottomText("Benchmark failed!", 3000);
+          }
+          exitOptionsMenu = true;
+          break;
+        }
+        case 5: {
+          gallery();
+          break;
+        }
+        case 6: {
+          STATUS_HIGH();
+          if (gui.updateThumbnails(&thumbnailDB, &jpeg, true)) {
+            gui.setBottomText("Rebuilt thumbnails!", 3000);
+          } else {
+            gui.setBottomText("Failed to rebuild!", 3000);
+          }
+          thumbnailDB.release();
+          STATUS_LOW();
+          break;
+        }
+        case 7: {
+          const uint8_t result = gui.menu(
+              slideshowOptionsTitle, slideshowOptionsMenu, slideshowOptionsCount);
+          if (result > 0) {
+            gui.slideshow("/images", &jpeg, &imageCache,
+                          slideshowOptionsValues[result]);
+            imageCache.release();
+          }
+          break;
+        }
       }
+      gui.popOverlay(!exitOptionsMenu);
     }
+    // The menus drew over the preview, so every tile has to be pushed again
+    renderer.invalidate();
   } else if (shutterButton.pressed()) {
     gui.setBottomText("Taking photo...", UNLIMITED_BOTTOM_TEXT_TIME);
     gui.drawBottomToolbar();
     arduCamera.setImageSize(captureImageSize);
+    arduCamera.setJPEGQuality(OV2640_DEFAULT_JPEG_QUALITY);
     for (uint8_t i = 0; i < 3; i++) {
       STATUS_HIGH();
       delay(1000 / 6);
@@ -602,11 +963,14 @@ void loop() {
     const size_t MAX_PATH_SIZE = 255;
     char filename[MAX_PATH_SIZE];
     memset(filename, 0, MAX_PATH_SIZE);
-    const size_t result = arduCamera.captureToDisk(filename, MAX_PATH_SIZE);
-    arduCamera.setImageSize(previewImageSize);
+    const int32_t result = arduCamera.captureToDisk(filename, MAX_PATH_SIZE);
+    applyPreviewMode(governor.getMode());
     STATUS_LOW();
     delay(1000);
     if (result > 0) {
+      // Before the database, which then only has to decode the thumbnail
+      exif.embedThumbnail(&jpeg, filename);
+      thumbnailDB.add(&jpeg, filename);
       gui.setBottomText("Photo saved!", 3000);
     } else if (result == CAMERA_ERROR) {
       gui.setBottomText("Camera error!", 3000);
@@ -618,6 +982,7 @@ void loop() {
     if (selectButton.pressed()) {
       fileExplorerAndApps(filename);
     }
+    renderer.invalidate();
   }
 
   gui.drawBottomToolbar();
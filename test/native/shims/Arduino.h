@@ -0,0 +1,239 @@
+// Just enough of the Arduino core and FreeRTOS for the libraries in lib/ to
+// build and run on the host (pio test -e native). Tasks are std::threads,
+// pins are driven by the test through nativeDigitalRead, and time is virtual:
+// millis() and micros() only move when delay() is called, so screens that
+// scroll or throttle on time render the same on every run.
+
+#pragma once
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using std::max;
+using std::min;
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define IRAM_ATTR
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_MODE0 0
+
+#define HEX 16
+#define DEC 10
+
+#define constrain(amt, low, high) \
+  ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+inline long random(long howBig) {
+  return howBig == 0 ? 0 : rand() % howBig;
+}
+
+inline long random(long howSmall, long howBig) {
+  return howSmall >= howBig ? howSmall : howSmall + random(howBig - howSmall);
+}
+
+inline char* ltoa(long value, char* result, int base) {
+  snprintf(result, 34, base == 16 ? "%lx" : "%ld", value);
+  return result;
+}
+
+// Virtual clock
+inline std::atomic<uint64_t> nativeMicros{0};
+
+inline uint32_t micros() {
+  return (uint32_t)nativeMicros.load();
+}
+
+inline uint32_t millis() {
+  return (uint32_t)(nativeMicros.load() / 1000);
+}
+
+inline void delay(uint32_t ms) {
+  nativeMicros += (uint64_t)ms * 1000;
+  std::this_thread::yield();
+}
+
+inline void delayMicroseconds(uint32_t us) {
+  nativeMicros += us;
+}
+
+inline void yield() {
+  std::this_thread::yield();
+}
+
+// Pins, reads go to the test's hook if it set one, inputs read HIGH otherwise
+inline int (*nativeDigitalRead)(uint8_t pin) = NULL;
+inline uint16_t nativeAnalogMilliVolts = 2000;
+
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+
+inline void digitalWrite(uint8_t pin, uint8_t val) {}
+
+inline int digitalRead(uint8_t pin) {
+  return nativeDigitalRead != NULL ? nativeDigitalRead(pin) : HIGH;
+}
+
+inline uint32_t analogReadMilliVolts(uint8_t pin) {
+  return nativeAnalogMilliVolts;
+}
+
+inline uint32_t digitalPinToBitMask(uint8_t pin) {
+  return 1UL << (pin & 31);
+}
+
+class String : public std::string {
+  public:
+    String(const char* s = "") : std::string(s != NULL ? s : "") {}
+    String(const std::string& s) : std::string(s) {}
+    unsigned int length() const {
+      return size();
+    }
+    char charAt(unsigned int index) const {
+      return index < size() ? at(index) : 0;
+    }
+    void toCharArray(char* buf, unsigned int bufsize) const {
+      if (bufsize == 0) {
+        return;
+      }
+      strncpy(buf, c_str(), bufsize - 1);
+      buf[bufsize - 1] = '\0';
+    }
+};
+
+class __FlashStringHelper;
+
+#include "Print.h"
+
+// Serial goes to stdout
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long baud) {}
+    size_t write(uint8_t c) override {
+      return fwrite(&c, 1, 1, stdout);
+    }
+    size_t write(const uint8_t* buffer, size_t size) override {
+      return fwrite(buffer, 1, size, stdout);
+    }
+};
+
+inline HardwareSerial Serial;
+
+// FreeRTOS, each task is a detached thread with its own notification count
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xFFFFFFFF
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (ms)
+
+struct NativeTask {
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t count = 0;
+};
+
+typedef NativeTask* TaskHandle_t;
+typedef std::mutex* SemaphoreHandle_t;
+
+inline thread_local NativeTask* nativeCurrentTask = NULL;
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+  if (nativeCurrentTask == NULL) {
+    nativeCurrentTask = new NativeTask;
+  }
+  return nativeCurrentTask;
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(void (*task)(void*), const char* name,
+                                          uint32_t stackDepth, void* params,
+                                          UBaseType_t priority,
+                                          TaskHandle_t* created,
+                                          BaseType_t coreID) {
+  NativeTask* handle = new NativeTask;
+  if (created != NULL) {
+    *created = handle;
+  }
+  std::thread([=]() {
+    nativeCurrentTask = handle;
+    task(params);
+  }).detach();
+  return pdPASS;
+}
+
+inline void vTaskDelete(TaskHandle_t task) {}
+
+inline void vTaskDelay(TickType_t ticks) {
+  delay(ticks);
+}
+
+inline void taskYIELD() {
+  std::this_thread::yield();
+}
+
+inline void xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(task->mutex);
+  task->count++;
+  task->notified.notify_all();
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit,
+                                 TickType_t ticksToWait) {
+  NativeTask* task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lock(task->mutex);
+  task->notified.wait(lock, [task]() { return task->count > 0; });
+  const uint32_t count = task->count;
+  task->count = clearCountOnExit ? 0 : count - 1;
+  return count;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return new std::mutex;
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore,
+                                 TickType_t ticksToWait) {
+  semaphore->lock();
+  return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  semaphore->unlock();
+  return pdTRUE;
+}
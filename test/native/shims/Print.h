@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+class String;
+
+class Print {
+  public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+      size_t n = 0;
+      while (size--) {
+        n += write(*buffer++);
+      }
+      return n;
+    }
+    size_t write(const char* str) {
+      return str == NULL ? 0 : write((const uint8_t*)str, strlen(str));
+    }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+      char buf[256];
+      va_list args;
+      va_start(args, format);
+      const int length = vsnprintf(buf, sizeof(buf), format, args);
+      va_end(args);
+      if (length < 0) {
+        return 0;
+      }
+      return write((const uint8_t*)buf,
+                   (size_t)length < sizeof(buf) ? length : sizeof(buf) - 1);
+    }
+
+    size_t print(const char* str) {
+      return write(str);
+    }
+    size_t print(const String& str);
+    size_t print(char c) {
+      return write((uint8_t)c);
+    }
+    size_t print(int n, int base = 10) {
+      return print((long)n, base);
+    }
+    size_t print(unsigned int n, int base = 10) {
+      return print((unsigned long)n, base);
+    }
+    size_t print(long n, int base = 10) {
+      return base == 16 ? printf("%lX", n) : printf("%ld", n);
+    }
+    size_t print(unsigned long n, int base = 10) {
+      return base == 16 ? printf("%lX", n) : printf("%lu", n);
+    }
+    size_t print(double n, int digits = 2) {
+      return printf("%.*f", digits, n);
+    }
+
+    size_t println() {
+      return write("\r\n");
+    }
+    template <typename T>
+    size_t println(T value) {
+      return print(value) + println();
+    }
+    template <typename T>
+    size_t println(T value, int format) {
+      return print(value, format) + println();
+    }
+};
+
+inline size_t Print::print(const String& str) {
+  return write(str.c_str());
+}
@@ -0,0 +1,155 @@
+// DateTime and TimeSpan as RTClib has them, and an RTC_DS3231 that holds a
+// time set by the test instead of counting, so screens showing it render the
+// same on every run.
+
+#pragma once
+
+#include <Arduino.h>
+
+class TimeSpan {
+  public:
+    TimeSpan(int32_t seconds = 0) : seconds(seconds) {}
+    TimeSpan(int16_t days, int8_t hours, int8_t minutes, int8_t seconds)
+        : seconds((int32_t)days * 86400L + (int32_t)hours * 3600 +
+                  (int32_t)minutes * 60 + seconds) {}
+
+    int32_t totalseconds() const {
+      return this->seconds;
+    }
+
+  private:
+    int32_t seconds;
+};
+
+class DateTime {
+  public:
+    DateTime(uint32_t t = 946684800) {
+      int64_t days = t / 86400;
+      const uint32_t secs = t % 86400;
+      this->hh = secs / 3600;
+      this->mm = secs / 60 % 60;
+      this->ss = secs % 60;
+
+      // Howard Hinnant's civil_from_days
+      days += 719468;
+      const int64_t era = days / 146097;
+      const uint32_t doe = days - era * 146097;
+      const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+      const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+      const uint32_t mp = (5 * doy + 2) / 153;
+      this->d = doy - (153 * mp + 2) / 5 + 1;
+      this->m = mp < 10 ? mp + 3 : mp - 9;
+      const int64_t year = yoe + era * 400 + (this->m <= 2);
+      this->yOff = year - 2000;
+    }
+    DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour = 0,
+             uint8_t min = 0, uint8_t sec = 0)
+        : yOff(year >= 2000 ? year - 2000 : year), m(month), d(day), hh(hour),
+          mm(min), ss(sec) {}
+
+    bool isValid() const {
+      if (this->yOff >= 100) {
+        return false;
+      }
+      const DateTime other(this->unixtime());
+      return this->yOff == other.yOff && this->m == other.m &&
+             this->d == other.d && this->hh == other.hh &&
+             this->mm == other.mm && this->ss == other.ss;
+    }
+
+    uint16_t year() const {
+      return 2000U + this->yOff;
+    }
+    uint8_t month() const {
+      return this->m;
+    }
+    uint8_t day() const {
+      return this->d;
+    }
+    uint8_t hour() const {
+      return this->hh;
+    }
+    uint8_t minute() const {
+      return this->mm;
+    }
+    uint8_t second() const {
+      return this->ss;
+    }
+
+    uint32_t unixtime() const {
+      // Howard Hinnant's days_from_civil
+      const int64_t y = 2000 + this->yOff - (this->m <= 2);
+      const int64_t era = y / 400;
+      const uint32_t yoe = y - era * 400;
+      const uint32_t doy =
+          (153 * (this->m > 2 ? this->m - 3 : this->m + 9) + 2) / 5 + this->d -
+          1;
+      const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+      const int64_t days = era * 146097 + doe - 719468;
+      return days * 86400 + this->hh * 3600 + this->mm * 60 + this->ss;
+    }
+
+    // Replaces YYYY, MM, DD, hh, mm and ss in the buffer with the fields
+    char* toString(char* buffer) const {
+      for (size_t i = 0; buffer[i] != '\0'; i++) {
+        char* p = buffer + i;
+        if (strncmp(p, "YYYY", 4) == 0) {
+          char year[5];
+          snprintf(year, sizeof(year), "%04u", this->year());
+          memcpy(p, year, 4);
+          i += 3;
+          continue;
+        }
+        const char* fields[] = {"MM", "DD", "hh", "mm", "ss"};
+        const uint8_t values[] = {this->m, this->d, this->hh, this->mm,
+                                  this->ss};
+        for (uint8_t f = 0; f < 5; f++) {
+          if (strncmp(p, fields[f], 2) == 0) {
+            p[0] = '0' + values[f] / 10;
+            p[1] = '0' + values[f] % 10;
+            i++;
+            break;
+          }
+        }
+      }
+      return buffer;
+    }
+
+    DateTime operator+(const TimeSpan& span) const {
+      return DateTime(this->unixtime() + span.totalseconds());
+    }
+    DateTime operator-(const TimeSpan& span) const {
+      return DateTime(this->unixtime() - span.totalseconds());
+    }
+    TimeSpan operator-(const DateTime& right) const {
+      return TimeSpan((int32_t)(this->unixtime() - right.unixtime()));
+    }
+    bool operator==(const DateTime& right) const {
+      return this->unixtime() == right.unixtime();
+    }
+    bool operator!=(const DateTime& right) const {
+      return !(*this == right);
+    }
+
+  private:
+    uint8_t yOff, m, d, hh, mm, ss;
+};
+
+class RTC_DS3231 {
+  public:
+    bool begin() {
+      return true;
+    }
+    bool lostPower() {
+      return false;
+    }
+    void adjust(const DateTime& dt) {
+      this->time = dt;
+    }
+    DateTime now() {
+      return this->time;
+    }
+
+  private:
+    DateTime time = DateTime(2023, 1, 1, 12, 0, 0);
+};
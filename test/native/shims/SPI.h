@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Arduino.h>
+
+class SPISettings {
+  public:
+    SPISettings(uint32_t clock = 1000000, uint8_t bitOrder = MSBFIRST,
+                uint8_t dataMode = SPI_MODE0) {}
+};
+
+class SPIClass {
+  public:
+    void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1,
+               int8_t ss = -1) {}
+    void end() {}
+    void beginTransaction(SPISettings settings) {}
+    void endTransaction() {}
+    void setFrequency(uint32_t freq) {}
+    uint8_t transfer(uint8_t data) {
+      return 0;
+    }
+};
+
+inline SPIClass SPI;
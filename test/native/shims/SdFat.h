@@ -0,0 +1,249 @@
+// The parts of SdFat the libraries use, backed by a directory on the host.
+// Paths on the "card" are relative to nativeSdRoot. Directory entries are
+// listed in name order, and a file's dirIndex() is its position in that list.
+
+#pragma once
+
+#include <Arduino.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#ifndef O_READ
+#define O_READ O_RDONLY
+#endif
+
+#ifndef O_WRITE
+#define O_WRITE O_WRONLY
+#endif
+
+typedef int oflag_t;
+
+inline std::string nativeSdRoot = ".";
+
+class FsFile {
+  public:
+    operator bool() const {
+      return this->isOpen();
+    }
+    bool isOpen() const {
+      return this->fd >= 0 || this->directory;
+    }
+    bool isDir() const {
+      return this->directory;
+    }
+    bool isFile() const {
+      return this->fd >= 0;
+    }
+    bool isHidden() const {
+      return false;
+    }
+    uint8_t getError() const {
+      return this->error;
+    }
+
+    bool open(const char* path, oflag_t oflag = O_RDONLY) {
+      this->close();
+      this->path = nativeSdRoot + (path[0] == '/' ? "" : "/") + path;
+      while (this->path.size() > 1 && this->path.back() == '/') {
+        this->path.pop_back();
+      }
+
+      struct stat info;
+      if (stat(this->path.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+        DIR* dir = opendir(this->path.c_str());
+        if (dir == NULL) {
+          return false;
+        }
+        this->entries.clear();
+        while (struct dirent* entry = readdir(dir)) {
+          if (strcmp(entry->d_name, ".") != 0 &&
+              strcmp(entry->d_name, "..") != 0) {
+            this->entries.push_back(entry->d_name);
+          }
+        }
+        closedir(dir);
+        std::sort(this->entries.begin(), this->entries.end());
+        this->directory = true;
+        this->next = 0;
+        return true;
+      }
+
+      this->fd = ::open(this->path.c_str(), oflag, 0644);
+      return this->fd >= 0;
+    }
+    bool open(FsFile* dir, uint32_t index, oflag_t oflag = O_RDONLY) {
+      this->close();
+      if (dir == NULL || !dir->directory || index >= dir->entries.size()) {
+        return false;
+      }
+      const std::string path =
+          dir->path.substr(nativeSdRoot.size()) + "/" + dir->entries[index];
+      if (!this->open(path.c_str(), oflag)) {
+        return false;
+      }
+      this->index = index;
+      return true;
+    }
+    bool openNext(FsFile* dir, oflag_t oflag = O_RDONLY) {
+      this->close();
+      if (dir == NULL || !dir->directory) {
+        return false;
+      }
+      while (dir->next < dir->entries.size()) {
+        if (this->open(dir, dir->next++, oflag)) {
+          return true;
+        }
+      }
+      return false;
+    }
+    bool close() {
+      if (this->fd >= 0) {
+        ::close(this->fd);
+      }
+      this->fd = -1;
+      this->directory = false;
+      this->entries.clear();
+      return true;
+    }
+
+    void rewindDirectory() {
+      this->next = 0;
+    }
+    uint32_t dirIndex() const {
+      return this->index;
+    }
+    size_t getName(char* name, size_t size) {
+      const std::string base = this->path.substr(this->path.rfind('/') + 1);
+      if (size == 0 || base.size() >= size) {
+        if (size > 0) {
+          name[0] = '\0';
+        }
+        return 0;
+      }
+      strcpy(name, base.c_str());
+      return base.size();
+    }
+    bool getModifyDateTime(uint16_t* pdate, uint16_t* ptime) {
+      struct stat info;
+      if (stat(this->path.c_str(), &info) != 0) {
+        return false;
+      }
+      struct tm t;
+      gmtime_r(&info.st_mtime, &t);
+      *pdate = ((t.tm_year - 80) << 9) | ((t.tm_mon + 1) << 5) | t.tm_mday;
+      *ptime = (t.tm_hour << 11) | (t.tm_min << 5) | (t.tm_sec >> 1);
+      return true;
+    }
+
+    int read() {
+      uint8_t b;
+      return this->read(&b, 1) == 1 ? b : -1;
+    }
+    int read(void* buf, size_t count) {
+      const ssize_t n = ::read(this->fd, buf, count);
+      if (n < 0) {
+        this->error = 1;
+      }
+      return (int)n;
+    }
+    size_t write(uint8_t b) {
+      return this->write(&b, 1);
+    }
+    size_t write(const void* buf, size_t count) {
+      const ssize_t n = ::write(this->fd, buf, count);
+      if (n < 0 || (size_t)n != count) {
+        this->error = 1;
+        return 0;
+      }
+      return count;
+    }
+    bool seek(uint64_t position) {
+      if (position > this->fileSize()) {
+        return false;
+      }
+      return lseek(this->fd, position, SEEK_SET) == (off_t)position;
+    }
+    bool seekSet(uint64_t position) {
+      return this->seek(position);
+    }
+    uint64_t curPosition() const {
+      return lseek(this->fd, 0, SEEK_CUR);
+    }
+    uint64_t position() const {
+      return this->curPosition();
+    }
+    uint64_t fileSize() const {
+      struct stat info;
+      return fstat(this->fd, &info) == 0 ? info.st_size : 0;
+    }
+    uint64_t size() const {
+      return this->fileSize();
+    }
+    int available() const {
+      return (int)(this->fileSize() - this->curPosition());
+    }
+    bool truncate(uint64_t length) {
+      if (ftruncate(this->fd, length) != 0) {
+        return false;
+      }
+      if (this->curPosition() > length) {
+        lseek(this->fd, length, SEEK_SET);
+      }
+      return true;
+    }
+    bool truncate() {
+      return this->truncate(this->curPosition());
+    }
+    bool sync() {
+      return true;
+    }
+    void flush() {}
+
+  private:
+    int fd = -1;
+    bool directory = false;
+    uint8_t error = 0;
+    std::string path;
+    std::vector<std::string> entries;
+    size_t next = 0;
+    uint32_t index = 0;
+};
+
+class SdFs {
+  public:
+    bool begin(uint8_t csPin = 0) {
+      return true;
+    }
+    FsFile open(const char* path, oflag_t oflag = O_RDONLY) {
+      FsFile file;
+      file.open(path, oflag);
+      return file;
+    }
+    bool exists(const char* path) {
+      struct stat info;
+      return stat(this->hostPath(path).c_str(), &info) == 0;
+    }
+    bool mkdir(const char* path, bool pFlag = true) {
+      return ::mkdir(this->hostPath(path).c_str(), 0755) == 0;
+    }
+    bool remove(const char* path) {
+      return ::unlink(this->hostPath(path).c_str()) == 0;
+    }
+    bool rmdir(const char* path) {
+      return ::rmdir(this->hostPath(path).c_str()) == 0;
+    }
+    bool rename(const char* oldPath, const char* newPath) {
+      return ::rename(this->hostPath(oldPath).c_str(),
+                      this->hostPath(newPath).c_str()) == 0;
+    }
+
+  private:
+    std::string hostPath(const char* path) {
+      return nativeSdRoot + (path[0] == '/' ? "" : "/") + path;
+    }
+};
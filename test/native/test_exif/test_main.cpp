@@ -0,0 +1,319 @@
+#include <Exif.h>
+#include <unity.h>
+
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+// A capture as ArduCamera writes one, the EXIF header and then the camera's
+// JPEG without its SOI. The photo is made with the thumbnail encoder, at the
+// camera's QVGA size.
+const char* PHOTO_PATH = "/photo.jpg";
+const char* PLAIN_PATH = "/plain.jpg";
+const uint16_t PHOTO_WIDTH = 320;
+const uint16_t PHOTO_HEIGHT = 240;
+
+const char DATE_TIME[] = "2026:10:19 12:34:56";
+
+SdFs sd;
+Exif exif;
+JPEGDEC decoder;
+
+static std::vector<uint8_t> encoded;
+
+// The APP1 segment of a file, parsed without anything from Exif.cpp
+struct TiffEntry {
+    uint16_t type;
+    uint32_t count;
+    // Where the value is, in the entry if it fits and at its offset if not
+    uint32_t valuePosition;
+};
+
+struct ExifFile {
+    std::vector<uint8_t> data;
+    uint32_t tiff;
+    uint32_t segmentEnd;
+    bool bigEndian;
+};
+
+static bool writeEncoded(const uint8_t* data, size_t length, void* param) {
+  encoded.insert(encoded.end(), data, data + length);
+  return true;
+}
+
+static bool makeJPEG(uint16_t width, uint16_t height) {
+  JPEGEncoder encoder;
+  encoded.clear();
+  if (!encoder.begin(width, height, 80, writeEncoded)) {
+    return false;
+  }
+  uint16_t row[JPEG_ENCODER_MAX_WIDTH];
+  for (uint16_t y = 0; y < height; y++) {
+    for (uint16_t x = 0; x < width; x++) {
+      row[x] = (x * 31 / width) << 11 | (y * 63 / height) << 5 | 0x0F;
+    }
+    if (!encoder.addRow(row)) {
+      encoder.end();
+      return false;
+    }
+  }
+  return encoder.finish();
+}
+
+static ExifCaptureInfo captureInfo() {
+  ExifCaptureInfo info;
+  memset(&info, 0, sizeof(info));
+  memcpy(info.dateTime, DATE_TIME, sizeof(DATE_TIME));
+  info.lightSource = 3;   // Tungsten
+  info.whiteBalance = 1;  // Manual
+  info.contrast = 2;      // Hard
+  info.saturation = 1;    // Low
+  const uint8_t makerNote[EXIF_MAKER_NOTE_BYTES] = {4, 1, 3, 2, 0};
+  memcpy(info.makerNote, makerNote, sizeof(makerNote));
+  return info;
+}
+
+static bool writePhoto(const char* path) {
+  if (!makeJPEG(PHOTO_WIDTH, PHOTO_HEIGHT)) {
+    return false;
+  }
+  FsFile file = sd.open(path, O_WRONLY | O_CREAT | O_TRUNC);
+  if (!file) {
+    return false;
+  }
+  const ExifCaptureInfo info = captureInfo();
+  uint32_t headerBytes = 0;
+  const bool ok =
+      Exif::writeHeader(&file, &info, &headerBytes) &&
+      headerBytes == file.curPosition() &&
+      file.write(encoded.data() + 2, encoded.size() - 2) == encoded.size() - 2;
+  return file.close() && ok;
+}
+
+static bool readFile(const char* path, std::vector<uint8_t>* data) {
+  FILE* file = fopen((nativeSdRoot + path).c_str(), "rb");
+  if (file == NULL) {
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  data->clear();
+  while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+    data->insert(data->end(), buf, buf + n);
+  }
+  fclose(file);
+  return true;
+}
+
+static uint32_t value(const ExifFile& file, uint32_t position, uint8_t bytes) {
+  uint32_t result = 0;
+  for (uint8_t i = 0; i < bytes; i++) {
+    const uint8_t byte =
+        file.data[position + (file.bigEndian ? i : bytes - 1 - i)];
+    result = result << 8 | byte;
+  }
+  return result;
+}
+
+// The first segment has to be an EXIF APP1 with a TIFF header in it
+static void parse(const char* path, ExifFile* file) {
+  TEST_ASSERT_TRUE(readFile(path, &file->data));
+  const std::vector<uint8_t>& data = file->data;
+  TEST_ASSERT_TRUE(data.size() > 2 + 4 + 6 + 8);
+  TEST_ASSERT_EQUAL_HEX8(0xFF, data[0]);
+  TEST_ASSERT_EQUAL_HEX8(0xD8, data[1]);
+  TEST_ASSERT_EQUAL_HEX8(0xFF, data[2]);
+  TEST_ASSERT_EQUAL_HEX8(0xE1, data[3]);
+  TEST_ASSERT_EQUAL_MEMORY("Exif\0\0", &data[6], 6);
+  file->segmentEnd = 4 + (data[4] << 8 | data[5]);
+  TEST_ASSERT_TRUE(file->segmentEnd < data.size());
+  file->tiff = EXIF_TIFF_START;
+  TEST_ASSERT_TRUE(data[12] == data[13] && (data[12] == 'M' || data[12] == 'I'));
+  file->bigEndian = data[12] == 'M';
+  TEST_ASSERT_EQUAL(42, value(*file, file->tiff + 2, 2));
+}
+
+static uint32_t ifdPosition(const ExifFile& file, uint32_t offset) {
+  TEST_ASSERT_TRUE(offset > 0);
+  TEST_ASSERT_TRUE(file.tiff + offset + 2 <= file.segmentEnd);
+  return file.tiff + offset;
+}
+
+// Offset of the IFD after this one, 0 if it is the last
+static uint32_t nextIFD(const ExifFile& file, uint32_t offset) {
+  const uint32_t position = ifdPosition(file, offset);
+  const uint16_t entries = value(file, position, 2);
+  return value(file, position + 2 + entries * 12, 4);
+}
+
+static bool findEntry(const ExifFile& file, uint32_t offset, uint16_t tag,
+                      TiffEntry* entry) {
+  const uint8_t typeSizes[] = {0, 1, 1, 2, 4, 8, 1, 1, 2, 4, 8};
+  const uint32_t position = ifdPosition(file, offset);
+  const uint16_t entries = value(file, position, 2);
+  TEST_ASSERT_TRUE(position + 2 + entries * 12 + 4 <= file.segmentEnd);
+  uint16_t lastTag = 0;
+  for (uint16_t i = 0; i < entries; i++) {
+    const uint32_t entryPosition = position + 2 + i * 12;
+    const uint16_t entryTag = value(file, entryPosition, 2);
+    // Readers may stop looking once they are past the tag
+    TEST_ASSERT_TRUE_MESSAGE(entryTag > lastTag, "Tags are not in order");
+    lastTag = entryTag;
+    if (entryTag != tag) {
+      continue;
+    }
+    entry->type = value(file, entryPosition + 2, 2);
+    entry->count = value(file, entryPosition + 4, 4);
+    TEST_ASSERT_TRUE(entry->type > 0 && entry->type < sizeof(typeSizes));
+    const uint32_t size = typeSizes[entry->type] * entry->count;
+    entry->valuePosition = size <= 4
+                               ? entryPosition + 8
+                               : file.tiff + value(file, entryPosition + 8, 4);
+    TEST_ASSERT_TRUE(entry->valuePosition + size <= file.segmentEnd);
+    return true;
+  }
+  return false;
+}
+
+static std::string ascii(const ExifFile& file, uint32_t offset, uint16_t tag) {
+  TiffEntry entry;
+  TEST_ASSERT_TRUE(findEntry(file, offset, tag, &entry));
+  TEST_ASSERT_EQUAL(2, entry.type);
+  // ASCII values count their terminator
+  TEST_ASSERT_EQUAL(0, file.data[entry.valuePosition + entry.count - 1]);
+  return std::string((const char*)&file.data[entry.valuePosition]);
+}
+
+static uint32_t number(const ExifFile& file, uint32_t offset, uint16_t tag,
+                       uint16_t type) {
+  TiffEntry entry;
+  TEST_ASSERT_TRUE(findEntry(file, offset, tag, &entry));
+  TEST_ASSERT_EQUAL(type, entry.type);
+  TEST_ASSERT_EQUAL(1, entry.count);
+  return value(file, entry.valuePosition, type == 3 ? 2 : 4);
+}
+
+static std::vector<uint8_t> undefined(const ExifFile& file, uint32_t offset,
+                                      uint16_t tag) {
+  TiffEntry entry;
+  TEST_ASSERT_TRUE(findEntry(file, offset, tag, &entry));
+  TEST_ASSERT_EQUAL(7, entry.type);
+  return std::vector<uint8_t>(
+      file.data.begin() + entry.valuePosition,
+      file.data.begin() + entry.valuePosition + entry.count);
+}
+
+void setUp() {
+  TEST_ASSERT_TRUE(writePhoto(PHOTO_PATH));
+}
+
+void tearDown() {}
+
+void test_header_is_followed_by_the_photo() {
+  ExifFile file;
+  parse(PHOTO_PATH, &file);
+  // Straight into the camera's own segments, with nothing lost in between
+  TEST_ASSERT_EQUAL_HEX8(0xFF, file.data[file.segmentEnd]);
+  TEST_ASSERT_EQUAL_MEMORY(encoded.data() + 2, &file.data[file.segmentEnd],
+                           encoded.size() - 2);
+  TEST_ASSERT_EQUAL(file.segmentEnd + encoded.size() - 2, file.data.size());
+}
+
+void test_ifd0_fields() {
+  ExifFile file;
+  parse(PHOTO_PATH, &file);
+  const uint32_t ifd0 = value(file, file.tiff + 4, 4);
+  TEST_ASSERT_EQUAL_STRING(EXIF_MAKE, ascii(file, ifd0, 0x010F).c_str());
+  TEST_ASSERT_EQUAL_STRING(EXIF_MODEL, ascii(file, ifd0, 0x0110).c_str());
+  TEST_ASSERT_EQUAL(1, number(file, ifd0, 0x0112, 3));
+  TEST_ASSERT_EQUAL_STRING(DATE_TIME, ascii(file, ifd0, 0x0132).c_str());
+  TEST_ASSERT_TRUE(number(file, ifd0, 0x8769, 4) > 0);
+  // No IFD1 until there is a thumbnail
+  TEST_ASSERT_EQUAL(0, nextIFD(file, ifd0));
+}
+
+void test_exif_ifd_fields() {
+  ExifFile file;
+  parse(PHOTO_PATH, &file);
+  const uint32_t ifd0 = value(file, file.tiff + 4, 4);
+  const uint32_t exifIFD = number(file, ifd0, 0x8769, 4);
+  const ExifCaptureInfo info = captureInfo();
+
+  const std::vector<uint8_t> version = undefined(file, exifIFD, 0x9000);
+  TEST_ASSERT_EQUAL(4, version.size());
+  TEST_ASSERT_EQUAL_MEMORY("0232", version.data(), 4);
+  TEST_ASSERT_EQUAL_STRING(DATE_TIME, ascii(file, exifIFD, 0x9003).c_str());
+  TEST_ASSERT_EQUAL(info.lightSource, number(file, exifIFD, 0x9208, 3));
+  const std::vector<uint8_t> makerNote = undefined(file, exifIFD, 0x927C);
+  TEST_ASSERT_EQUAL(EXIF_MAKER_NOTE_BYTES, makerNote.size());
+  TEST_ASSERT_EQUAL_MEMORY(info.makerNote, makerNote.data(),
+                           EXIF_MAKER_NOTE_BYTES);
+  TEST_ASSERT_EQUAL(info.whiteBalance, number(file, exifIFD, 0xA403, 3));
+  TEST_ASSERT_EQUAL(info.contrast, number(file, exifIFD, 0xA408, 3));
+  TEST_ASSERT_EQUAL(info.saturation, number(file, exifIFD, 0xA409, 3));
+  TEST_ASSERT_EQUAL(0, nextIFD(file, exifIFD));
+}
+
+void test_thumbnail_is_embedded() {
+  TEST_ASSERT_TRUE(exif.embedThumbnail(&decoder, PHOTO_PATH));
+
+  ExifFile file;
+  parse(PHOTO_PATH, &file);
+  const uint32_t ifd0 = value(file, file.tiff + 4, 4);
+  const uint32_t ifd1 = nextIFD(file, ifd0);
+  // Compression, 6 is JPEG
+  TEST_ASSERT_EQUAL(6, number(file, ifd1, 0x0103, 3));
+  const uint32_t offset = number(file, ifd1, 0x0201, 4);
+  const uint32_t length = number(file, ifd1, 0x0202, 4);
+  TEST_ASSERT_TRUE(file.tiff + offset + length <= file.segmentEnd);
+  const uint8_t* thumbnail = &file.data[file.tiff + offset];
+  TEST_ASSERT_EQUAL_HEX8(0xFF, thumbnail[0]);
+  TEST_ASSERT_EQUAL_HEX8(0xD8, thumbnail[1]);
+  TEST_ASSERT_EQUAL_HEX8(0xFF, thumbnail[length - 2]);
+  TEST_ASSERT_EQUAL_HEX8(0xD9, thumbnail[length - 1]);
+  // The rest of the header is left as it was
+  TEST_ASSERT_EQUAL_STRING(DATE_TIME, ascii(file, ifd0, 0x0132).c_str());
+
+  FsFile photo = sd.open(PHOTO_PATH);
+  ExifThumbnailInfo info;
+  TEST_ASSERT_TRUE(Exif::readThumbnailInfo(&photo, &info));
+  photo.close();
+  TEST_ASSERT_EQUAL(file.tiff + offset, info.offset);
+  TEST_ASSERT_EQUAL(length, info.length);
+  TEST_ASSERT_EQUAL(PHOTO_WIDTH, info.imageWidth);
+  TEST_ASSERT_EQUAL(PHOTO_HEIGHT, info.imageHeight);
+}
+
+void test_no_thumbnail_info_without_a_thumbnail() {
+  FsFile photo = sd.open(PHOTO_PATH);
+  ExifThumbnailInfo info;
+  TEST_ASSERT_FALSE(Exif::readThumbnailInfo(&photo, &info));
+  photo.close();
+
+  // Nor in a file without an EXIF segment at all
+  TEST_ASSERT_TRUE(makeJPEG(PHOTO_WIDTH, PHOTO_HEIGHT));
+  FsFile plain = sd.open(PLAIN_PATH, O_WRONLY | O_CREAT | O_TRUNC);
+  TEST_ASSERT_TRUE(plain);
+  TEST_ASSERT_EQUAL(encoded.size(), plain.write(encoded.data(), encoded.size()));
+  plain.close();
+  plain = sd.open(PLAIN_PATH);
+  TEST_ASSERT_FALSE(Exif::readThumbnailInfo(&plain, &info));
+  plain.close();
+}
+
+int main(int argc, char** argv) {
+  char root[] = "/tmp/test_exif_XXXXXX";
+  if (mkdtemp(root) == NULL) {
+    return 1;
+  }
+  nativeSdRoot = root;
+  exif.begin(&sd);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_header_is_followed_by_the_photo);
+  RUN_TEST(test_ifd0_fields);
+  RUN_TEST(test_exif_ifd_fields);
+  RUN_TEST(test_thumbnail_is_embedded);
+  RUN_TEST(test_no_thumbnail_info_without_a_thumbnail);
+  return UNITY_END();
+}
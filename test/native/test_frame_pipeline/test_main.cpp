@@ -0,0 +1,217 @@
+#include <FramePipeline.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+typedef FramePool<4, 256> TestPool;
+typedef TestPool::Handle TestHandle;
+
+const uint32_t STRESS_FRAMES = 200000;
+const uint32_t LATENCY_FRAMES = 20000;
+
+static uint32_t nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Every byte of a frame depends on its sequence number, so a frame that is
+// reused while still being read shows up as a mismatch
+static void fillFrame(TestHandle& frame, uint32_t sequence) {
+  const size_t length = 1 + sequence % TestPool::frameSize();
+  for (size_t i = 0; i < length; i++) {
+    frame.data()[i] = (uint8_t)(sequence * 31 + i);
+  }
+  frame.setLength(length);
+}
+
+static bool checkFrame(const TestHandle& frame, uint32_t sequence) {
+  if (frame.length() != 1 + sequence % TestPool::frameSize()) {
+    return false;
+  }
+  for (size_t i = 0; i < frame.length(); i++) {
+    if (frame.data()[i] != (uint8_t)(sequence * 31 + i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_pool_hands_out_every_frame_once() {
+  static TestPool pool;
+  TestHandle frames[4];
+  for (uint8_t i = 0; i < 4; i++) {
+    frames[i] = pool.acquire();
+    TEST_ASSERT_TRUE(frames[i].valid());
+  }
+  TEST_ASSERT_EQUAL(0, pool.available());
+  TEST_ASSERT_FALSE(pool.acquire().valid());
+
+  TestHandle copy = frames[2];
+  TEST_ASSERT_EQUAL(2, frames[2].refCount());
+  frames[2].release();
+  TEST_ASSERT_EQUAL(0, pool.available());
+  copy.release();
+  TEST_ASSERT_EQUAL(1, pool.available());
+
+  TestHandle moved = std::move(frames[0]);
+  TEST_ASSERT_FALSE(frames[0].valid());
+  TEST_ASSERT_EQUAL(1, moved.refCount());
+}
+
+void test_ring_keeps_order_and_capacity() {
+  SPSCRing<uint32_t, 8> ring;
+  TEST_ASSERT_EQUAL(7, ring.capacity());
+  for (uint32_t i = 0; i < 7; i++) {
+    TEST_ASSERT_TRUE(ring.push(i));
+  }
+  TEST_ASSERT_FALSE(ring.push(7));
+  TEST_ASSERT_EQUAL(7, ring.size());
+  uint32_t value = 0;
+  for (uint32_t i = 0; i < 7; i++) {
+    TEST_ASSERT_TRUE(ring.pop(value));
+    TEST_ASSERT_EQUAL(i, value);
+  }
+  TEST_ASSERT_FALSE(ring.pop(value));
+  TEST_ASSERT_TRUE(ring.empty());
+}
+
+// One thread fills frames and hands them over, the other checks and drops
+// them, the way the decode and push tasks use the pipeline
+void test_producer_consumer_stress() {
+  static TestPool pool;
+  static SPSCRing<TestHandle, 4> ring;
+  uint32_t bad = 0;
+
+  std::thread consumer([&]() {
+    for (uint32_t sequence = 0; sequence < STRESS_FRAMES; sequence++) {
+      TestHandle frame;
+      while (!ring.pop(frame)) {
+        std::this_thread::yield();
+      }
+      if (!checkFrame(frame, sequence)) {
+        bad++;
+      }
+    }
+  });
+  for (uint32_t sequence = 0; sequence < STRESS_FRAMES; sequence++) {
+    TestHandle frame = pool.acquireBlocking();
+    fillFrame(frame, sequence);
+    while (!ring.push(std::move(frame))) {
+      std::this_thread::yield();
+    }
+  }
+  consumer.join();
+
+  TEST_ASSERT_EQUAL(0, bad);
+  TEST_ASSERT_TRUE(ring.empty());
+  TEST_ASSERT_EQUAL(pool.count(), pool.available());
+}
+
+// The same frame is shared with two consumers, it must only go back to the
+// pool once both have let go of it
+void test_shared_frames_return_once() {
+  static TestPool pool;
+  static SPSCRing<TestHandle, 4> first;
+  static SPSCRing<TestHandle, 4> second;
+  uint32_t bad[2] = {0, 0};
+
+  auto consume = [&](SPSCRing<TestHandle, 4>* ring, uint32_t* errors) {
+    for (uint32_t sequence = 0; sequence < STRESS_FRAMES / 4; sequence++) {
+      TestHandle frame;
+      while (!ring->pop(frame)) {
+        std::this_thread::yield();
+      }
+      if (!checkFrame(frame, sequence)) {
+        (*errors)++;
+      }
+    }
+  };
+  std::thread firstConsumer(consume, &first, &bad[0]);
+  std::thread secondConsumer(consume, &second, &bad[1]);
+  for (uint32_t sequence = 0; sequence < STRESS_FRAMES / 4; sequence++) {
+    TestHandle frame = pool.acquireBlocking();
+    fillFrame(frame, sequence);
+    TestHandle copy = frame;
+    while (!first.push(std::move(frame))) {
+      std::this_thread::yield();
+    }
+    while (!second.push(std::move(copy))) {
+      std::this_thread::yield();
+    }
+  }
+  firstConsumer.join();
+  secondConsumer.join();
+
+  TEST_ASSERT_EQUAL(0, bad[0]);
+  TEST_ASSERT_EQUAL(0, bad[1]);
+  TEST_ASSERT_EQUAL(pool.count(), pool.available());
+}
+
+// Time from push() to the consumer's pop() returning the frame, with only
+// one frame in flight so queueing is not counted
+void test_handoff_latency_benchmark() {
+  static TestPool pool;
+  static SPSCRing<TestHandle, 4> ring;
+  static std::atomic<bool> consumed{false};
+  std::vector<uint32_t> latencies;
+  latencies.reserve(LATENCY_FRAMES);
+
+  std::thread consumer([&]() {
+    for (uint32_t i = 0; i < LATENCY_FRAMES; i++) {
+      TestHandle frame;
+      while (!ring.pop(frame)) {
+        std::this_thread::yield();
+      }
+      const uint32_t now = nowNanos();
+      uint32_t pushed = 0;
+      memcpy(&pushed, frame.data(), sizeof(pushed));
+      latencies.push_back(now - pushed);
+      frame.release();
+      consumed.store(true, std::memory_order_release);
+    }
+  });
+  for (uint32_t i = 0; i < LATENCY_FRAMES; i++) {
+    TestHandle frame = pool.acquireBlocking();
+    consumed.store(false, std::memory_order_relaxed);
+    const uint32_t now = nowNanos();
+    memcpy(frame.data(), &now, sizeof(now));
+    frame.setLength(sizeof(now));
+    while (!ring.push(std::move(frame))) {
+      std::this_thread::yield();
+    }
+    while (!consumed.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+  }
+  consumer.join();
+
+  std::sort(latencies.begin(), latencies.end());
+  char message[128];
+  snprintf(message, sizeof(message),
+           "Handoff latency over %u frames: median %u ns, p99 %u ns, "
+           "max %u ns",
+           LATENCY_FRAMES, latencies[latencies.size() / 2],
+           latencies[latencies.size() * 99 / 100], latencies.back());
+  TEST_MESSAGE(message);
+  TEST_ASSERT_EQUAL(LATENCY_FRAMES, latencies.size());
+  TEST_ASSERT_EQUAL(pool.count(), pool.available());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_pool_hands_out_every_frame_once);
+  RUN_TEST(test_ring_keeps_order_and_capacity);
+  RUN_TEST(test_producer_consumer_stress);
+  RUN_TEST(test_shared_frames_return_once);
+  RUN_TEST(test_handoff_latency_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,316 @@
+#include <ESP32_Camera_GUI.h>
+#include <unity.h>
+
+#include <libgen.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+// Same buttons as the camera, without debouncing since the script presses
+// them on exact reads
+const uint8_t UP_BUTTON = 25;
+const uint8_t SELECT_BUTTON = 33;
+const uint8_t DOWN_BUTTON = 32;
+const uint8_t SHUTTER_BUTTON = 26;
+const uint8_t BATT_PIN = 36;
+
+const uint32_t SPI_FREQUENCY_HZ = 27000000;
+// The GUI has to react to a press, or finish once its script has run out,
+// within this many reads
+const uint32_t MAX_READS_PER_STEP = 100000;
+
+TFT_eSPI tft;
+SdFs sd;
+RTC_DS3231 rtc;
+Button upButton(UP_BUTTON, 0);
+Button selectButton(SELECT_BUTTON, 0);
+Button downButton(DOWN_BUTTON, 0);
+Button shutterButton(SHUTTER_BUTTON, 0);
+
+ESP32CameraGUI* gui = NULL;
+
+// A screen is driven by a script of snapshots and button presses, run from
+// the GUI's own button reads. A snapshot is taken at the first read after the
+// previous step, when the screen is waiting for input. A press holds the pin
+// low until the GUI has drawn something in response.
+struct Step {
+    const char* snapshot;
+    uint8_t pin;
+};
+
+struct Cost {
+    std::string name;
+    uint32_t bytes;
+    uint32_t commands;
+    uint32_t windows;
+    uint32_t transactions;
+    uint32_t pixels;
+};
+
+static const Step* script = NULL;
+static size_t scriptLength = 0;
+static size_t scriptStep = 0;
+static int16_t pressedPin = -1;
+static uint64_t releasedPins = 0;
+static uint32_t pressedBytes = 0;
+static uint32_t readsInStep = 0;
+
+static std::vector<std::string> mismatches;
+static std::vector<Cost> costs;
+
+static std::string goldenDirectory() {
+  char file[] = __FILE__;
+  return std::string(dirname(file)) + "/golden";
+}
+
+static std::string outputDirectory() {
+  const std::string directory = std::string(P_tmpdir) + "/test_gui";
+  mkdir(directory.c_str(), 0755);
+  return directory;
+}
+
+static bool readFile(const std::string& path, std::string* contents) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == NULL) {
+    return false;
+  }
+  char buf[4096];
+  size_t n;
+  contents->clear();
+  while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+    contents->append(buf, n);
+  }
+  fclose(file);
+  return true;
+}
+
+// Compares the screen against its golden PNG, or replaces the golden when
+// UPDATE_GOLDEN is set. The traffic since the previous snapshot is what it
+// cost to get the screen to this state.
+static void snapshot(const char* name) {
+  costs.push_back({name, tft_native.bytes, tft_native.commands,
+                   tft_native.windows, tft_native.transactions,
+                   tft_native.pixels});
+  tft_native.resetCounters();
+
+  const std::string golden = goldenDirectory() + "/" + name + ".png";
+  if (getenv("UPDATE_GOLDEN") != NULL) {
+    tft_native.writePNG(golden.c_str(), 0, 0, tft.width(), tft.height());
+    return;
+  }
+
+  const std::string actual = outputDirectory() + "/" + name + ".actual.png";
+  tft_native.writePNG(actual.c_str(), 0, 0, tft.width(), tft.height());
+  std::string expected, got;
+  if (!readFile(golden, &expected) || !readFile(actual, &got) ||
+      expected != got) {
+    mismatches.push_back(std::string(name) + " (see " + actual + ")");
+  } else {
+    remove(actual.c_str());
+  }
+}
+
+static int scriptedRead(uint8_t pin) {
+  if (pressedPin >= 0 && tft_native.bytes != pressedBytes) {
+    releasedPins |= 1ULL << pressedPin;
+    pressedPin = -1;
+    readsInStep = 0;
+  }
+  if (pressedPin >= 0) {
+    if (++readsInStep == MAX_READS_PER_STEP) {
+      TEST_FAIL_MESSAGE("GUI did not react to a button press");
+    }
+    return pin == pressedPin ? LOW : HIGH;
+  }
+
+  // A button has to see its pin high again after a press, or its next press
+  // would not count as one
+  if (releasedPins & (1ULL << pin)) {
+    releasedPins &= ~(1ULL << pin);
+    return HIGH;
+  }
+
+  while (scriptStep < scriptLength && script[scriptStep].snapshot != NULL) {
+    snapshot(script[scriptStep++].snapshot);
+  }
+  if (scriptStep < scriptLength &&
+      !(releasedPins & (1ULL << script[scriptStep].pin))) {
+    pressedPin = script[scriptStep++].pin;
+    pressedBytes = tft_native.bytes;
+    readsInStep = 0;
+    return pin == pressedPin ? LOW : HIGH;
+  }
+
+  if (++readsInStep == MAX_READS_PER_STEP) {
+    TEST_FAIL_MESSAGE("GUI is still waiting for input after its script");
+  }
+  return HIGH;
+}
+
+static void runScript(const Step* steps, size_t count) {
+  script = steps;
+  scriptLength = count;
+  scriptStep = 0;
+  pressedPin = -1;
+  releasedPins = 0;
+  readsInStep = 0;
+  mismatches.clear();
+  tft_native.resetCounters();
+}
+
+static void checkScript() {
+  TEST_ASSERT_EQUAL_MESSAGE(scriptLength, scriptStep,
+                            "GUI returned before its script finished");
+  for (const std::string& mismatch : mismatches) {
+    TEST_MESSAGE(("Differs from golden: " + mismatch).c_str());
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(0, mismatches.size(),
+                            "Screens differ from their golden images");
+}
+
+static void makeFile(const std::string& path) {
+  FILE* file = fopen((nativeSdRoot + path).c_str(), "wb");
+  TEST_ASSERT_NOT_NULL(file);
+  fputs(path.c_str(), file);
+  fclose(file);
+}
+
+void setUp() {
+  // Buttons start released, whatever the previous test left them in
+  upButton = Button(UP_BUTTON, 0);
+  selectButton = Button(SELECT_BUTTON, 0);
+  downButton = Button(DOWN_BUTTON, 0);
+  shutterButton = Button(SHUTTER_BUTTON, 0);
+  nativeDigitalRead = scriptedRead;
+  tft.fillScreen(TFT_BLACK);
+  gui = new ESP32CameraGUI;
+  gui->begin(&tft, &sd, &rtc, &upButton, &downButton, &selectButton,
+             &shutterButton, BATT_PIN);
+}
+
+void tearDown() {
+  nativeDigitalRead = NULL;
+  delete gui;
+  gui = NULL;
+}
+
+void test_dialog() {
+  const Step steps[] = {{"dialog", 0}, {NULL, SELECT_BUTTON}};
+  runScript(steps, sizeof(steps) / sizeof(steps[0]));
+  gui->dialog("Hardware error", "Failed to initialize\nSD card!");
+  checkScript();
+}
+
+void test_menu() {
+  const char* title = "Camera settings";
+  const char* entries[] = {"Exit",           "Set light mode",
+                           "Set saturation", "Set brightness",
+                           "Set contrast",   "Set special effect",
+                           "Reset settings", "Set preview mode",
+                           "Toggle histogram", "Toggle focus peaking"};
+  const Step steps[] = {{"menu", 0},          {NULL, DOWN_BUTTON},
+                        {"menu_down", 0},     {NULL, UP_BUTTON},
+                        {NULL, UP_BUTTON},    {"menu_wrapped", 0},
+                        {NULL, SELECT_BUTTON}};
+  runScript(steps, sizeof(steps) / sizeof(steps[0]));
+  TEST_ASSERT_EQUAL(9, gui->menu(title, entries, 10));
+  checkScript();
+}
+
+void test_menu_with_selection() {
+  const char* title = "Set special effect";
+  const char* entries[] = {"Exit",    "Antique",    "Bluish",   "Greenish",
+                           "Reddish", "Monochrome", "Negative",
+                           "Negative monochrome",   "Normal"};
+  const Step steps[] = {{"menu_selection", 0}, {NULL, SELECT_BUTTON}};
+  runScript(steps, sizeof(steps) / sizeof(steps[0]));
+  TEST_ASSERT_EQUAL(8, gui->menu(title, entries, 9, 8));
+  checkScript();
+}
+
+void test_menu_scrolls() {
+  const char* title = "Months";
+  const char* entries[] = {"January", "February", "March",     "April",
+                           "May",     "June",     "July",      "August",
+                           "September", "October", "November", "December"};
+  const Step steps[] = {{"menu_scrollbar", 0}, {NULL, UP_BUTTON},
+                        {"menu_scrolled", 0},  {NULL, SELECT_BUTTON}};
+  runScript(steps, sizeof(steps) / sizeof(steps[0]));
+  TEST_ASSERT_EQUAL(11, gui->menu(title, entries, 12));
+  checkScript();
+}
+
+void test_file_explorer() {
+  char root[] = "/tmp/test_gui_sd_XXXXXX";
+  TEST_ASSERT_NOT_NULL(mkdtemp(root));
+  nativeSdRoot = root;
+  TEST_ASSERT_TRUE(sd.mkdir("/images"));
+  for (uint8_t i = 1; i <= 10; i++) {
+    char path[32];
+    snprintf(path, sizeof(path), "/images/IMG_%04u.JPG", i);
+    makeFile(path);
+  }
+  makeFile("/notes.txt");
+
+  // Into /images, which starts on "Up a folder", up past "Exit" to the last
+  // photo, then open and cancel the file options, which has to put back the
+  // list exactly as it was
+  const Step steps[] = {{"explorer", 0},
+                        {NULL, DOWN_BUTTON},
+                        {"explorer_down", 0},
+                        {NULL, SELECT_BUTTON},
+                        {"explorer_images", 0},
+                        {NULL, UP_BUTTON},
+                        {NULL, UP_BUTTON},
+                        {"explorer_scrolled", 0},
+                        {NULL, SHUTTER_BUTTON},
+                        {"explorer_options", 0},
+                        {NULL, SELECT_BUTTON},
+                        {"explorer_options_closed", 0},
+                        {NULL, SELECT_BUTTON}};
+  runScript(steps, sizeof(steps) / sizeof(steps[0]));
+  char result[64];
+  TEST_ASSERT_TRUE(gui->fileExplorer("/", result, sizeof(result)));
+  TEST_ASSERT_EQUAL_STRING("/images/IMG_0010.JPG", result);
+  checkScript();
+}
+
+// Bus traffic each screen took to draw, from nothing for the first snapshot
+// of a test and from the previous snapshot otherwise, with the time it takes
+// on the camera's SPI clock
+void test_cost_report() {
+  const std::string path = outputDirectory() + "/gui_cost.csv";
+  FILE* csv = fopen(path.c_str(), "w");
+  TEST_ASSERT_NOT_NULL(csv);
+  fprintf(csv, "Screen,Bytes,Commands,Windows,Transactions,Pixels,SPI time (us)\n");
+  for (const Cost& cost : costs) {
+    const uint32_t spiTime =
+        (uint64_t)cost.bytes * 8 * 1000000 / SPI_FREQUENCY_HZ;
+    fprintf(csv, "%s,%u,%u,%u,%u,%u,%u\n", cost.name.c_str(), cost.bytes,
+            cost.commands, cost.windows, cost.transactions, cost.pixels,
+            spiTime);
+    char message[160];
+    snprintf(message, sizeof(message),
+             "%-24s %6u bytes %4u windows %5u pixels %6u us", cost.name.c_str(),
+             cost.bytes, cost.windows, cost.pixels, spiTime);
+    TEST_MESSAGE(message);
+  }
+  fclose(csv);
+  TEST_MESSAGE(("Written to " + path).c_str());
+  TEST_ASSERT_TRUE(costs.size() > 0);
+}
+
+int main(int argc, char** argv) {
+  tft.begin();
+  tft.setRotation(1);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_dialog);
+  RUN_TEST(test_menu);
+  RUN_TEST(test_menu_with_selection);
+  RUN_TEST(test_menu_scrolls);
+  RUN_TEST(test_file_explorer);
+  RUN_TEST(test_cost_report);
+  return UNITY_END();
+}
@@ -0,0 +1,205 @@
+#include <JPEGDEC.h>
+#include <JPEGEncoder.h>
+#include <unity.h>
+
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+// The thumbnail size first, then sizes that leave partial blocks and strips,
+// then the widest image the encoder takes
+const uint16_t SIZES[][2] = {{160, 120}, {17, 9}, {1, 1}, {320, 240}};
+const uint8_t QUALITY = 90;
+// Peak signal to noise ratio a smooth image has to come back with. Chroma is
+// subsampled and the colours are RGB565, so this is not very high.
+const double MIN_PSNR = 30;
+
+const uint32_t BENCHMARK_ROUNDS = 50;
+
+JPEGDEC decoder;
+
+static std::vector<uint8_t> encoded;
+static std::vector<uint16_t> decoded;
+static uint16_t decodedWidth = 0;
+static uint16_t decodedHeight = 0;
+static size_t failAfterBytes = SIZE_MAX;
+
+static uint32_t nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static bool writeEncoded(const uint8_t* data, size_t length, void* param) {
+  if (encoded.size() + length > failAfterBytes) {
+    return false;
+  }
+  encoded.insert(encoded.end(), data, data + length);
+  return true;
+}
+
+// Blocks can reach past the edge of the image, only the pixels in it are kept
+static int drawDecoded(JPEGDRAW* pDraw) {
+  for (int32_t y = 0; y < pDraw->iHeight; y++) {
+    for (int32_t x = 0; x < pDraw->iWidth; x++) {
+      const int32_t imageX = pDraw->x + x;
+      const int32_t imageY = pDraw->y + y;
+      if (imageX < decodedWidth && imageY < decodedHeight) {
+        decoded[imageY * decodedWidth + imageX] =
+            pDraw->pPixels[y * pDraw->iWidth + x];
+      }
+    }
+  }
+  return 1;
+}
+
+// Gradients in every channel, like a photo of something out of focus. Every
+// size is a crop of the same scene, the widest the encoder takes.
+static std::vector<uint16_t> makeImage(uint16_t width, uint16_t height) {
+  std::vector<uint16_t> pixels(width * height);
+  for (uint16_t y = 0; y < height; y++) {
+    for (uint16_t x = 0; x < width; x++) {
+      const uint16_t r = x * 31 / 320;
+      const uint16_t g = y * 63 / 240;
+      const uint16_t b = 31 - (x + y) * 31 / 560;
+      pixels[y * width + x] = r << 11 | g << 5 | b;
+    }
+  }
+  return pixels;
+}
+
+static bool encode(const std::vector<uint16_t>& pixels, uint16_t width,
+                   uint16_t height, uint8_t quality) {
+  JPEGEncoder encoder;
+  encoded.clear();
+  if (!encoder.begin(width, height, quality, writeEncoded)) {
+    return false;
+  }
+  for (uint16_t y = 0; y < height; y++) {
+    if (!encoder.addRow(&pixels[y * width])) {
+      encoder.end();
+      return false;
+    }
+  }
+  return encoder.finish() && encoder.getBytesWritten() == encoded.size();
+}
+
+static bool decode() {
+  if (!decoder.openRAM(encoded.data(), encoded.size(), drawDecoded)) {
+    return false;
+  }
+  decodedWidth = decoder.getWidth();
+  decodedHeight = decoder.getHeight();
+  decoded.assign(decodedWidth * decodedHeight, 0);
+  decoder.setPixelType(RGB565_LITTLE_ENDIAN);
+  const int result = decoder.decode(0, 0, 0);
+  decoder.close();
+  return result == 1;
+}
+
+static double psnr(const std::vector<uint16_t>& expected,
+                   const std::vector<uint16_t>& actual) {
+  double error = 0;
+  for (size_t i = 0; i < expected.size(); i++) {
+    const int32_t channels[][2] = {
+        {(expected[i] >> 11) << 3, (actual[i] >> 11) << 3},
+        {((expected[i] >> 5) & 0x3F) << 2, ((actual[i] >> 5) & 0x3F) << 2},
+        {(expected[i] & 0x1F) << 3, (actual[i] & 0x1F) << 3}};
+    for (const int32_t* channel : channels) {
+      error += (channel[0] - channel[1]) * (channel[0] - channel[1]);
+    }
+  }
+  error /= expected.size() * 3;
+  return error == 0 ? INFINITY : 10 * log10(255.0 * 255.0 / error);
+}
+
+void setUp() {
+  failAfterBytes = SIZE_MAX;
+}
+
+void tearDown() {}
+
+void test_decodes_at_every_size() {
+  for (const uint16_t* size : SIZES) {
+    const std::vector<uint16_t> pixels = makeImage(size[0], size[1]);
+    TEST_ASSERT_TRUE(encode(pixels, size[0], size[1], QUALITY));
+    TEST_ASSERT_TRUE(decode());
+    TEST_ASSERT_EQUAL(size[0], decodedWidth);
+    TEST_ASSERT_EQUAL(size[1], decodedHeight);
+
+    const double quality = psnr(pixels, decoded);
+    char message[96];
+    snprintf(message, sizeof(message), "%ux%u: %u bytes, PSNR %.1f dB",
+             size[0], size[1], (unsigned)encoded.size(), quality);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE_MESSAGE(quality >= MIN_PSNR, message);
+  }
+}
+
+void test_lower_quality_is_smaller() {
+  const std::vector<uint16_t> pixels = makeImage(160, 120);
+  TEST_ASSERT_TRUE(encode(pixels, 160, 120, 90));
+  const size_t high = encoded.size();
+  TEST_ASSERT_TRUE(encode(pixels, 160, 120, 20));
+  TEST_ASSERT_TRUE(encoded.size() < high);
+  TEST_ASSERT_TRUE(decode());
+}
+
+void test_rejects_sizes_it_can_not_encode() {
+  JPEGEncoder encoder;
+  TEST_ASSERT_FALSE(encoder.begin(0, 120, QUALITY, writeEncoded));
+  TEST_ASSERT_FALSE(encoder.begin(160, 0, QUALITY, writeEncoded));
+  TEST_ASSERT_FALSE(encoder.begin(JPEG_ENCODER_MAX_WIDTH + 1, 120, QUALITY,
+                                  writeEncoded));
+}
+
+void test_missing_rows_fail() {
+  const std::vector<uint16_t> pixels = makeImage(17, 9);
+  JPEGEncoder encoder;
+  encoded.clear();
+  TEST_ASSERT_TRUE(encoder.begin(17, 9, QUALITY, writeEncoded));
+  for (uint16_t y = 0; y < 8; y++) {
+    TEST_ASSERT_TRUE(encoder.addRow(&pixels[y * 17]));
+  }
+  TEST_ASSERT_FALSE(encoder.finish());
+}
+
+void test_write_failure_stops_the_encode() {
+  const std::vector<uint16_t> pixels = makeImage(160, 120);
+  TEST_ASSERT_TRUE(encode(pixels, 160, 120, QUALITY));
+  // Past the headers, so it fails on a strip
+  failAfterBytes = encoded.size() / 2;
+  TEST_ASSERT_FALSE(encode(pixels, 160, 120, QUALITY));
+  failAfterBytes = 0;
+  TEST_ASSERT_FALSE(encode(pixels, 160, 120, QUALITY));
+}
+
+// Time to encode each size, and the rate in pixels. The host CPU is far
+// faster than the ESP32, so how it scales with the size is what carries over.
+void test_encode_rate() {
+  for (const uint16_t* size : SIZES) {
+    const std::vector<uint16_t> pixels = makeImage(size[0], size[1]);
+    const uint32_t start = nowNanos();
+    for (uint32_t i = 0; i < BENCHMARK_ROUNDS; i++) {
+      TEST_ASSERT_TRUE(encode(pixels, size[0], size[1], QUALITY));
+    }
+    const double elapsed = (nowNanos() - start) / 1e3 / BENCHMARK_ROUNDS;
+
+    char message[96];
+    snprintf(message, sizeof(message),
+             "%ux%u: %.1f us per image, %.2f Mpixels/s", size[0], size[1],
+             elapsed, size[0] * size[1] / elapsed);
+    TEST_MESSAGE(message);
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_decodes_at_every_size);
+  RUN_TEST(test_lower_quality_is_smaller);
+  RUN_TEST(test_rejects_sizes_it_can_not_encode);
+  RUN_TEST(test_missing_rows_fail);
+  RUN_TEST(test_write_failure_stops_the_encode);
+  RUN_TEST(test_encode_rate);
+  return UNITY_END();
+}
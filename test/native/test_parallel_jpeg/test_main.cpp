@@ -0,0 +1,267 @@
+#include <JPEGRenderer.h>
+#include <ParallelJPEG.h>
+#include <unity.h>
+
+#include <libgen.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Both files are 1280x1024 (the camera's SXGA size) and 4:2:0. restart.jpg
+// has a restart marker after every MCU row, plain.jpg has none, like the
+// files the OV2640 writes.
+const char* RESTART_PATH = "/restart.jpg";
+const char* PLAIN_PATH = "/plain.jpg";
+const uint16_t IMAGE_WIDTH = 1280;
+const uint16_t IMAGE_HEIGHT = 1024;
+
+const uint32_t BENCHMARK_ROUNDS = 10;
+
+TFT_eSPI tft;
+SdFs sd;
+JPEGRenderer renderer;
+ParallelJPEG parallel;
+JPEGDEC primary;
+FsFile jpegFile;
+
+static uint32_t nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void* JPEGOpen(const char* filename, int32_t* size) {
+  jpegFile = sd.open(filename);
+  *size = jpegFile.size();
+  return &jpegFile;
+}
+
+void JPEGClose(void* handle) {
+  jpegFile.close();
+}
+
+int32_t JPEGRead(JPEGFILE* handle, uint8_t* buffer, int32_t length) {
+  renderer.releaseBus();
+  return jpegFile.read(buffer, length);
+}
+
+int32_t JPEGSeek(JPEGFILE* handle, int32_t position) {
+  renderer.releaseBus();
+  return jpegFile.seek(position);
+}
+
+int JPEGDraw(JPEGDRAW* pDraw) {
+  return renderer.draw(pDraw);
+}
+
+static std::vector<uint16_t> screen() {
+  std::vector<uint16_t> pixels;
+  for (int32_t y = 0; y < tft.height(); y++) {
+    for (int32_t x = 0; x < tft.width(); x++) {
+      pixels.push_back(tft_native.getPixel(x, y));
+    }
+  }
+  return pixels;
+}
+
+// The whole file on the primary decoder alone, as the viewer does when
+// ParallelJPEG can not split it
+static int decodeSingle(const char* path, int16_t viewX, int16_t viewY,
+                        int options) {
+  if (!primary.open(path, JPEGOpen, JPEGClose, JPEGRead, JPEGSeek,
+                    JPEGDraw)) {
+    return 0;
+  }
+  primary.setPixelType(RGB565_BIG_ENDIAN);
+  renderer.setOrigin(viewX, viewY);
+  renderer.startFrame();
+  const int result = primary.decode(0, 0, options);
+  renderer.finishFrame();
+  renderer.setOrigin(0, 0);
+  primary.close();
+  return result;
+}
+
+// The band under the display at full scale, or the whole image at 1/8
+static int decodeParallel(const char* path, int16_t viewX, int16_t viewY,
+                          int options) {
+  primary.setPixelType(RGB565_BIG_ENDIAN);
+  renderer.setOrigin(viewX, viewY);
+  renderer.startFrame();
+  int result;
+  if (options == JPEG_SCALE_EIGHTH) {
+    result = parallel.decode(&primary, path, 0, 0, options);
+  } else {
+    result = parallel.decodeRegion(&primary, path, 0, 0, viewY, tft.height(),
+                                   options);
+  }
+  renderer.finishFrame();
+  renderer.setOrigin(0, 0);
+  return result;
+}
+
+void setUp() {
+  tft.fillScreen(TFT_BLACK);
+}
+
+void tearDown() {}
+
+void test_split_decode_matches_single_decoder() {
+  TEST_ASSERT_EQUAL(1, decodeSingle(RESTART_PATH, 0, 0, JPEG_SCALE_EIGHTH));
+  const std::vector<uint16_t> single = screen();
+  tft.fillScreen(TFT_BLACK);
+  TEST_ASSERT_EQUAL(1, decodeParallel(RESTART_PATH, 0, 0, JPEG_SCALE_EIGHTH));
+  TEST_ASSERT_TRUE(single == screen());
+}
+
+void test_region_decode_matches_single_decoder() {
+  const int16_t views[][2] = {{0, 0}, {560, 437}, {1120, 896}};
+  for (const int16_t* view : views) {
+    tft.fillScreen(TFT_BLACK);
+    TEST_ASSERT_EQUAL(1, decodeSingle(RESTART_PATH, view[0], view[1], 0));
+    const std::vector<uint16_t> single = screen();
+    tft.fillScreen(TFT_BLACK);
+    TEST_ASSERT_EQUAL(1, decodeParallel(RESTART_PATH, view[0], view[1], 0));
+    TEST_ASSERT_TRUE(single == screen());
+  }
+}
+
+void test_file_without_restart_markers_is_not_split() {
+  TEST_ASSERT_EQUAL(PARALLEL_JPEG_NOT_SPLIT,
+                    decodeParallel(PLAIN_PATH, 0, 0, JPEG_SCALE_EIGHTH));
+  // A region is still decoded, from the top of the file
+  TEST_ASSERT_EQUAL(1, decodeSingle(PLAIN_PATH, 80, 56, 0));
+  const std::vector<uint16_t> single = screen();
+  tft.fillScreen(TFT_BLACK);
+  TEST_ASSERT_EQUAL(1, decodeParallel(PLAIN_PATH, 80, 56, 0));
+  TEST_ASSERT_TRUE(single == screen());
+}
+
+// Time to get the image on the display with the primary decoder alone and
+// split over two tasks. The tasks are std::threads here, so the speedup
+// depends on the host having a second core free.
+static void benchmark(const char* name, int16_t viewX, int16_t viewY,
+                      int options) {
+  uint32_t start = nowNanos();
+  for (uint32_t i = 0; i < BENCHMARK_ROUNDS; i++) {
+    decodeSingle(RESTART_PATH, viewX, viewY, options);
+  }
+  const double single = (nowNanos() - start) / 1e6 / BENCHMARK_ROUNDS;
+
+  start = nowNanos();
+  for (uint32_t i = 0; i < BENCHMARK_ROUNDS; i++) {
+    decodeParallel(RESTART_PATH, viewX, viewY, options);
+  }
+  const double split = (nowNanos() - start) / 1e6 / BENCHMARK_ROUNDS;
+
+  char message[160];
+  snprintf(message, sizeof(message),
+           "%s: single decoder %.2f ms, parallel %.2f ms, %.2fx on %u cores",
+           name, single, split, single / split,
+           std::thread::hardware_concurrency());
+  TEST_MESSAGE(message);
+}
+
+// Pans over the whole image at 1:1 the way the viewer does, half a screen at
+// a time in reading order, checking every view against a full decode
+static void panWalk(const char* name, const char* path) {
+  const int32_t maxViewX = IMAGE_WIDTH - tft.width();
+  const int32_t maxViewY = IMAGE_HEIGHT - tft.height();
+  int32_t viewX = 0;
+  int32_t viewY = 0;
+  uint32_t steps = 0;
+  double total = 0;
+  double worst = 0;
+  while (true) {
+    tft.fillScreen(TFT_BLACK);
+    const uint32_t start = nowNanos();
+    TEST_ASSERT_EQUAL(1, decodeParallel(path, viewX, viewY, 0));
+    const double elapsed = (nowNanos() - start) / 1e6;
+    total += elapsed;
+    worst = max(worst, elapsed);
+    steps++;
+
+    const std::vector<uint16_t> split = screen();
+    tft.fillScreen(TFT_BLACK);
+    TEST_ASSERT_EQUAL(1, decodeSingle(path, viewX, viewY, 0));
+    TEST_ASSERT_TRUE(split == screen());
+
+    if (viewX < maxViewX) {
+      viewX = min(viewX + tft.width() / 2, maxViewX);
+    } else if (viewY < maxViewY) {
+      viewX = 0;
+      viewY = min(viewY + tft.height() / 2, maxViewY);
+    } else {
+      break;
+    }
+  }
+
+  char message[160];
+  snprintf(message, sizeof(message),
+           "%s: %u pans at 1:1, %.2f ms on average, %.2f ms at worst", name,
+           steps, total / steps, worst);
+  TEST_MESSAGE(message);
+}
+
+void test_pan_latency() {
+  panWalk("Restart markers", RESTART_PATH);
+  panWalk("No restart markers", PLAIN_PATH);
+}
+
+void test_speedup() {
+  benchmark("Whole image at 1/8", 0, 0, JPEG_SCALE_EIGHTH);
+  benchmark("1:1 band in the middle", (IMAGE_WIDTH - 160) / 2,
+            (IMAGE_HEIGHT - 128) / 2, 0);
+}
+
+// The card is a temporary directory with the fixtures copied in, since
+// decoding writes the band cache to it
+static bool copyFixture(const std::string& directory, const char* path) {
+  FILE* in = fopen((directory + path).c_str(), "rb");
+  if (in == NULL) {
+    return false;
+  }
+  FILE* out = fopen((nativeSdRoot + path).c_str(), "wb");
+  if (out == NULL) {
+    fclose(in);
+    return false;
+  }
+  char buf[4096];
+  size_t n;
+  bool ok = true;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    ok = ok && fwrite(buf, 1, n, out) == n;
+  }
+  fclose(in);
+  return fclose(out) == 0 && ok;
+}
+
+int main(int argc, char** argv) {
+  char file[] = __FILE__;
+  const std::string directory = dirname(file);
+  char root[] = "/tmp/test_parallel_jpeg_XXXXXX";
+  if (mkdtemp(root) == NULL) {
+    return 1;
+  }
+  nativeSdRoot = root;
+  if (!copyFixture(directory, RESTART_PATH) ||
+      !copyFixture(directory, PLAIN_PATH)) {
+    printf("Failed to copy the fixtures to %s\n", root);
+    return 1;
+  }
+
+  tft.begin();
+  tft.setRotation(1);
+  renderer.begin(&tft, true, false);
+  parallel.begin(&sd, &renderer);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_split_decode_matches_single_decoder);
+  RUN_TEST(test_region_decode_matches_single_decoder);
+  RUN_TEST(test_file_without_restart_markers_is_not_split);
+  RUN_TEST(test_pan_latency);
+  RUN_TEST(test_speedup);
+  return UNITY_END();
+}
@@ -0,0 +1,271 @@
+#include <TFT_eSPI.h>
+#include <unity.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+const uint32_t BENCHMARK_ROUNDS = 200;
+const uint32_t ATLAS_BYTES = 16384;
+
+TFT_eSPI tft;
+
+static uint32_t nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static void putInt32(std::vector<uint8_t>& vlw, uint32_t value) {
+  vlw.push_back(value >> 24);
+  vlw.push_back(value >> 16);
+  vlw.push_back(value >> 8);
+  vlw.push_back(value);
+}
+
+// A vlw font laid out like the ones the Processing sketch makes, with the
+// glyphs in code point order. Every glyph has its own alpha pattern, so a
+// lookup returning the wrong glyph draws different pixels.
+static std::vector<uint8_t> makeFont(const std::vector<uint16_t>& codes) {
+  const uint8_t width = 7, height = 10;
+  std::vector<uint8_t> vlw;
+  putInt32(vlw, codes.size());
+  putInt32(vlw, 11);  // Version
+  putInt32(vlw, 12);  // Size in points
+  putInt32(vlw, 0);
+  putInt32(vlw, 8);  // Ascent
+  putInt32(vlw, 2);  // Descent
+  for (uint16_t code : codes) {
+    putInt32(vlw, code);
+    putInt32(vlw, height);
+    putInt32(vlw, width);
+    putInt32(vlw, width + 1);  // xAdvance
+    putInt32(vlw, 8);          // dY
+    putInt32(vlw, 0);          // dX
+    putInt32(vlw, 0);
+  }
+  for (uint16_t code : codes) {
+    for (uint8_t y = 0; y < height; y++) {
+      for (uint8_t x = 0; x < width; x++) {
+        vlw.push_back((uint8_t)(code * 37 + y * 29 + x * 53));
+      }
+    }
+  }
+  const char name[] = "Test";
+  vlw.push_back(sizeof(name) - 1);
+  vlw.insert(vlw.end(), name, name + sizeof(name));
+  vlw.push_back(sizeof(name) - 1);
+  vlw.insert(vlw.end(), name, name + sizeof(name));
+  vlw.push_back(1);  // Smoothed
+  return vlw;
+}
+
+// Printable ASCII, as in the fonts made for Latin text
+static std::vector<uint16_t> asciiCodes() {
+  std::vector<uint16_t> codes;
+  for (uint16_t code = 0x21; code <= 0x7E; code++) {
+    codes.push_back(code);
+  }
+  return codes;
+}
+
+// ASCII followed by a block of CJK ideographs, so most lookups are for
+// glyphs far down the table
+static std::vector<uint16_t> cjkCodes() {
+  std::vector<uint16_t> codes = asciiCodes();
+  for (uint16_t code = 0x4E00; code < 0x4E00 + 2000; code++) {
+    codes.push_back(code);
+  }
+  return codes;
+}
+
+static std::string utf8(const std::vector<uint16_t>& codes) {
+  std::string text;
+  for (uint16_t code : codes) {
+    if (code < 0x80) {
+      text += (char)code;
+    } else if (code < 0x800) {
+      text += (char)(0xC0 | code >> 6);
+      text += (char)(0x80 | (code & 0x3F));
+    } else {
+      text += (char)(0xE0 | code >> 12);
+      text += (char)(0x80 | (code >> 6 & 0x3F));
+      text += (char)(0x80 | (code & 0x3F));
+    }
+  }
+  return text;
+}
+
+// Text of 20 glyphs spread over the whole font
+static std::string sampleText(const std::vector<uint16_t>& codes) {
+  std::vector<uint16_t> picked;
+  for (uint8_t i = 0; i < 20; i++) {
+    picked.push_back(codes[(i * 7919u) % codes.size()]);
+  }
+  return utf8(picked);
+}
+
+// The glyph lookup as it was before the sorted index, a scan of the table
+static void useLinearSearch() {
+  free(tft.gSorted);
+  tft.gSorted = NULL;
+}
+
+static std::vector<uint16_t> screen() {
+  std::vector<uint16_t> pixels;
+  for (int32_t y = 0; y < tft.height(); y++) {
+    for (int32_t x = 0; x < tft.width(); x++) {
+      pixels.push_back(tft_native.getPixel(x, y));
+    }
+  }
+  return pixels;
+}
+
+static std::vector<uint16_t> render(const std::string& text) {
+  tft.fillScreen(TFT_BLACK);
+  tft.setTextColor(TFT_WHITE, TFT_NAVY, true);
+  tft.drawString(text.c_str(), 0, 0);
+  tft.drawString(text.c_str(), 0, 40);
+  return screen();
+}
+
+void setUp() {}
+
+void tearDown() {
+  tft.setGlyphAtlas(0);
+  tft.unloadFont();
+  tft.setFreeFont(NULL);
+  tft.setTextFont(1);
+}
+
+static uint32_t litPixels() {
+  uint32_t lit = 0;
+  for (uint16_t pixel : screen()) {
+    lit += pixel != TFT_BLACK;
+  }
+  return lit;
+}
+
+// The built in and free fonts find their glyphs through pointers in flash
+// tables, which have to be read whole on a 64 bit host
+void test_builtin_and_free_fonts_draw() {
+  const uint8_t fonts[] = {1, 2, 4, 6, 7, 8};
+  tft.setTextColor(TFT_WHITE, TFT_BLACK);
+  for (uint8_t font : fonts) {
+    tft.fillScreen(TFT_BLACK);
+    tft.setTextFont(font);
+    TEST_ASSERT_TRUE(tft.drawString("12:34", 0, 0) > 0);
+    TEST_ASSERT_TRUE(litPixels() > 0);
+  }
+  tft.fillScreen(TFT_BLACK);
+  tft.setFreeFont(&FreeSans9pt7b);
+  TEST_ASSERT_TRUE(tft.drawString("Free", 0, 0) > 0);
+  TEST_ASSERT_TRUE(litPixels() > 0);
+}
+
+void test_sorted_lookup_matches_linear_search() {
+  std::vector<uint16_t> codes = cjkCodes();
+  // Out of order, as a hand made font could be
+  std::swap(codes[3], codes[1500]);
+  std::swap(codes[0], codes[codes.size() - 1]);
+  const std::vector<uint8_t> vlw = makeFont(codes);
+  tft.loadFont(vlw.data());
+  TEST_ASSERT_NOT_NULL(tft.gSorted);
+
+  for (uint32_t code = 0; code <= 0xFFFF; code++) {
+    uint16_t expected = 0xFFFF;
+    for (uint16_t i = 0; i < codes.size(); i++) {
+      if (codes[i] == code) {
+        expected = i;
+        break;
+      }
+    }
+    uint16_t index = 0xFFFF;
+    const bool found = tft.getUnicodeIndex(code, &index);
+    TEST_ASSERT_EQUAL(expected != 0xFFFF, found);
+    if (found) {
+      TEST_ASSERT_EQUAL(expected, index);
+    }
+  }
+}
+
+void test_sorted_lookup_and_atlas_draw_the_same_pixels() {
+  const std::vector<uint16_t> codes = cjkCodes();
+  const std::vector<uint8_t> vlw = makeFont(codes);
+  const std::string text = sampleText(codes);
+
+  tft.loadFont(vlw.data());
+  useLinearSearch();
+  const std::vector<uint16_t> linear = render(text);
+  tft.unloadFont();
+
+  tft.loadFont(vlw.data());
+  const std::vector<uint16_t> sorted = render(text);
+  TEST_ASSERT_TRUE(linear == sorted);
+
+  tft.setGlyphAtlas(ATLAS_BYTES);
+  const std::vector<uint16_t> atlas = render(text);
+  TEST_ASSERT_TRUE(linear == atlas);
+  TEST_ASSERT_TRUE(tft.getGlyphAtlasHits() > 0);
+}
+
+// Glyphs per second drawn with drawString, with the linear search the
+// library used to have, the sorted index, and the sorted index with the
+// glyph atlas. The host CPU is far faster than the ESP32, so the ratios are
+// what carries over, not the rates.
+static double glyphsPerSecond(const std::vector<uint8_t>& vlw,
+                              const std::string& text, uint32_t glyphs,
+                              bool linear, bool atlas) {
+  tft.loadFont(vlw.data());
+  if (linear) {
+    useLinearSearch();
+  }
+  if (atlas) {
+    tft.setGlyphAtlas(ATLAS_BYTES);
+  }
+  tft.setTextColor(TFT_WHITE, TFT_NAVY, true);
+  tft.drawString(text.c_str(), 0, 0);
+
+  const uint32_t start = nowNanos();
+  for (uint32_t i = 0; i < BENCHMARK_ROUNDS; i++) {
+    tft.drawString(text.c_str(), 0, 0);
+  }
+  const uint32_t elapsed = nowNanos() - start;
+  tft.setGlyphAtlas(0);
+  tft.unloadFont();
+  return (double)glyphs * BENCHMARK_ROUNDS * 1e9 / elapsed;
+}
+
+static void benchmark(const char* name, const std::vector<uint16_t>& codes) {
+  const std::vector<uint8_t> vlw = makeFont(codes);
+  const std::string text = sampleText(codes);
+  const double linear = glyphsPerSecond(vlw, text, 20, true, false);
+  const double sorted = glyphsPerSecond(vlw, text, 20, false, false);
+  const double atlas = glyphsPerSecond(vlw, text, 20, false, true);
+
+  char message[160];
+  snprintf(message, sizeof(message),
+           "%s, %u glyphs: linear %.0f/s, sorted %.0f/s (%.2fx), "
+           "sorted + atlas %.0f/s (%.2fx)",
+           name, (unsigned)codes.size(), linear, sorted, sorted / linear,
+           atlas, atlas / linear);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(linear > 0 && sorted > 0 && atlas > 0);
+}
+
+void test_glyph_rate() {
+  benchmark("ASCII font", asciiCodes());
+  benchmark("CJK font", cjkCodes());
+}
+
+int main(int argc, char** argv) {
+  tft.begin();
+  tft.setRotation(1);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_sorted_lookup_matches_linear_search);
+  RUN_TEST(test_sorted_lookup_and_atlas_draw_the_same_pixels);
+  RUN_TEST(test_glyph_rate);
+  RUN_TEST(test_builtin_and_free_fonts_draw);
+  return UNITY_END();
+}